@@ -0,0 +1,139 @@
+/*
+* Allocation harness: replaces operator new to count every heap allocation, then runs the churn workload of the ECSDemo
+* (spheres with a lifetime constantly destroyed and respawned) on a world with an arena allocator.
+* After a warmup, steps, spawns and destroys should not reach the heap at all. Exits with 1 if any of them does,
+* so it can be run in CI to keep the zero allocation steady state from regressing.
+*/
+
+#include <BulletECS/BulletECS.h>
+#include <BulletECS/AllocationTracker.h>
+#include <iostream>
+#include <vector>
+
+BULLET_ECS_IMPLEMENT_ALLOCATION_TRACKER
+
+using namespace BulletECS;
+
+struct LifeTimeComponent
+{
+	LifeTimeComponent(int stepsAlive) : remainingSteps(stepsAlive) {}
+	int remainingSteps;
+};
+
+struct PhaseCounts
+{
+	uint64_t allocations = 0;
+	uint64_t operations = 0;
+};
+
+static Entity spawnSphere(PhysicsWorld& world, btVector3 position)
+{
+	Entity sphere = world.createEntity();
+	btTransform transform = btTransform::getIdentity();
+	transform.setOrigin(position);
+	world.addMotionState(sphere, transform);
+	world.setSphereCollider(sphere, 0.5f);
+	world.addRigidBody(sphere, 1.0f, 0.5f);
+	return sphere;
+}
+
+static void print(const char* name, const PhaseCounts& counts)
+{
+	std::cout << name << ": " << counts.allocations << " allocations in " << counts.operations << " operations";
+	if (counts.operations > 0)
+	{
+		std::cout << " (" << static_cast<double>(counts.allocations) / counts.operations << " per operation)";
+	}
+	std::cout << "\n";
+}
+
+int main()
+{
+	constexpr size_t maxAlive = 2000;
+	constexpr int stepsAlive = 100;
+	constexpr int spawnsPerStep = 30;
+	constexpr int warmupSteps = 600;
+	constexpr int measuredSteps = 600;
+
+	PhysicsWorldConfig config;
+	config.maxEntities = maxAlive + 16;
+	config.expectedEntities = maxAlive;
+	config.useArenaAllocator = true;
+	PhysicsWorld world(config);
+	ComponentPool<LifeTimeComponent> lifetimes(config.maxEntities);
+	std::vector<Entity> entitiesToDestroy;
+	entitiesToDestroy.reserve(maxAlive);
+
+	Entity floor = world.createEntity();
+	btTransform floorTransform = btTransform::getIdentity();
+	floorTransform.setOrigin({ 0, -1, 0 });
+	world.addMotionState(floor, floorTransform);
+	world.setBoxCollider(floor, { 50, 1, 50 });
+	world.addRigidBody(floor, 0, 0.5f);
+
+	PhaseCounts spawns, steps, destroys;
+	size_t alive = 0;
+	for (int step = 0; step < warmupSteps + measuredSteps; step++)
+	{
+		const bool measuring = step >= warmupSteps;
+		{
+			AllocationTracker::ScopedCounter counter;
+			int spawned = 0;
+			for (; spawned < spawnsPerStep && alive < maxAlive; spawned++, alive++)
+			{
+				float offset = static_cast<float>(spawned % 6) * 1.5f - 4.0f;
+				lifetimes.add(spawnSphere(world, { offset, 10.0f + spawned / 6 * 1.5f, offset * 0.5f }), stepsAlive);
+			}
+			if (measuring)
+			{
+				spawns.allocations += counter.getAllocations();
+				spawns.operations += spawned;
+			}
+		}
+		{
+			const StepStats& stats = world.stepSimulation(1.0f / 60.0f, 10);
+			if (measuring)
+			{
+				steps.allocations += stats.stepAllocations;
+				steps.operations++;
+			}
+		}
+		{
+			AllocationTracker::ScopedCounter counter;
+			for (Entity e : lifetimes)
+			{
+				if (--lifetimes.get(e)->remainingSteps <= 0)
+				{
+					entitiesToDestroy.push_back(e);
+				}
+			}
+			for (Entity e : entitiesToDestroy)
+			{
+				lifetimes.remove(e);
+				world.destroyEntity(e);
+				alive--;
+			}
+			if (measuring)
+			{
+				destroys.allocations += counter.getAllocations();
+				destroys.operations += entitiesToDestroy.size();
+			}
+			entitiesToDestroy.clear();
+		}
+	}
+
+	std::cout << "After " << warmupSteps << " warmup steps, over " << measuredSteps << " steps:\n";
+	print("Spawns", spawns);
+	print("Steps", steps);
+	print("Destroys", destroys);
+	BulletAllocationStats bullet = world.getBulletAllocationStats();
+	std::cout << "Bullet arena: " << bullet.systemAllocations << " system allocations, " << bullet.bytesReserved / 1024 << " KB reserved\n";
+
+	if (spawns.allocations + steps.allocations + destroys.allocations > 0)
+	{
+		std::cout << "FAILED: the steady state reached the heap\n";
+		return 1;
+	}
+	std::cout << "OK: no heap allocations in the steady state\n";
+	return 0;
+}
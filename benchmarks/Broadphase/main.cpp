@@ -0,0 +1,189 @@
+/*
+* Runs the same workloads with every broadphase selectable in PhysicsWorldConfig, to pick the fastest one for each level type:
+*  - Churn: the ECSDemo workload, 1000 spheres alive with a lifetime, constantly spawned and destroyed.
+*  - Dense spheres: 100k evenly sized spheres resting in a block on a floor.
+*/
+
+#include <BulletECS/BulletECS.h>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+using Clock = std::chrono::high_resolution_clock;
+using Milliseconds = std::chrono::duration<double, std::milli>;
+
+struct LifeTimeComponent
+{
+	LifeTimeComponent(int stepsAlive) : remainingSteps(stepsAlive) {}
+	int remainingSteps;
+};
+
+struct BenchmarkResult
+{
+	double initMs = 0;
+	double averageStepMs = 0;
+	double averagePairs = 0;
+};
+
+static const char* broadphaseName(BulletECS::BroadphaseType type)
+{
+	switch (type)
+	{
+	case BulletECS::BroadphaseType::Dbvt: return "Dbvt";
+	case BulletECS::BroadphaseType::AxisSweep3: return "AxisSweep3";
+	case BulletECS::BroadphaseType::AxisSweep3_32Bit: return "AxisSweep3_32Bit";
+	case BulletECS::BroadphaseType::UniformGrid: return "UniformGrid";
+	default: return "Unknown";
+	}
+}
+
+static BulletECS::PhysicsWorldConfig makeConfig(BulletECS::BroadphaseType type, BulletECS::entity_id_t maxEntities)
+{
+	BulletECS::PhysicsWorldConfig config;
+	config.broadphase = type;
+	config.maxEntities = maxEntities;
+	config.expectedEntities = maxEntities;
+	config.worldAabbMin = { -200, -50, -200 };
+	config.worldAabbMax = { 200, 200, 200 };
+	config.gridCellSize = 2.0f;
+	return config;
+}
+
+static void createFloor(BulletECS::PhysicsWorld& world, float halfExtent)
+{
+	BulletECS::Entity floor = world.createEntity();
+	btTransform floorTransform = btTransform::getIdentity();
+	floorTransform.setOrigin({ 0, -1, 0 });
+	world.addMotionState(floor, floorTransform);
+	world.setBoxCollider(floor, { halfExtent, 1, halfExtent });
+	world.addRigidBody(floor, 0, 0.5f);
+}
+
+static BulletECS::Entity spawnSphere(BulletECS::PhysicsWorld& world, btVector3 position, float radius)
+{
+	BulletECS::Entity sphere = world.createEntity();
+	btTransform transform = btTransform::getIdentity();
+	transform.setOrigin(position);
+	world.addMotionState(sphere, transform);
+	world.setSphereCollider(sphere, radius);
+	world.addRigidBody(sphere, 1, 0.75f);
+	return sphere;
+}
+
+static BenchmarkResult runChurn(BulletECS::BroadphaseType type)
+{
+	constexpr size_t maxAlive = 1000;
+	constexpr int stepsAlive = 100;
+	constexpr int spawnsPerStep = 15;
+	constexpr int steps = 300;
+
+	BenchmarkResult result;
+	auto initStart = Clock::now();
+	BulletECS::PhysicsWorld world(makeConfig(type, 2048));
+	BulletECS::ComponentPool<LifeTimeComponent> lifetimes(2048);
+	createFloor(world, 50);
+	size_t alive = 0;
+	for (; alive < 500; alive++)
+	{
+		lifetimes.add(spawnSphere(world, { 0, 10, 0 }, 1), stepsAlive);
+	}
+	result.initMs = Milliseconds(Clock::now() - initStart).count();
+
+	std::vector<BulletECS::Entity> entitiesToDestroy;
+	Milliseconds stepTime = {};
+	for (int step = 0; step < steps; step++)
+	{
+		auto start = Clock::now();
+		for (int spawned = 0; spawned < spawnsPerStep && alive < maxAlive; spawned++, alive++)
+		{
+			lifetimes.add(spawnSphere(world, { 0, 10, 0 }, 1), stepsAlive);
+		}
+		world.stepSimulation(1.0f / 60.0f, 10);
+		for (BulletECS::Entity e : lifetimes)
+		{
+			if (--lifetimes.get(e)->remainingSteps <= 0)
+			{
+				entitiesToDestroy.push_back(e);
+			}
+		}
+		for (BulletECS::Entity e : entitiesToDestroy)
+		{
+			lifetimes.remove(e);
+			world.destroyEntity(e);
+			alive--;
+		}
+		entitiesToDestroy.clear();
+		stepTime += Clock::now() - start;
+		result.averagePairs += world.getDynamicsWorld()->getPairCache()->getNumOverlappingPairs();
+	}
+	result.averageStepMs = stepTime.count() / steps;
+	result.averagePairs /= steps;
+	return result;
+}
+
+static BenchmarkResult runDenseSpheres(BulletECS::BroadphaseType type)
+{
+	constexpr int sideX = 100;
+	constexpr int sideY = 10;
+	constexpr int sideZ = 100;
+	constexpr int sphereCount = sideX * sideY * sideZ;
+	constexpr int steps = 30;
+
+	BenchmarkResult result;
+	auto initStart = Clock::now();
+	BulletECS::PhysicsWorld world(makeConfig(type, sphereCount + 1));
+	createFloor(world, 120);
+	for (int x = 0; x < sideX; x++)
+	{
+		for (int y = 0; y < sideY; y++)
+		{
+			for (int z = 0; z < sideZ; z++)
+			{
+				spawnSphere(world, { (x - sideX / 2) * 1.05f, 0.5f + y * 1.05f, (z - sideZ / 2) * 1.05f }, 0.5f);
+			}
+		}
+	}
+	result.initMs = Milliseconds(Clock::now() - initStart).count();
+
+	Milliseconds stepTime = {};
+	for (int step = 0; step < steps; step++)
+	{
+		auto start = Clock::now();
+		world.stepSimulation(1.0f / 60.0f);
+		stepTime += Clock::now() - start;
+		result.averagePairs += world.getDynamicsWorld()->getPairCache()->getNumOverlappingPairs();
+	}
+	result.averageStepMs = stepTime.count() / steps;
+	result.averagePairs /= steps;
+	return result;
+}
+
+static void printResult(const char* scenario, BulletECS::BroadphaseType type, const BenchmarkResult& result)
+{
+	std::cout << scenario << " [" << broadphaseName(type) << "]: init " << result.initMs << " ms, step " << result.averageStepMs << " ms, pairs " << result.averagePairs << "\n";
+}
+
+int main()
+{
+	const BulletECS::BroadphaseType types[] = {
+		BulletECS::BroadphaseType::Dbvt,
+		BulletECS::BroadphaseType::AxisSweep3,
+		BulletECS::BroadphaseType::AxisSweep3_32Bit,
+		BulletECS::BroadphaseType::UniformGrid
+	};
+
+	for (BulletECS::BroadphaseType type : types)
+	{
+		printResult("Churn", type, runChurn(type));
+	}
+	for (BulletECS::BroadphaseType type : types)
+	{
+		if (type == BulletECS::BroadphaseType::AxisSweep3)
+		{
+			std::cout << "Dense spheres [AxisSweep3]: skipped, 16 bit handles cannot hold 100k proxies\n";
+			continue;
+		}
+		printResult("Dense spheres", type, runDenseSpheres(type));
+	}
+	return 0;
+}
@@ -0,0 +1,122 @@
+/*
+* Compares the same debris-heavy scene with and without collision layers.
+* In the layered run debris does not collide with other debris, so those pairs are culled by the
+* broadphase filter and never reach the narrowphase. The dispatcher is wrapped to time the narrowphase alone.
+*/
+
+#include <BulletECS/BulletECS.h>
+#include <chrono>
+#include <iostream>
+#include <memory>
+
+static constexpr BulletECS::collision_layer_t WORLD_LAYER = 0;
+static constexpr BulletECS::collision_layer_t DEBRIS_LAYER = 1;
+static constexpr int DEBRIS_COUNT = 3000;
+static constexpr int WARMUP_STEPS = 60;
+static constexpr int MEASURED_STEPS = 300;
+
+class TimedDispatcher : public btCollisionDispatcher
+{
+public:
+	TimedDispatcher(btCollisionConfiguration* configuration) : btCollisionDispatcher(configuration) {}
+
+	void dispatchAllCollisionPairs(btOverlappingPairCache* pairCache, const btDispatcherInfo& dispatchInfo, btDispatcher* dispatcher) override
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		btCollisionDispatcher::dispatchAllCollisionPairs(pairCache, dispatchInfo, dispatcher);
+		narrowphaseTime += std::chrono::high_resolution_clock::now() - start;
+	}
+
+	std::chrono::duration<double, std::milli> narrowphaseTime = {};
+};
+
+struct RunResult
+{
+	double averagePairs = 0;
+	double averageManifolds = 0;
+	double averageStepMs = 0;
+	double averageNarrowphaseMs = 0;
+};
+
+static RunResult runScene(bool debrisCollidesWithDebris)
+{
+	auto collisionConfiguration = std::make_unique<btDefaultCollisionConfiguration>();
+	auto dispatcher = std::make_unique<TimedDispatcher>(collisionConfiguration.get());
+	auto broadphase = std::make_unique<btDbvtBroadphase>();
+	auto solver = std::make_unique<btSequentialImpulseConstraintSolver>();
+	auto dynamicsWorld = std::make_unique<btDiscreteDynamicsWorld>(dispatcher.get(), broadphase.get(), solver.get(), collisionConfiguration.get());
+	dynamicsWorld->setGravity({ 0, -10, 0 });
+
+	TimedDispatcher* timedDispatcher = dispatcher.get();
+	btOverlappingPairCache* pairCache = broadphase->getOverlappingPairCache();
+
+	BulletECS::PhysicsWorld world(std::move(collisionConfiguration), std::move(dispatcher), std::move(broadphase), std::move(solver), std::move(dynamicsWorld));
+	world.setLayersCollide(DEBRIS_LAYER, DEBRIS_LAYER, debrisCollidesWithDebris);
+
+	BulletECS::Entity floor = world.createEntity();
+	btTransform floorTransform = btTransform::getIdentity();
+	floorTransform.setOrigin({ 0, -1, 0 });
+	world.addMotionState(floor, floorTransform);
+	world.setBoxCollider(floor, { 50, 1, 50 });
+	world.setCollisionLayer(floor, WORLD_LAYER);
+	world.addRigidBody(floor, 0, 0.5f);
+
+	//a dense column of debris, so debris-debris pairs dominate when they are allowed
+	for (int i = 0; i < DEBRIS_COUNT; i++)
+	{
+		BulletECS::Entity debris = world.createEntity();
+		btTransform transform = btTransform::getIdentity();
+		transform.setOrigin({ float(i % 10) * 0.6f - 3.0f, 1.0f + float(i / 100) * 0.6f, float((i / 10) % 10) * 0.6f - 3.0f });
+		world.addMotionState(debris, transform);
+		world.setSphereCollider(debris, 0.25f);
+		world.setCollisionLayer(debris, DEBRIS_LAYER);
+		world.addRigidBody(debris, 0.1f, 0.2f);
+	}
+
+	for (int i = 0; i < WARMUP_STEPS; i++)
+	{
+		world.stepSimulation(1.0f / 60.0f);
+	}
+
+	RunResult result;
+	timedDispatcher->narrowphaseTime = {};
+	std::chrono::duration<double, std::milli> stepTime = {};
+	for (int i = 0; i < MEASURED_STEPS; i++)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		world.stepSimulation(1.0f / 60.0f);
+		stepTime += std::chrono::high_resolution_clock::now() - start;
+		result.averagePairs += pairCache->getNumOverlappingPairs();
+		result.averageManifolds += timedDispatcher->getNumManifolds();
+	}
+	result.averagePairs /= MEASURED_STEPS;
+	result.averageManifolds /= MEASURED_STEPS;
+	result.averageStepMs = stepTime.count() / MEASURED_STEPS;
+	result.averageNarrowphaseMs = timedDispatcher->narrowphaseTime.count() / MEASURED_STEPS;
+	return result;
+}
+
+static void printResult(const char* name, const RunResult& result)
+{
+	std::cout << name << ":\n";
+	std::cout << "\tOverlapping pairs per step: " << result.averagePairs << "\n";
+	std::cout << "\tManifolds per step: " << result.averageManifolds << "\n";
+	std::cout << "\tNarrowphase: " << result.averageNarrowphaseMs << " ms/step\n";
+	std::cout << "\tTotal step: " << result.averageStepMs << " ms/step\n";
+}
+
+int main()
+{
+	RunResult unfiltered = runScene(true);
+	RunResult layered = runScene(false);
+
+	printResult("Debris collides with debris", unfiltered);
+	printResult("Debris layer filtered", layered);
+
+	if (unfiltered.averagePairs > 0 && unfiltered.averageNarrowphaseMs > 0)
+	{
+		std::cout << "Pair reduction: " << 100.0 * (1.0 - layered.averagePairs / unfiltered.averagePairs) << "%\n";
+		std::cout << "Narrowphase reduction: " << 100.0 * (1.0 - layered.averageNarrowphaseMs / unfiltered.averageNarrowphaseMs) << "%\n";
+	}
+	return 0;
+}
@@ -0,0 +1,119 @@
+/*
+* A 4097 x 4097 sample terrain (64 MB of heights) loaded two ways:
+*  - the usual way, reading the heights into a private array and giving it to one btHeightfieldTerrainShape
+*  - with PhysicsWorld::setHeightfieldCollider, one static body per 128 quad tile reading its heights from the mapped file
+* Then a second world maps the same file, as a second level using the same terrain would, and a streaming loop keeps only
+* the tiles around a moving focus alive to show the tile shapes being released.
+*/
+
+#include <BulletECS/BulletECS.h>
+#include <chrono>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+
+using namespace BulletECS;
+using Clock = std::chrono::steady_clock;
+using Milliseconds = std::chrono::duration<double, std::milli>;
+
+static constexpr uint32_t SAMPLES = 4097;
+static constexpr uint32_t TILE_QUADS = 128;
+static constexpr float SPACING = 1.0f;
+static const char* RAW_PATH = "heightfield_benchmark.raw";
+static const char* TILED_PATH = "heightfield_benchmark.bin";
+
+static std::vector<Entity> addTerrain(PhysicsWorld& world, uint32_t tiles, uint32_t firstX = 0, uint32_t firstZ = 0, uint32_t count = ~0u)
+{
+	std::vector<Entity> entities;
+	for (uint32_t tileZ = firstZ; tileZ < std::min(tiles, firstZ + count); tileZ++)
+	{
+		for (uint32_t tileX = firstX; tileX < std::min(tiles, firstX + count); tileX++)
+		{
+			Entity entity = world.createEntity();
+			HeightfieldTileShape* shape = world.setHeightfieldCollider(entity, TILED_PATH, tileX, tileZ);
+			if (!shape)
+			{
+				return {};
+			}
+			btTransform transform = btTransform::getIdentity();
+			transform.setOrigin(shape->getTileCenter());
+			world.addMotionState(entity, transform);
+			world.addRigidBody(entity, 0.0f);
+			entities.push_back(entity);
+		}
+	}
+	return entities;
+}
+
+int main()
+{
+	{
+		std::vector<float> heights(size_t(SAMPLES) * SAMPLES);
+		for (uint32_t z = 0; z < SAMPLES; z++)
+		{
+			for (uint32_t x = 0; x < SAMPLES; x++)
+			{
+				heights[size_t(z) * SAMPLES + x] = 20.0f * std::sin(float(x) * 0.01f) * std::cos(float(z) * 0.013f);
+			}
+		}
+		std::ofstream raw(RAW_PATH, std::ios::binary | std::ios::trunc);
+		raw.write(reinterpret_cast<const char*>(heights.data()), static_cast<std::streamsize>(heights.size() * sizeof(float)));
+		if (!raw || !Heightfield::write(TILED_PATH, heights.data(), SAMPLES, SAMPLES, TILE_QUADS, SPACING))
+		{
+			std::cerr << "Could not write the terrain files\n";
+			return 1;
+		}
+	}
+	const uint32_t tiles = (SAMPLES - 1) / TILE_QUADS;
+
+	{
+		const Clock::time_point start = Clock::now();
+		std::vector<float> heights(size_t(SAMPLES) * SAMPLES);
+		std::ifstream raw(RAW_PATH, std::ios::binary);
+		raw.read(reinterpret_cast<char*>(heights.data()), static_cast<std::streamsize>(heights.size() * sizeof(float)));
+		btHeightfieldTerrainShape shape(SAMPLES, SAMPLES, heights.data(), 1.0f, -20.0f, 20.0f, 1, PHY_FLOAT, false);
+		std::cout << "Private copy: " << Milliseconds(Clock::now() - start).count() << " ms, " << heights.size() * sizeof(float) / (1024 * 1024) << " MB of heap\n";
+	}
+
+	PhysicsWorldConfig config;
+	config.maxEntities = tiles * tiles + 16;
+	PhysicsWorld world(config);
+	Clock::time_point start = Clock::now();
+	std::vector<Entity> terrain = addTerrain(world, tiles);
+	if (terrain.size() != size_t(tiles) * tiles)
+	{
+		std::cerr << "Could not map " << TILED_PATH << "\n";
+		return 1;
+	}
+	std::cout << "Mapped tiles: " << Milliseconds(Clock::now() - start).count() << " ms for " << terrain.size() << " tiles, "
+		<< world.memoryReport().getTotalUsedBytes() / 1024 << " KB reported by the world\n";
+
+	//a second level using the same terrain
+	PhysicsWorld secondWorld(config);
+	start = Clock::now();
+	addTerrain(secondWorld, tiles);
+	std::cout << "Second world: " << Milliseconds(Clock::now() - start).count() << " ms (its own shapes, the OS shares the mapped pages)\n";
+
+	//a focus crossing the map, only the 3 x 3 tiles around it stay loaded
+	PhysicsWorld streamingWorld(config);
+	size_t peakTiles = 0;
+	std::vector<Entity> loaded;
+	for (uint32_t step = 0; step + 2 < tiles; step++)
+	{
+		for (Entity entity : loaded)
+		{
+			streamingWorld.destroyEntity(entity);
+		}
+		loaded = addTerrain(streamingWorld, tiles, step, step, 3);
+		streamingWorld.stepSimulation(1.0f / 60.0f);
+		peakTiles = std::max(peakTiles, streamingWorld.memoryReport().find("Collision shapes")->count);
+	}
+	std::cout << "Streaming: at most " << peakTiles << " tile shapes alive out of " << size_t(tiles) * tiles << "\n";
+
+	std::remove(RAW_PATH);
+	std::remove(TILED_PATH);
+	return 0;
+}
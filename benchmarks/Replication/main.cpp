@@ -0,0 +1,176 @@
+/*
+* A server world of 20k bodies (a static floor grid and crates falling onto it) replicated to 64 loopback clients spread over the map.
+* Each step the ReplicationServer encodes one snapshot per client into preallocated buffers, every client decodes its snapshot with a
+* ReplicationClient and acknowledges it a few steps later, like over a network with latency. One packet in 20 is dropped.
+* Prints the bytes and encode time against serializing every body for every client, and checks the clients against the world.
+*/
+
+#include <BulletECS/BulletECS.h>
+#include <BulletECS/ThreadPool.h>
+#include <chrono>
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <cmath>
+#include <cstring>
+
+using namespace BulletECS;
+using Clock = std::chrono::steady_clock;
+using Milliseconds = std::chrono::duration<double, std::milli>;
+
+static constexpr size_t STATIC_COUNT = 10000;
+static constexpr size_t DYNAMIC_COUNT = 10000;
+static constexpr size_t CLIENT_COUNT = 64;
+static constexpr int STEPS = 300;
+static constexpr int ACK_DELAY = 3; //steps between a snapshot and its acknowledgement
+static constexpr size_t BUFFER_CAPACITY = 64 * 1024;
+static constexpr float MAP_SIZE = 1000.0f;
+
+struct LoopbackClient
+{
+	ReplicationClient client;
+	std::deque<std::pair<int, uint32_t>> pendingAcks; //step to send it at, sequence
+};
+
+//serializes every body as an entity and a float transform, the baseline the replication is compared to
+static size_t serializeEverything(const PhysicsWorld& world, std::vector<uint8_t>& buffer)
+{
+	size_t size = 0;
+	for (Entity entity : world.iterateEntitiesWithRigidBodies())
+	{
+		const btTransform& transform = world.getRigidBody(entity)->getWorldTransform();
+		const btQuaternion rotation = transform.getRotation();
+		const float values[7] = { float(transform.getOrigin().x()), float(transform.getOrigin().y()), float(transform.getOrigin().z()),
+			float(rotation.x()), float(rotation.y()), float(rotation.z()), float(rotation.w()) };
+		std::memcpy(buffer.data() + size, &entity, sizeof(Entity));
+		std::memcpy(buffer.data() + size + sizeof(Entity), values, sizeof(values));
+		size += sizeof(Entity) + sizeof(values);
+	}
+	return size;
+}
+
+int main()
+{
+	PhysicsWorldConfig config;
+	config.maxEntities = STATIC_COUNT + DYNAMIC_COUNT + 16;
+	config.expectedEntities = STATIC_COUNT + DYNAMIC_COUNT;
+	PhysicsWorld world(config);
+	ThreadPool threadPool;
+	world.setThreadPool(&threadPool);
+
+	const size_t side = 100;
+	const float spacing = MAP_SIZE / side;
+	for (size_t i = 0; i < STATIC_COUNT; i++)
+	{
+		Entity entity = world.createEntity();
+		btTransform transform = btTransform::getIdentity();
+		transform.setOrigin(btVector3(float(i % side) * spacing, 0.0f, float(i / side % side) * spacing));
+		world.addMotionState(entity, transform);
+		world.setBoxCollider(entity, { spacing * 0.5f, 0.5f, spacing * 0.5f });
+		world.addRigidBody(entity, 0.0f);
+	}
+	for (size_t i = 0; i < DYNAMIC_COUNT; i++)
+	{
+		Entity entity = world.createEntity();
+		btTransform transform = btTransform::getIdentity();
+		transform.setOrigin(btVector3(float(i % side) * spacing + 1.0f, 2.0f + float(i / (side * side)) * 2.0f, float(i / side % side) * spacing + 1.0f));
+		world.addMotionState(entity, transform);
+		world.setBoxCollider(entity, { 0.5f, 0.5f, 0.5f });
+		world.addRigidBody(entity, 1.0f, 0.2f);
+	}
+
+	ReplicationSettings settings;
+	settings.interestRadius = 150.0f;
+	ReplicationServer server(world, settings);
+	std::vector<LoopbackClient> clients(CLIENT_COUNT);
+	std::vector<std::vector<uint8_t>> storage(CLIENT_COUNT, std::vector<uint8_t>(BUFFER_CAPACITY));
+	std::vector<SnapshotBuffer> buffers(CLIENT_COUNT);
+	for (size_t i = 0; i < CLIENT_COUNT; i++)
+	{
+		buffers[i].client = server.addClient();
+		buffers[i].data = storage[i].data();
+		buffers[i].capacity = BUFFER_CAPACITY;
+		server.setClientFocus(buffers[i].client, btVector3(float(i % 8) * MAP_SIZE / 8.0f + 60.0f, 0.0f, float(i / 8) * MAP_SIZE / 8.0f + 60.0f));
+		clients[i].client = ReplicationClient(settings);
+	}
+
+	std::vector<uint8_t> fullBuffer((STATIC_COUNT + DYNAMIC_COUNT) * (sizeof(Entity) + 7 * sizeof(float)));
+	double fullTime = 0.0;
+	uint64_t fullBytes = 0;
+	double replicationTime = 0.0;
+	uint64_t replicationBytes = 0;
+	uint32_t truncated = 0;
+	uint32_t rejected = 0;
+	for (int step = 0; step < STEPS; step++)
+	{
+		world.stepSimulation(1.0f / 60.0f);
+
+		const Clock::time_point fullStart = Clock::now();
+		for (size_t i = 0; i < CLIENT_COUNT; i++)
+		{
+			fullBytes += serializeEverything(world, fullBuffer);
+		}
+		fullTime += Milliseconds(Clock::now() - fullStart).count();
+
+		const Clock::time_point start = Clock::now();
+		server.encodeSnapshots(buffers);
+		replicationTime += Milliseconds(Clock::now() - start).count();
+		const ReplicationStats& stats = server.getStats();
+		replicationBytes += stats.encodedBytes;
+		truncated += stats.truncatedSnapshots;
+
+		for (size_t i = 0; i < CLIENT_COUNT; i++)
+		{
+			LoopbackClient& loopback = clients[i];
+			const bool dropped = (step + int(i)) % 20 == 0;
+			if (!dropped && buffers[i].size > 0)
+			{
+				if (loopback.client.receive(buffers[i].data, buffers[i].size))
+				{
+					loopback.pendingAcks.emplace_back(step + ACK_DELAY, loopback.client.getLastSequence());
+				}
+				else
+				{
+					rejected++;
+				}
+			}
+			while (!loopback.pendingAcks.empty() && loopback.pendingAcks.front().first <= step)
+			{
+				server.acknowledge(buffers[i].client, loopback.pendingAcks.front().second);
+				loopback.pendingAcks.pop_front();
+			}
+		}
+	}
+
+	//after a last snapshot every client must hold the world's transforms of the bodies it sees, within the quantization error
+	server.encodeSnapshots(buffers);
+	double maxError = 0.0;
+	size_t checkedBodies = 0;
+	for (size_t i = 0; i < CLIENT_COUNT; i++)
+	{
+		if (!clients[i].client.receive(buffers[i].data, buffers[i].size))
+		{
+			std::cerr << "Client " << i << " rejected its snapshot\n";
+			return 1;
+		}
+		for (const ReplicatedBody& body : clients[i].client.getBodies())
+		{
+			const btRigidBody* rigidBody = world.getRigidBody(body.entity);
+			if (!rigidBody)
+			{
+				std::cerr << "Client " << i << " holds entity " << body.entity.ID << " which has no rigidBody\n";
+				return 1;
+			}
+			maxError = std::max(maxError, double((rigidBody->getWorldTransform().getOrigin() - body.position).length()));
+			checkedBodies++;
+		}
+	}
+
+	std::cout << CLIENT_COUNT << " clients, " << STATIC_COUNT + DYNAMIC_COUNT << " bodies, " << STEPS << " steps\n";
+	std::cout << "Full serialization: " << fullBytes / STEPS << " bytes/step, " << fullTime / STEPS << " ms/step\n";
+	std::cout << "Replication: " << replicationBytes / STEPS << " bytes/step, " << replicationTime / STEPS << " ms/step ("
+		<< double(fullBytes) / double(replicationBytes) << "x fewer bytes, " << fullTime / replicationTime << "x faster)\n";
+	std::cout << "Truncated snapshots: " << truncated << ", rejected snapshots: " << rejected << "\n";
+	std::cout << "Checked " << checkedBodies << " replicated bodies, max position error " << maxError << " m (precision " << settings.positionPrecision << ")\n";
+	return maxError <= settings.positionPrecision ? 0 : 1;
+}
@@ -0,0 +1,87 @@
+/*
+* Builds a level of 100k bodies with the per entity calls (createEntity, addMotionState, set*Collider, addRigidBody),
+* saves it with Scene::save and then loads it back with Scene::load into fresh worlds.
+* The level uses a handful of shapes and prefabs like a real one, so the loader resolves them once and creates
+* the bodies straight from the mapped arrays.
+*/
+
+#include <BulletECS/BulletECS.h>
+#include <chrono>
+#include <iostream>
+#include <vector>
+#include <cstdio>
+
+using namespace BulletECS;
+using Clock = std::chrono::steady_clock;
+using Milliseconds = std::chrono::duration<double, std::milli>;
+
+static constexpr size_t ENTITY_COUNT = 100000;
+static constexpr int RUNS = 5;
+static const char* SCENE_PATH = "scene_loading_benchmark.bin";
+
+static PhysicsWorldConfig makeConfig()
+{
+	PhysicsWorldConfig config;
+	config.maxEntities = ENTITY_COUNT + 16;
+	config.expectedEntities = ENTITY_COUNT;
+	return config;
+}
+
+//a grid of static boxes, sleeping crates and a few kinds of props
+static void buildLevel(PhysicsWorld& world)
+{
+	const size_t side = 100;
+	for (size_t i = 0; i < ENTITY_COUNT; i++)
+	{
+		Entity entity = world.createEntity();
+		btTransform transform = btTransform::getIdentity();
+		transform.setOrigin(btVector3(float(i % side) * 3.0f, float(i / (side * side)) * 3.0f, float(i / side % side) * 3.0f));
+		world.addMotionState(entity, transform);
+		switch (i % 4)
+		{
+		case 0: world.setBoxCollider(entity, { 1.0f, 1.0f, 1.0f }); world.addRigidBody(entity, 0.0f); break;
+		case 1: world.setBoxCollider(entity, { 0.5f, 0.5f, 0.5f }); world.addRigidBody(entity, 2.0f, 0.1f); break;
+		case 2: world.setSphereCollider(entity, 0.4f); world.addRigidBody(entity, 1.0f, 0.5f); break;
+		default: world.setCapsuleCollider(entity, 0.3f, 1.0f); world.addRigidBody(entity, 1.0f); break;
+		}
+	}
+}
+
+int main()
+{
+	double buildTime = 0.0;
+	{
+		PhysicsWorld world(makeConfig());
+		const Clock::time_point start = Clock::now();
+		buildLevel(world);
+		buildTime = Milliseconds(Clock::now() - start).count();
+
+		const Clock::time_point saveStart = Clock::now();
+		if (!Scene::save(world, SCENE_PATH))
+		{
+			std::cerr << "Could not write " << SCENE_PATH << "\n";
+			return 1;
+		}
+		std::cout << "Scene::save: " << Milliseconds(Clock::now() - saveStart).count() << " ms\n";
+	}
+	std::cout << "Per entity calls: " << buildTime << " ms for " << ENTITY_COUNT << " entities\n";
+
+	double bestLoad = 0.0;
+	for (int run = 0; run < RUNS; run++)
+	{
+		PhysicsWorld world(makeConfig());
+		std::vector<Entity> entities;
+		SceneLoadStats stats;
+		if (!Scene::load(world, SCENE_PATH, &entities, &stats) || entities.size() != ENTITY_COUNT)
+		{
+			std::cerr << "Could not load " << SCENE_PATH << "\n";
+			return 1;
+		}
+		std::cout << "Scene::load run " << run << ": " << stats.totalTime << " ms (map " << stats.mapTime << ", prefabs " << stats.prefabTime
+			<< ", instances " << stats.instanceTime << ") " << stats.shapes << " shapes, " << stats.prefabs << " prefabs\n";
+		bestLoad = run == 0 || stats.totalTime < bestLoad ? stats.totalTime : bestLoad;
+	}
+	std::cout << "Best load: " << bestLoad << " ms, " << buildTime / bestLoad << "x faster than the per entity calls\n";
+	std::remove(SCENE_PATH);
+	return 0;
+}
@@ -0,0 +1,259 @@
+#include "Scenarios.h"
+#include <BulletECS/BulletECS.h>
+#include <vector>
+
+using namespace BulletECS;
+
+namespace Suite
+{
+	namespace
+	{
+		struct LifeTimeComponent
+		{
+			LifeTimeComponent(int stepsAlive) : remainingSteps(stepsAlive) {}
+			int remainingSteps;
+		};
+
+		PhysicsWorldConfig makeConfig(size_t entityCount)
+		{
+			PhysicsWorldConfig config;
+			config.maxEntities = static_cast<entity_id_t>(entityCount + 16);
+			config.expectedEntities = entityCount;
+			return config;
+		}
+
+		Entity createBody(PhysicsWorld& world, btVector3 position)
+		{
+			Entity entity = world.createEntity();
+			btTransform transform = btTransform::getIdentity();
+			transform.setOrigin(position);
+			world.addMotionState(entity, transform);
+			return entity;
+		}
+
+		Entity spawnSphere(PhysicsWorld& world, btVector3 position)
+		{
+			Entity entity = createBody(world, position);
+			world.setSphereCollider(entity, 0.5f);
+			world.addRigidBody(entity, 1.0f, 0.5f);
+			return entity;
+		}
+
+		Entity spawnBox(PhysicsWorld& world, btVector3 position, float mass)
+		{
+			Entity entity = createBody(world, position);
+			world.setBoxCollider(entity, { 0.5f, 0.5f, 0.5f });
+			world.addRigidBody(entity, mass, 0.0f);
+			return entity;
+		}
+
+		void createFloor(PhysicsWorld& world, float halfExtent)
+		{
+			Entity floor = createBody(world, { 0, -1, 0 });
+			world.setBoxCollider(floor, { halfExtent, 1, halfExtent });
+			world.addRigidBody(floor, 0.0f, 0.5f);
+		}
+
+		btVector3 gridPosition(size_t index, size_t side, float spacing, float height)
+		{
+			float x, y, z;
+			Suite::gridPosition(index, side, spacing, height, x, y, z);
+			return { x, y, z };
+		}
+
+		double sumHeights(const PhysicsWorld& world)
+		{
+			double sum = 0.0;
+			for (Entity e : world.iterateMotionStates())
+			{
+				sum += world.getMotionState(e)->m_graphicsWorldTrans.getOrigin().getY();
+			}
+			return sum;
+		}
+
+		class Churn : public ScenarioInstance
+		{
+		public:
+			Churn(size_t maxAlive)
+				: m_world(makeConfig(maxAlive)), m_lifetimes(maxAlive + 16), m_maxAlive(maxAlive),
+				  m_spawnsPerStep(maxAlive / 60 > 0 ? maxAlive / 60 : 1), m_side(gridSide(m_spawnsPerStep))
+			{
+				createFloor(m_world, m_side * 2.0f + 10.0f);
+				spawn(maxAlive / 2);
+			}
+
+			void iterate() override
+			{
+				spawn(m_spawnsPerStep);
+				m_world.stepSimulation(TIME_STEP);
+				for (Entity e : m_lifetimes)
+				{
+					if (--m_lifetimes.get(e)->remainingSteps <= 0)
+					{
+						m_entitiesToDestroy.push_back(e);
+					}
+				}
+				for (Entity e : m_entitiesToDestroy)
+				{
+					m_lifetimes.remove(e);
+					m_world.destroyEntity(e);
+					m_alive--;
+				}
+				m_entitiesToDestroy.clear();
+			}
+
+			double checksum() const override { return sumHeights(m_world); }
+
+		private:
+			void spawn(size_t count)
+			{
+				for (size_t i = 0; i < count && m_alive < m_maxAlive; i++, m_alive++, m_spawned++)
+				{
+					m_lifetimes.add(spawnSphere(m_world, gridPosition(m_spawned % m_spawnsPerStep, m_side, 1.5f, 10.0f)), CHURN_LIFETIME_STEPS);
+				}
+			}
+
+		private:
+			PhysicsWorld m_world;
+			ComponentPool<LifeTimeComponent> m_lifetimes;
+			std::vector<Entity> m_entitiesToDestroy;
+			size_t m_maxAlive;
+			size_t m_spawnsPerStep;
+			size_t m_side;
+			size_t m_alive = 0;
+			size_t m_spawned = 0;
+		};
+
+		class StaticHeavy : public ScenarioInstance
+		{
+		public:
+			StaticHeavy(size_t staticCount)
+				: m_world(makeConfig(staticCount + staticCount / 10))
+			{
+				size_t side = gridSide(staticCount);
+				for (size_t i = 0; i < staticCount; i++)
+				{
+					spawnBox(m_world, gridPosition(i, side, 2.0f, 0.0f), 0.0f);
+				}
+				size_t dynamicCount = staticCount / 10;
+				size_t dynamicSide = gridSide(dynamicCount);
+				for (size_t i = 0; i < dynamicCount; i++)
+				{
+					spawnSphere(m_world, gridPosition(i, dynamicSide, 2.0f * side / dynamicSide, 5.0f));
+				}
+			}
+
+			void iterate() override { m_world.stepSimulation(TIME_STEP); }
+			double checksum() const override { return sumHeights(m_world); }
+
+		private:
+			PhysicsWorld m_world;
+		};
+
+		class Stacking : public ScenarioInstance
+		{
+		public:
+			Stacking(size_t boxCount)
+				: m_world(makeConfig(boxCount))
+			{
+				size_t towers = boxCount / STACK_HEIGHT;
+				size_t side = gridSide(towers);
+				createFloor(m_world, side * 1.5f + 10.0f);
+				for (size_t tower = 0; tower < towers; tower++)
+				{
+					btVector3 base = gridPosition(tower, side, 3.0f, 0.5f);
+					for (int level = 0; level < STACK_HEIGHT; level++)
+					{
+						spawnBox(m_world, base + btVector3(0, static_cast<float>(level), 0), 1.0f);
+					}
+				}
+			}
+
+			void iterate() override { m_world.stepSimulation(TIME_STEP); }
+			double checksum() const override { return sumHeights(m_world); }
+
+		private:
+			PhysicsWorld m_world;
+		};
+
+		class SpawnBurst : public ScenarioInstance
+		{
+		public:
+			SpawnBurst(size_t burstSize)
+				: m_world(makeConfig(burstSize)), m_burstSize(burstSize), m_side(gridSide(burstSize))
+			{
+				createFloor(m_world, m_side + 10.0f);
+				m_entities.reserve(burstSize);
+			}
+
+			void iterate() override
+			{
+				for (size_t i = 0; i < m_burstSize; i++)
+				{
+					m_entities.push_back(spawnSphere(m_world, gridPosition(i, m_side, 1.5f, 1.0f)));
+				}
+				m_world.stepSimulation(TIME_STEP);
+				m_checksum = sumHeights(m_world);
+				for (Entity e : m_entities)
+				{
+					m_world.destroyEntity(e);
+				}
+				m_entities.clear();
+			}
+
+			double checksum() const override { return m_checksum; }
+
+		private:
+			PhysicsWorld m_world;
+			std::vector<Entity> m_entities;
+			size_t m_burstSize;
+			size_t m_side;
+			double m_checksum = 0.0;
+		};
+
+		class Iteration : public ScenarioInstance
+		{
+		public:
+			Iteration(size_t bodyCount)
+				: m_world(makeConfig(bodyCount))
+			{
+				size_t side = gridSide(bodyCount);
+				for (size_t i = 0; i < bodyCount; i++)
+				{
+					spawnSphere(m_world, gridPosition(i, side, 3.0f, 1.0f));
+				}
+			}
+
+			void iterate() override
+			{
+				double sum = 0.0;
+				for (Entity e : m_world.iterateMotionStates())
+				{
+					sum += m_world.getMotionState(e)->m_graphicsWorldTrans.getOrigin().getY();
+				}
+				m_checksum = sum;
+			}
+
+			double checksum() const override { return m_checksum; }
+
+		private:
+			PhysicsWorld m_world;
+			double m_checksum = 0.0;
+		};
+
+		template <class T>
+		Scenario makeScenario(const char* name, std::vector<size_t> entityCounts)
+		{
+			return Scenario{ name, "BulletECS", std::move(entityCounts), [](size_t entityCount) { return std::make_unique<T>(entityCount); } };
+		}
+	}
+
+	void addBulletECSScenarios(std::vector<Scenario>& scenarios)
+	{
+		scenarios.push_back(makeScenario<Churn>("churn", { 1000, 10000 }));
+		scenarios.push_back(makeScenario<StaticHeavy>("static_heavy", { 10000, 100000 }));
+		scenarios.push_back(makeScenario<Stacking>("stacking", { 1000, 5000 }));
+		scenarios.push_back(makeScenario<SpawnBurst>("spawn_burst", { 1000, 10000 }));
+		scenarios.push_back(makeScenario<Iteration>("iteration", { 1000, 10000, 100000, 1000000 }));
+	}
+}
@@ -0,0 +1,143 @@
+#include "Harness.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <ctime>
+#include <iomanip>
+#include <numeric>
+
+namespace Suite
+{
+	using Clock = std::chrono::steady_clock;
+	using Milliseconds = std::chrono::duration<double, std::milli>;
+
+	static double percentile(const std::vector<double>& sorted, double p)
+	{
+		//linear interpolation between the closest ranks
+		double rank = p * (sorted.size() - 1);
+		size_t low = static_cast<size_t>(rank);
+		size_t high = std::min(low + 1, sorted.size() - 1);
+		return sorted[low] + (sorted[high] - sorted[low]) * (rank - low);
+	}
+
+	Summary summarize(std::vector<double> samples)
+	{
+		Summary summary;
+		if (samples.empty())
+		{
+			return summary;
+		}
+		std::sort(samples.begin(), samples.end());
+		summary.samples = samples.size();
+		summary.min = samples.front();
+		summary.max = samples.back();
+		summary.mean = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+		double variance = 0.0;
+		for (double sample : samples)
+		{
+			variance += (sample - summary.mean) * (sample - summary.mean);
+		}
+		summary.stddev = std::sqrt(variance / samples.size());
+		summary.p50 = percentile(samples, 0.50);
+		summary.p90 = percentile(samples, 0.90);
+		summary.p99 = percentile(samples, 0.99);
+		return summary;
+	}
+
+	std::vector<Result> runScenarios(const std::vector<Scenario>& scenarios, const HarnessOptions& options, std::ostream& log)
+	{
+		std::vector<Result> results;
+		for (const Scenario& scenario : scenarios)
+		{
+			if (!options.filter.empty() && (scenario.name + "/" + scenario.backend).find(options.filter) == std::string::npos)
+			{
+				continue;
+			}
+			for (size_t entityCount : scenario.entityCounts)
+			{
+				if (entityCount > options.maxEntities)
+				{
+					continue;
+				}
+				std::vector<double> setupSamples;
+				std::vector<double> iterationSamples;
+				std::vector<double> teardownSamples;
+				iterationSamples.reserve(options.iterations * options.repeats);
+				double checksum = 0.0;
+
+				for (size_t repeat = 0; repeat < options.repeats; repeat++)
+				{
+					Clock::time_point setupStart = Clock::now();
+					std::unique_ptr<ScenarioInstance> instance = scenario.create(entityCount);
+					setupSamples.push_back(Milliseconds(Clock::now() - setupStart).count());
+
+					for (size_t i = 0; i < options.warmupIterations; i++)
+					{
+						instance->iterate();
+					}
+					for (size_t i = 0; i < options.iterations; i++)
+					{
+						Clock::time_point start = Clock::now();
+						instance->iterate();
+						iterationSamples.push_back(Milliseconds(Clock::now() - start).count());
+					}
+					checksum = instance->checksum();
+
+					Clock::time_point teardownStart = Clock::now();
+					instance.reset();
+					teardownSamples.push_back(Milliseconds(Clock::now() - teardownStart).count());
+				}
+
+				Result result;
+				result.scenario = scenario.name;
+				result.backend = scenario.backend;
+				result.entities = entityCount;
+				result.setupMs = summarize(std::move(setupSamples));
+				result.iterationMs = summarize(std::move(iterationSamples));
+				result.teardownMs = summarize(std::move(teardownSamples));
+				result.checksum = checksum;
+
+				log << std::left << std::setw(14) << result.scenario << std::setw(10) << result.backend << std::right << std::setw(9) << result.entities
+					<< std::fixed << std::setprecision(3)
+					<< "  setup " << std::setw(10) << result.setupMs.p50 << " ms"
+					<< "  iter p50 " << std::setw(9) << result.iterationMs.p50 << " ms"
+					<< "  p90 " << std::setw(9) << result.iterationMs.p90 << " ms"
+					<< "  p99 " << std::setw(9) << result.iterationMs.p99 << " ms"
+					<< "  checksum " << result.checksum << "\n" << std::defaultfloat;
+				results.push_back(std::move(result));
+			}
+		}
+		return results;
+	}
+
+	static void writeSummary(std::ostream& out, const Summary& summary)
+	{
+		out << "{\"samples\":" << summary.samples
+			<< ",\"min\":" << summary.min << ",\"max\":" << summary.max
+			<< ",\"mean\":" << summary.mean << ",\"stddev\":" << summary.stddev
+			<< ",\"p50\":" << summary.p50 << ",\"p90\":" << summary.p90 << ",\"p99\":" << summary.p99 << "}";
+	}
+
+	void writeJson(std::ostream& out, const std::vector<Result>& results, const HarnessOptions& options)
+	{
+		out << std::setprecision(6) << std::fixed;
+		out << "{\n\"suite\":\"BulletECS\",\n\"timestamp\":" << static_cast<long long>(std::time(nullptr)) << ",\n";
+		out << "\"options\":{\"warmupIterations\":" << options.warmupIterations << ",\"iterations\":" << options.iterations
+			<< ",\"repeats\":" << options.repeats << ",\"maxEntities\":" << options.maxEntities << "},\n";
+		out << "\"results\":[";
+		for (size_t i = 0; i < results.size(); i++)
+		{
+			const Result& result = results[i];
+			out << (i == 0 ? "\n" : ",\n") << "{\"scenario\":\"" << result.scenario << "\",\"backend\":\"" << result.backend
+				<< "\",\"entities\":" << result.entities << ",\"checksum\":" << result.checksum;
+			out << ",\"setupMs\":";
+			writeSummary(out, result.setupMs);
+			out << ",\"iterationMs\":";
+			writeSummary(out, result.iterationMs);
+			out << ",\"teardownMs\":";
+			writeSummary(out, result.teardownMs);
+			out << "}";
+		}
+		out << "\n]\n}\n" << std::defaultfloat;
+	}
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Minimal benchmark harness: every scenario is run for each of its entity counts, with warmup iterations,
+// measured iterations and repeats on fresh instances. Timings are summarized with percentiles and written as JSON.
+namespace Suite
+{
+	// One instance of a scenario at a given entity count. Construction is the setup (timed separately),
+	// iterate() is the measured unit of work, usually one simulation step
+	class ScenarioInstance
+	{
+	public:
+		virtual ~ScenarioInstance() = default;
+		virtual void iterate() = 0;
+		//a value derived from the simulated state, printed so the work cannot be optimized away and both backends can be compared
+		virtual double checksum() const { return 0.0; }
+	};
+
+	struct Scenario
+	{
+		std::string name;
+		std::string backend; //"BulletECS" or "RawBullet"
+		std::vector<size_t> entityCounts;
+		std::function<std::unique_ptr<ScenarioInstance>(size_t entityCount)> create;
+	};
+
+	struct HarnessOptions
+	{
+		size_t warmupIterations = 10;
+		size_t iterations = 100;
+		size_t repeats = 5;
+		size_t maxEntities = 1000000; //entity counts above this are skipped
+		std::string filter; //only scenarios whose "name/backend" contains it
+	};
+
+	struct Summary
+	{
+		size_t samples = 0;
+		double min = 0, max = 0, mean = 0, stddev = 0;
+		double p50 = 0, p90 = 0, p99 = 0;
+	};
+
+	Summary summarize(std::vector<double> samples);
+
+	struct Result
+	{
+		std::string scenario;
+		std::string backend;
+		size_t entities = 0;
+		Summary setupMs; //one sample per repeat
+		Summary iterationMs; //iterations * repeats samples
+		Summary teardownMs;
+		double checksum = 0.0; //of the last repeat
+	};
+
+	std::vector<Result> runScenarios(const std::vector<Scenario>& scenarios, const HarnessOptions& options, std::ostream& log);
+	void writeJson(std::ostream& out, const std::vector<Result>& results, const HarnessOptions& options);
+}
@@ -0,0 +1,272 @@
+#include "Scenarios.h"
+#include <btBulletDynamicsCommon.h>
+#include <memory>
+#include <vector>
+
+namespace Suite
+{
+	namespace
+	{
+		// Plain Bullet setup as in Bullet's HelloWorld, with the shapes shared by every body like the library does
+		class RawWorld
+		{
+		public:
+			RawWorld()
+				: m_dispatcher(&m_collisionConfiguration),
+				  m_world(&m_dispatcher, &m_broadphase, &m_solver, &m_collisionConfiguration),
+				  m_sphereShape(0.5f),
+				  m_boxShape({ 0.5f, 0.5f, 0.5f })
+			{
+				m_world.setGravity({ 0, -10, 0 });
+			}
+
+			~RawWorld()
+			{
+				for (int i = m_world.getNumCollisionObjects() - 1; i >= 0; i--)
+				{
+					destroy(btRigidBody::upcast(m_world.getCollisionObjectArray()[i]));
+				}
+			}
+
+			btRigidBody* createBody(btCollisionShape* shape, btVector3 position, float mass, float restitution)
+			{
+				btTransform transform = btTransform::getIdentity();
+				transform.setOrigin(position);
+				btVector3 inertia(0, 0, 0);
+				if (mass != 0.0f)
+				{
+					shape->calculateLocalInertia(mass, inertia);
+				}
+				btRigidBody::btRigidBodyConstructionInfo info(mass, new btDefaultMotionState(transform), shape, inertia);
+				info.m_restitution = restitution;
+				btRigidBody* body = new btRigidBody(info);
+				m_world.addRigidBody(body);
+				return body;
+			}
+
+			btRigidBody* spawnSphere(btVector3 position) { return createBody(&m_sphereShape, position, 1.0f, 0.5f); }
+			btRigidBody* spawnBox(btVector3 position, float mass) { return createBody(&m_boxShape, position, mass, 0.0f); }
+
+			void createFloor(float halfExtent)
+			{
+				m_floorShapes.push_back(std::make_unique<btBoxShape>(btVector3(halfExtent, 1, halfExtent)));
+				createBody(m_floorShapes.back().get(), { 0, -1, 0 }, 0.0f, 0.5f);
+			}
+
+			void destroy(btRigidBody* body)
+			{
+				m_world.removeRigidBody(body);
+				delete body->getMotionState();
+				delete body;
+			}
+
+			void step() { m_world.stepSimulation(TIME_STEP); }
+
+			double sumHeights() const
+			{
+				double sum = 0.0;
+				btTransform transform;
+				for (int i = 0; i < m_world.getNumCollisionObjects(); i++)
+				{
+					btRigidBody::upcast(m_world.getCollisionObjectArray()[i])->getMotionState()->getWorldTransform(transform);
+					sum += transform.getOrigin().getY();
+				}
+				return sum;
+			}
+
+		private:
+			btDefaultCollisionConfiguration m_collisionConfiguration;
+			btCollisionDispatcher m_dispatcher;
+			btDbvtBroadphase m_broadphase;
+			btSequentialImpulseConstraintSolver m_solver;
+			btDiscreteDynamicsWorld m_world;
+			btSphereShape m_sphereShape;
+			btBoxShape m_boxShape;
+			std::vector<std::unique_ptr<btBoxShape>> m_floorShapes;
+		};
+
+		btVector3 gridPosition(size_t index, size_t side, float spacing, float height)
+		{
+			float x, y, z;
+			Suite::gridPosition(index, side, spacing, height, x, y, z);
+			return { x, y, z };
+		}
+
+		class Churn : public ScenarioInstance
+		{
+		public:
+			Churn(size_t maxAlive)
+				: m_maxAlive(maxAlive), m_spawnsPerStep(maxAlive / 60 > 0 ? maxAlive / 60 : 1), m_side(gridSide(m_spawnsPerStep))
+			{
+				m_world.createFloor(m_side * 2.0f + 10.0f);
+				m_alive.reserve(maxAlive);
+				spawn(maxAlive / 2);
+			}
+
+			void iterate() override
+			{
+				spawn(m_spawnsPerStep);
+				m_world.step();
+				//swap and pop keeps the live bodies contiguous, the usual way to store them without an ECS
+				for (size_t i = 0; i < m_alive.size();)
+				{
+					if (--m_alive[i].remainingSteps <= 0)
+					{
+						m_world.destroy(m_alive[i].body);
+						m_alive[i] = m_alive.back();
+						m_alive.pop_back();
+					}
+					else
+					{
+						i++;
+					}
+				}
+			}
+
+			double checksum() const override { return m_world.sumHeights(); }
+
+		private:
+			struct LivingBody
+			{
+				btRigidBody* body;
+				int remainingSteps;
+			};
+
+			void spawn(size_t count)
+			{
+				for (size_t i = 0; i < count && m_alive.size() < m_maxAlive; i++, m_spawned++)
+				{
+					m_alive.push_back({ m_world.spawnSphere(gridPosition(m_spawned % m_spawnsPerStep, m_side, 1.5f, 10.0f)), CHURN_LIFETIME_STEPS });
+				}
+			}
+
+		private:
+			RawWorld m_world;
+			std::vector<LivingBody> m_alive;
+			size_t m_maxAlive;
+			size_t m_spawnsPerStep;
+			size_t m_side;
+			size_t m_spawned = 0;
+		};
+
+		class StaticHeavy : public ScenarioInstance
+		{
+		public:
+			StaticHeavy(size_t staticCount)
+			{
+				size_t side = gridSide(staticCount);
+				for (size_t i = 0; i < staticCount; i++)
+				{
+					m_world.spawnBox(gridPosition(i, side, 2.0f, 0.0f), 0.0f);
+				}
+				size_t dynamicCount = staticCount / 10;
+				size_t dynamicSide = gridSide(dynamicCount);
+				for (size_t i = 0; i < dynamicCount; i++)
+				{
+					m_world.spawnSphere(gridPosition(i, dynamicSide, 2.0f * side / dynamicSide, 5.0f));
+				}
+			}
+
+			void iterate() override { m_world.step(); }
+			double checksum() const override { return m_world.sumHeights(); }
+
+		private:
+			RawWorld m_world;
+		};
+
+		class Stacking : public ScenarioInstance
+		{
+		public:
+			Stacking(size_t boxCount)
+			{
+				size_t towers = boxCount / STACK_HEIGHT;
+				size_t side = gridSide(towers);
+				m_world.createFloor(side * 1.5f + 10.0f);
+				for (size_t tower = 0; tower < towers; tower++)
+				{
+					btVector3 base = gridPosition(tower, side, 3.0f, 0.5f);
+					for (int level = 0; level < STACK_HEIGHT; level++)
+					{
+						m_world.spawnBox(base + btVector3(0, static_cast<float>(level), 0), 1.0f);
+					}
+				}
+			}
+
+			void iterate() override { m_world.step(); }
+			double checksum() const override { return m_world.sumHeights(); }
+
+		private:
+			RawWorld m_world;
+		};
+
+		class SpawnBurst : public ScenarioInstance
+		{
+		public:
+			SpawnBurst(size_t burstSize)
+				: m_burstSize(burstSize), m_side(gridSide(burstSize))
+			{
+				m_world.createFloor(m_side + 10.0f);
+				m_bodies.reserve(burstSize);
+			}
+
+			void iterate() override
+			{
+				for (size_t i = 0; i < m_burstSize; i++)
+				{
+					m_bodies.push_back(m_world.spawnSphere(gridPosition(i, m_side, 1.5f, 1.0f)));
+				}
+				m_world.step();
+				m_checksum = m_world.sumHeights();
+				for (btRigidBody* body : m_bodies)
+				{
+					m_world.destroy(body);
+				}
+				m_bodies.clear();
+			}
+
+			double checksum() const override { return m_checksum; }
+
+		private:
+			RawWorld m_world;
+			std::vector<btRigidBody*> m_bodies;
+			size_t m_burstSize;
+			size_t m_side;
+			double m_checksum = 0.0;
+		};
+
+		class Iteration : public ScenarioInstance
+		{
+		public:
+			Iteration(size_t bodyCount)
+			{
+				size_t side = gridSide(bodyCount);
+				for (size_t i = 0; i < bodyCount; i++)
+				{
+					m_world.spawnSphere(gridPosition(i, side, 3.0f, 1.0f));
+				}
+			}
+
+			void iterate() override { m_checksum = m_world.sumHeights(); }
+			double checksum() const override { return m_checksum; }
+
+		private:
+			RawWorld m_world;
+			double m_checksum = 0.0;
+		};
+
+		template <class T>
+		Scenario makeScenario(const char* name, std::vector<size_t> entityCounts)
+		{
+			return Scenario{ name, "RawBullet", std::move(entityCounts), [](size_t entityCount) { return std::make_unique<T>(entityCount); } };
+		}
+	}
+
+	void addRawBulletScenarios(std::vector<Scenario>& scenarios)
+	{
+		scenarios.push_back(makeScenario<Churn>("churn", { 1000, 10000 }));
+		scenarios.push_back(makeScenario<StaticHeavy>("static_heavy", { 10000, 100000 }));
+		scenarios.push_back(makeScenario<Stacking>("stacking", { 1000, 5000 }));
+		scenarios.push_back(makeScenario<SpawnBurst>("spawn_burst", { 1000, 10000 }));
+		scenarios.push_back(makeScenario<Iteration>("iteration", { 1000, 10000, 100000, 1000000 }));
+	}
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include "Harness.h"
+#include <vector>
+
+// Both backends implement the same scenarios with the same parameters, so their results can be compared line by line:
+//  - churn: spheres with a lifetime constantly destroyed and respawned (the ECSDemo workload)
+//  - static_heavy: a field of static boxes with a tenth as many dynamic spheres falling on it
+//  - stacking: towers of 10 boxes resting on a floor
+//  - spawn_burst: every iteration spawns all the entities, steps once and destroys them
+//  - iteration: reads the transform of every body, no stepping (what a renderer does each frame)
+namespace Suite
+{
+	constexpr float TIME_STEP = 1.0f / 60.0f;
+	constexpr int CHURN_LIFETIME_STEPS = 100;
+	constexpr int STACK_HEIGHT = 10;
+
+	void addBulletECSScenarios(std::vector<Scenario>& scenarios);
+	void addRawBulletScenarios(std::vector<Scenario>& scenarios);
+
+	// Deterministic spawn positions shared by both backends
+	inline void gridPosition(size_t index, size_t side, float spacing, float height, float& x, float& y, float& z)
+	{
+		x = (static_cast<float>(index % side) - side * 0.5f) * spacing;
+		z = (static_cast<float>((index / side) % side) - side * 0.5f) * spacing;
+		y = height + static_cast<float>(index / (side * side)) * spacing;
+	}
+
+	inline size_t gridSide(size_t count)
+	{
+		size_t side = 1;
+		while (side * side < count)
+		{
+			side++;
+		}
+		return side;
+	}
+}
@@ -0,0 +1,86 @@
+/*
+* Benchmark suite comparing BulletECS against the same scenarios written with plain Bullet, see Scenarios.h.
+* Results are printed as a table and written as JSON to track regressions between releases.
+*
+* Usage: BulletECS_BenchmarkSuite [--filter text] [--out results.json] [--warmup N] [--iterations N] [--repeats N] [--max-entities N] [--quick]
+*  --filter matches "scenario/backend", e.g. "churn" or "/RawBullet"
+*  --quick runs 1 repeat of 20 iterations up to 10k entities, to check that everything runs
+*/
+
+#include "Harness.h"
+#include "Scenarios.h"
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static bool parseArguments(int argc, char** argv, Suite::HarnessOptions& options, std::string& outputPath)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		const char* argument = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		if (std::strcmp(argument, "--quick") == 0)
+		{
+			options.warmupIterations = 2;
+			options.iterations = 20;
+			options.repeats = 1;
+			options.maxEntities = 10000;
+			continue;
+		}
+		if (!value)
+		{
+			std::cerr << "Missing value for " << argument << "\n";
+			return false;
+		}
+		i++;
+		if (std::strcmp(argument, "--filter") == 0) options.filter = value;
+		else if (std::strcmp(argument, "--out") == 0) outputPath = value;
+		else if (std::strcmp(argument, "--warmup") == 0) options.warmupIterations = std::strtoull(value, nullptr, 10);
+		else if (std::strcmp(argument, "--iterations") == 0) options.iterations = std::strtoull(value, nullptr, 10);
+		else if (std::strcmp(argument, "--repeats") == 0) options.repeats = std::strtoull(value, nullptr, 10);
+		else if (std::strcmp(argument, "--max-entities") == 0) options.maxEntities = std::strtoull(value, nullptr, 10);
+		else
+		{
+			std::cerr << "Unknown argument " << argument << "\n";
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	Suite::HarnessOptions options;
+	std::string outputPath = "benchmark_results.json";
+	if (!parseArguments(argc, argv, options, outputPath))
+	{
+		return 1;
+	}
+
+	//backends alternate per scenario so both run with a similar machine state
+	std::vector<Suite::Scenario> ecsScenarios;
+	std::vector<Suite::Scenario> rawScenarios;
+	Suite::addBulletECSScenarios(ecsScenarios);
+	Suite::addRawBulletScenarios(rawScenarios);
+	std::vector<Suite::Scenario> scenarios;
+	for (size_t i = 0; i < ecsScenarios.size() || i < rawScenarios.size(); i++)
+	{
+		if (i < ecsScenarios.size()) scenarios.push_back(ecsScenarios[i]);
+		if (i < rawScenarios.size()) scenarios.push_back(rawScenarios[i]);
+	}
+
+	std::vector<Suite::Result> results = Suite::runScenarios(scenarios, options, std::cout);
+
+	std::ofstream output(outputPath);
+	if (!output)
+	{
+		std::cerr << "Cannot write " << outputPath << "\n";
+		return 1;
+	}
+	Suite::writeJson(output, results, options);
+	std::cout << "Results written to " << outputPath << "\n";
+	return 0;
+}
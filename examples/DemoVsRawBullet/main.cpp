@@ -4,6 +4,7 @@
 * The examples also uses the library's Component Pool data structure to create a custom Lifetime Component for entities.
 * All dynamic rigid bodies have a lifetime componetn in this example, and when its lifetime gets to 0 they are destroyed,
 * and a new rigidbody entity is spawned.
+* The timers here only give a rough idea, for comparable numbers (warmup, repeats, percentiles, JSON output) use benchmarks/Suite.
 */
 
 #include <chrono>
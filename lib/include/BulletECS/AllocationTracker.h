@@ -0,0 +1,73 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// Counts heap allocations per thread, so tests and tools can check that the hot paths do not allocate.
+// Bullet allocations that reach the system heap are counted once the BulletAllocator hooks are installed (useArenaAllocator),
+// C++ allocations only in programs that replace operator new by putting this in exactly one of their source files:
+//
+//	BULLET_ECS_IMPLEMENT_ALLOCATION_TRACKER
+//
+// The library never replaces operator new by itself.
+namespace BulletECS
+{
+	namespace AllocationTracker
+	{
+		void recordAllocation(size_t size);
+		void markInterposed();
+		//true if the program replaced operator new with BULLET_ECS_IMPLEMENT_ALLOCATION_TRACKER
+		bool isInterposed();
+
+		//totals of the calling thread
+		uint64_t getAllocationCount();
+		uint64_t getAllocatedBytes();
+
+		// Allocations made by the current thread since the object was created
+		class ScopedCounter
+		{
+		public:
+			ScopedCounter() : m_startCount(getAllocationCount()), m_startBytes(getAllocatedBytes()) {}
+			uint64_t getAllocations() const { return getAllocationCount() - m_startCount; }
+			uint64_t getBytes() const { return getAllocatedBytes() - m_startBytes; }
+
+		private:
+			uint64_t m_startCount;
+			uint64_t m_startBytes;
+		};
+	}
+}
+
+#ifdef _MSC_VER
+#define BULLET_ECS_ALIGNED_MALLOC(size, alignment) _aligned_malloc(size, alignment)
+#define BULLET_ECS_ALIGNED_FREE(block) _aligned_free(block)
+#else
+#define BULLET_ECS_ALIGNED_MALLOC(size, alignment) std::aligned_alloc(alignment, ((size) + (alignment) - 1) / (alignment) * (alignment))
+#define BULLET_ECS_ALIGNED_FREE(block) std::free(block)
+#endif
+
+#define BULLET_ECS_IMPLEMENT_ALLOCATION_TRACKER \
+	void* operator new(std::size_t size) \
+	{ \
+		::BulletECS::AllocationTracker::recordAllocation(size); \
+		if (void* block = std::malloc(size > 0 ? size : 1)) return block; \
+		throw std::bad_alloc(); \
+	} \
+	void* operator new[](std::size_t size) { return ::operator new(size); } \
+	void* operator new(std::size_t size, std::align_val_t alignment) \
+	{ \
+		::BulletECS::AllocationTracker::recordAllocation(size); \
+		if (void* block = BULLET_ECS_ALIGNED_MALLOC(size > 0 ? size : 1, static_cast<std::size_t>(alignment))) return block; \
+		throw std::bad_alloc(); \
+	} \
+	void* operator new[](std::size_t size, std::align_val_t alignment) { return ::operator new(size, alignment); } \
+	void operator delete(void* block) noexcept { std::free(block); } \
+	void operator delete[](void* block) noexcept { std::free(block); } \
+	void operator delete(void* block, std::size_t) noexcept { std::free(block); } \
+	void operator delete[](void* block, std::size_t) noexcept { std::free(block); } \
+	void operator delete(void* block, std::align_val_t) noexcept { BULLET_ECS_ALIGNED_FREE(block); } \
+	void operator delete[](void* block, std::align_val_t) noexcept { BULLET_ECS_ALIGNED_FREE(block); } \
+	void operator delete(void* block, std::size_t, std::align_val_t) noexcept { BULLET_ECS_ALIGNED_FREE(block); } \
+	void operator delete[](void* block, std::size_t, std::align_val_t) noexcept { BULLET_ECS_ALIGNED_FREE(block); } \
+	static const bool bulletEcsAllocationTrackerInterposed = (::BulletECS::AllocationTracker::markInterposed(), true);
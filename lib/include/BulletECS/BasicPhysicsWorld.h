@@ -0,0 +1,184 @@
+#pragma once
+#include <tuple>
+#include <string>
+#include <utility>
+#include <type_traits>
+#include "BulletECS/PhysicsWorld.h"
+
+namespace BulletECS
+{
+	// PhysicsWorld with a set of user components fixed at compile time, e.g. BasicPhysicsWorld<Health, LifeTime>.
+	// Every user component has its own ComponentPool in a tuple, so access and iteration are resolved by the compiler without type lookups or virtual calls.
+	// Cleanup goes through the onEntityDestroyed and onEntityRelocated hooks, so destroyEntity and compact handle the user components even through a PhysicsWorld&
+	template <class... UserComponents>
+	class BasicPhysicsWorld : public PhysicsWorld
+	{
+		template <class T>
+		static constexpr bool isUserComponent = (std::is_same_v<T, UserComponents> || ...);
+		template <class T>
+		static constexpr bool isMutableBuiltInComponent = std::is_same_v<T, btRigidBody> || std::is_same_v<T, btDefaultMotionState> || std::is_same_v<T, TriggerGhostObject>;
+		template <class T>
+		static constexpr bool isBuiltInComponent = isMutableBuiltInComponent<T> || std::is_same_v<T, TagComponent> || std::is_same_v<T, CollisionLayerComponent>;
+		template <class T>
+		static constexpr size_t userComponentCount = (size_t(std::is_same_v<T, UserComponents>) + ... + 0);
+
+		static_assert(!(isBuiltInComponent<UserComponents> || ...), "Built-in components cannot be user components.");
+		static_assert(((userComponentCount<UserComponents> == 1) && ...), "Each user component type can only be listed once.");
+
+	public:
+		using PhysicsWorld::PhysicsWorld;
+
+		//only user components, the built-in ones are added with the PhysicsWorld methods (addRigidBody, addTag...)
+		template <class T, typename ...Args>
+		T* add(Entity entity, Args&&... args)
+		{
+			static_assert(isUserComponent<T>, "Only user components can be added with add<T>, use the PhysicsWorld methods for the built-in ones.");
+			return std::get<ComponentPool<T>>(m_userPools).add(entity, std::forward<Args>(args)...);
+		}
+
+		template <class T>
+		void remove(Entity entity)
+		{
+			static_assert(isUserComponent<T>, "Only user components can be removed with remove<T>, use the PhysicsWorld methods for the built-in ones.");
+			std::get<ComponentPool<T>>(m_userPools).remove(entity);
+		}
+
+		//these return nullptr if the entity does not have the component
+		template <class T>
+		T* get(Entity entity) { return getPool<T>().get(entity); }
+		template <class T>
+		const T* get(Entity entity) const { return getPool<T>().get(entity); }
+
+		template <class T>
+		bool has(Entity entity) const { return getPool<T>().has(entity); }
+
+		//user components plus btRigidBody, btDefaultMotionState and TriggerGhostObject
+		template <class T>
+		ComponentPool<T>& getPool()
+		{
+			if constexpr (std::is_same_v<T, btRigidBody>)
+			{
+				return iterateMutableEntitiesWithRigidBodies();
+			}
+			else if constexpr (std::is_same_v<T, btDefaultMotionState>)
+			{
+				return iterateMutableMotionStates();
+			}
+			else if constexpr (std::is_same_v<T, TriggerGhostObject>)
+			{
+				return getMutableTriggerPool();
+			}
+			else
+			{
+				static_assert(isUserComponent<T>, "Not a component of this world, tags and collision layers can only be read from a const world.");
+				return std::get<ComponentPool<T>>(m_userPools);
+			}
+		}
+
+		//also TagComponent and CollisionLayerComponent
+		template <class T>
+		const ComponentPool<T>& getPool() const
+		{
+			if constexpr (std::is_same_v<T, btRigidBody>)
+			{
+				return iterateEntitiesWithRigidBodies();
+			}
+			else if constexpr (std::is_same_v<T, btDefaultMotionState>)
+			{
+				return iterateMotionStates();
+			}
+			else if constexpr (std::is_same_v<T, TriggerGhostObject>)
+			{
+				return iterateTriggers();
+			}
+			else if constexpr (std::is_same_v<T, TagComponent>)
+			{
+				return getTagPool();
+			}
+			else if constexpr (std::is_same_v<T, CollisionLayerComponent>)
+			{
+				return getCollisionLayerPool();
+			}
+			else
+			{
+				static_assert(isUserComponent<T>, "Not a component of this world.");
+				return std::get<ComponentPool<T>>(m_userPools);
+			}
+		}
+
+		//Calls function(entity, T0&, T1&...) for every entity that has all the components, e.g.
+		//world.each<Health, btRigidBody>([](Entity e, Health& health, btRigidBody& rigidBody) {...});
+		//The pool of the first component drives the loop, so list the rarest one first
+		template <class... Ts, class Function>
+		void each(Function&& function)
+		{
+			static_assert(sizeof...(Ts) > 0, "each needs at least one component type.");
+			std::tuple<ComponentPool<Ts>&...> pools(getPool<Ts>()...);
+			for (Entity entity : std::get<0>(pools))
+			{
+				std::apply([&](auto&... pool)
+				{
+					if ((pool.has(entity) && ...))
+					{
+						function(entity, *pool.get(entity)...);
+					}
+				}, pools);
+			}
+		}
+
+		template <class... Ts, class Function>
+		void each(Function&& function) const
+		{
+			static_assert(sizeof...(Ts) > 0, "each needs at least one component type.");
+			std::tuple<const ComponentPool<Ts>&...> pools(getPool<Ts>()...);
+			for (Entity entity : std::get<0>(pools))
+			{
+				std::apply([&](const auto&... pool)
+				{
+					if ((pool.has(entity) && ...))
+					{
+						function(entity, *pool.get(entity)...);
+					}
+				}, pools);
+			}
+		}
+
+		//the user pools are listed after the built-in sections in template argument order
+		MemoryReport memoryReport() const
+		{
+			MemoryReport report = PhysicsWorld::memoryReport();
+			size_t index = 0;
+			std::apply([&](const auto&... pool)
+			{
+				(report.sections.push_back(pool.getMemoryUsage("User component pool " + std::to_string(index++))), ...);
+			}, m_userPools);
+			return report;
+		}
+
+	protected:
+		void onEntityDestroyed(Entity entity) override
+		{
+			std::apply([entity](auto&... pool)
+			{
+				((pool.has(entity) ? pool.remove(entity) : void()), ...);
+			}, m_userPools);
+		}
+
+		//the user components follow their entities to the new IDs
+		void onEntityRelocated(Entity from, Entity to) override
+		{
+			std::apply([from, to](auto&... pool)
+			{
+				((pool.has(from) ? void(pool.relocate(from, to)) : void()), ...);
+			}, m_userPools);
+		}
+
+	private:
+		template <class T>
+		size_t userPoolSize() const { return getMaxEntities(); }
+
+	private:
+		//initialized after the base, so the pools are sized to the world's entity limit
+		std::tuple<ComponentPool<UserComponents>...> m_userPools{ userPoolSize<UserComponents>()... };
+	};
+}
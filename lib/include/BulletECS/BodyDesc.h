@@ -0,0 +1,70 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <btBulletDynamicsCommon.h>
+#include "BulletECS/CollisionLayerComponent.h"
+namespace BulletECS
+{
+	// The shapes of CollisionShapeContainer that can be described by value, e.g. to save bodies to disk
+	enum class ColliderType : uint8_t
+	{
+		Box,
+		Sphere,
+		Cylinder,
+		Capsule,
+		Count
+	};
+
+	struct ColliderDesc
+	{
+		ColliderType type = ColliderType::Box;
+		//Box and Cylinder: half extents. Sphere: radius in x. Capsule: radius in x, height in y
+		btVector3 size = { 0.5f, 0.5f, 0.5f };
+	};
+
+	// Everything PhysicsWorld::addBodies needs to create a rigid body entity
+	struct BodyDesc
+	{
+		ColliderDesc collider;
+		btTransform transform = btTransform::getIdentity();
+		float mass = 0.0f; //0 for static bodies
+		float restitution = 0.0f;
+		collision_layer_t layer = DEFAULT_COLLISION_LAYER;
+	};
+
+	// A body resolved once for many instances: the shape is shared and the inertia precomputed, see PhysicsWorld::addPrefabInstances
+	struct BodyPrefab
+	{
+		std::shared_ptr<btCollisionShape> shape;
+		btVector3 localInertia = { 0, 0, 0 };
+		float mass = 0.0f;
+		float restitution = 0.0f;
+		collision_layer_t layer = DEFAULT_COLLISION_LAYER;
+	};
+
+	//false if the shape is not one of the ColliderTypes (e.g. a compound or a user shape)
+	inline bool describeCollider(const btCollisionShape* shape, ColliderDesc& desc)
+	{
+		switch (shape->getShapeType())
+		{
+		case BOX_SHAPE_PROXYTYPE:
+			desc.type = ColliderType::Box;
+			desc.size = static_cast<const btBoxShape*>(shape)->getHalfExtentsWithMargin();
+			return true;
+		case SPHERE_SHAPE_PROXYTYPE:
+			desc.type = ColliderType::Sphere;
+			desc.size = btVector3(static_cast<const btSphereShape*>(shape)->getRadius(), 0, 0);
+			return true;
+		case CYLINDER_SHAPE_PROXYTYPE:
+			desc.type = ColliderType::Cylinder;
+			desc.size = static_cast<const btCylinderShape*>(shape)->getHalfExtentsWithMargin();
+			return true;
+		case CAPSULE_SHAPE_PROXYTYPE:
+			desc.type = ColliderType::Capsule;
+			desc.size = btVector3(static_cast<const btCapsuleShape*>(shape)->getRadius(), static_cast<const btCapsuleShape*>(shape)->getHalfHeight() * 2, 0);
+			return true;
+		default:
+			return false;
+		}
+	}
+}
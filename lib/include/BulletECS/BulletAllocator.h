@@ -0,0 +1,88 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+#include <array>
+namespace BulletECS
+{
+	struct BulletAllocationStats
+	{
+		uint64_t allocations = 0; //requests made by Bullet
+		uint64_t frees = 0;
+		uint64_t systemAllocations = 0; //requests that had to reach the system heap, should stop growing once a world is warmed up
+		uint64_t bytesInUse = 0;
+		uint64_t peakBytesInUse = 0;
+		uint64_t bytesReserved = 0; //bytes taken from the system heap, including free blocks kept by an arena
+	};
+
+	// Size-class pool allocator for Bullet's internal allocations (manifolds, collision algorithms, pair cache arrays...).
+	// Freed blocks are kept in per-class free lists and reused, so once a world reaches its steady state Bullet stops reaching the system heap.
+	// It can be used from any thread, blocks freed from another thread go back to the arena that allocated them.
+	class BulletArena
+	{
+	public:
+		BulletArena(size_t chunkSize = 256 * 1024);
+		~BulletArena();
+		BulletArena(const BulletArena&) = delete;
+		BulletArena& operator=(const BulletArena&) = delete;
+
+		void* allocate(size_t size);
+		void free(void* block);
+
+		BulletAllocationStats getStats() const;
+
+	private:
+		static constexpr size_t SIZE_CLASS_COUNT = 20; //powers of two from 32 bytes to 16 MB, bigger blocks go straight to the system heap
+		static constexpr size_t MIN_BLOCK_SIZE = 32;
+		static constexpr uint32_t LARGE_BLOCK = ~uint32_t(0);
+
+		static uint32_t sizeClassOf(size_t blockSize);
+		static size_t blockSizeOf(uint32_t sizeClass) { return MIN_BLOCK_SIZE << sizeClass; }
+		void* carveBlock(uint32_t sizeClass);
+
+	private:
+		struct FreeBlock
+		{
+			FreeBlock* next;
+		};
+
+		mutable std::mutex m_mutex;
+		std::array<FreeBlock*, SIZE_CLASS_COUNT> m_freeLists = {};
+		std::vector<void*> m_chunks;
+		char* m_chunkCursor = nullptr;
+		char* m_chunkEnd = nullptr;
+		size_t m_chunkSize;
+		BulletAllocationStats m_stats;
+	};
+
+	// Process-wide hooks set with btAlignedAllocSetCustom, every Bullet block carries a small header telling which arena (if any) owns it.
+	// Allocations go to the arena bound to the calling thread, or to the system heap if there is none.
+	// The hooks are opt in (PhysicsWorldConfig::useArenaAllocator) and cannot free blocks allocated without their header,
+	// so they must be installed before any Bullet object exists. Do not call btAlignedAllocSetCustom yourself while using this library.
+	namespace BulletAllocator
+	{
+		//Installs the hooks, thread safe and later calls do nothing. Refuses (asserts and returns false) once a PhysicsWorld was
+		//created without them. Bullet objects made outside the library cannot be seen, call it at startup when creating any before the first world
+		bool install();
+		bool isInstalled();
+		//Called by every world created without the hooks, its Bullet blocks have no header so the hooks can no longer be installed
+		void markBulletInUse();
+
+		// Binds an arena to the current thread for the lifetime of the object, nullptr binds none
+		class ScopedArena
+		{
+		public:
+			ScopedArena(BulletArena* arena);
+			~ScopedArena();
+			ScopedArena(const ScopedArena&) = delete;
+			ScopedArena& operator=(const ScopedArena&) = delete;
+
+		private:
+			BulletArena* m_previous;
+		};
+
+		// Allocations made while no arena was bound
+		BulletAllocationStats getUnboundStats();
+	}
+}
@@ -1,2 +1,10 @@
 #pragma once
 #include "BulletECS/PhysicsWorld.h"
+#include "BulletECS/BasicPhysicsWorld.h"
+#include "BulletECS/WorldBatch.h"
+#include "BulletECS/SystemScheduler.h"
+#include "BulletECS/WorldStreamer.h"
+#include "BulletECS/Scene.h"
+#include "BulletECS/Replay.h"
+#include "BulletECS/Replication.h"
+#include "BulletECS/Heightfield.h"
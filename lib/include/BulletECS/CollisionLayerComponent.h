@@ -0,0 +1,99 @@
+#pragma once
+#include <cstdint>
+#include <array>
+#include <cassert>
+#include <btBulletDynamicsCommon.h>
+#include "BulletECS/TriggerComponent.h"
+namespace BulletECS
+{
+	using collision_layer_t = uint8_t;
+	//each layer is one bit of the Bullet collision filter group, so there are as many layers as bits in the group
+	constexpr collision_layer_t MAX_COLLISION_LAYERS = 32;
+	constexpr collision_layer_t DEFAULT_COLLISION_LAYER = 0;
+
+	struct CollisionLayerComponent
+	{
+		CollisionLayerComponent(collision_layer_t l) : layer(l) {}
+		collision_layer_t layer;
+	};
+
+	// Symmetric layer-vs-layer table, by default every layer collides with every other
+	class CollisionLayerMatrix
+	{
+	public:
+		CollisionLayerMatrix() { m_masks.fill(~uint32_t(0)); }
+
+		void setCollides(collision_layer_t a, collision_layer_t b, bool collide)
+		{
+			assert(a < MAX_COLLISION_LAYERS && b < MAX_COLLISION_LAYERS && "Collision layer out of bounds.");
+			if (collide)
+			{
+				m_masks[a] |= layerBit(b);
+				m_masks[b] |= layerBit(a);
+			}
+			else
+			{
+				m_masks[a] &= ~layerBit(b);
+				m_masks[b] &= ~layerBit(a);
+			}
+		}
+
+		inline bool collides(collision_layer_t a, collision_layer_t b) const { return (m_masks[a] & layerBit(b)) != 0; }
+
+		// layers that the given layer collides with, as a Bullet collision filter mask
+		inline uint32_t getMask(collision_layer_t layer) const { return m_masks[layer]; }
+
+		static inline uint32_t layerBit(collision_layer_t layer) { return uint32_t(1) << layer; }
+
+	private:
+		std::array<uint32_t, MAX_COLLISION_LAYERS> m_masks;
+	};
+
+	// Culls broadphase pairs with the layer matrix before Bullet creates the pair (and later its manifold).
+	// The matrix is read on every test, so changing it affects new pairs without re-adding bodies.
+	class CollisionLayerFilter : public btOverlapFilterCallback
+	{
+	public:
+		CollisionLayerFilter(const CollisionLayerMatrix& matrix) : m_matrix(matrix) {}
+
+		bool needBroadphaseCollision(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1) const override
+		{
+			const uint32_t group0 = static_cast<uint32_t>(proxy0->m_collisionFilterGroup);
+			const uint32_t group1 = static_cast<uint32_t>(proxy1->m_collisionFilterGroup);
+			const btCollisionObject* obj0 = static_cast<const btCollisionObject*>(proxy0->m_clientObject);
+			const btCollisionObject* obj1 = static_cast<const btCollisionObject*>(proxy1->m_clientObject);
+
+			//Bullet's own filter groups are single bits too, so objects added directly through Bullet are told apart by their missing entity
+			//and keep Bullet's default group/mask test
+			if (!isLibraryObject(obj0) || !isLibraryObject(obj1))
+			{
+				return (group0 & static_cast<uint32_t>(proxy1->m_collisionFilterMask)) != 0 &&
+					(group1 & static_cast<uint32_t>(proxy0->m_collisionFilterMask)) != 0;
+			}
+
+			//static vs static pairs never produce contacts
+			if (obj0->isStaticObject() && obj1->isStaticObject())
+			{
+				return false;
+			}
+
+			return (m_matrix.getMask(layerFromGroup(group0)) & group1) != 0;
+		}
+
+	private:
+		static inline bool isLibraryObject(const btCollisionObject* object) { return object && getCollisionObjectEntity(object).ID != NULL_ENTITY; }
+
+		static inline collision_layer_t layerFromGroup(uint32_t group)
+		{
+			collision_layer_t layer = 0;
+			while ((group >>= 1) != 0)
+			{
+				layer++;
+			}
+			return layer;
+		}
+
+	private:
+		const CollisionLayerMatrix& m_matrix;
+	};
+}
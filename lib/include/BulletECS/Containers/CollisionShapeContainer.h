@@ -1,31 +1,104 @@
 #pragma once
 #include "BulletECS/Entity.h"
 #include <unordered_map>
+#include <map>
+#include <tuple>
 #include <string>
+#include <vector>
 #include <memory>
+#include <cstdint>
+#include <cstring>
 #include <btBulletDynamicsCommon.h>
+#include "BulletECS/MemoryReport.h"
+#include "BulletECS/BodyDesc.h"
+#include "BulletECS/Heightfield.h"
 namespace BulletECS
 {
 
 	class CollisionShapeContainer
 	{
 	public:
+		CollisionShapeContainer() : CollisionShapeContainer(MAX_ENTITIES) {}
+		//the entity table is allocated up front, so assigning shapes to entities never allocates
+		explicit CollisionShapeContainer(size_t maxEntities) : m_entityShapes(maxEntities + 1) {}
+
 		btBoxShape* setBox(Entity entity, btVector3 halfExtents);
 		btCylinderShape* setCylinder(Entity entity, btVector3 halfExtents);
 		btSphereShape* setSphere(Entity entity, float radius);
 		btCapsuleShape* setCapsule(Entity entity, float radius, float height);
 		btCollisionShape* setFromExistentEntity(Entity entity, Entity existentEntityWithCollider);
+		//A file is mapped once and each of its tiles has one shape, shared by the entities using it. Both are released with their last user,
+		//so streamed terrain only keeps the tiles in use. Null if the file is not a valid heightfield or the tile is out of range
+		HeightfieldTileShape* setHeightfieldTile(Entity entity, const std::string& path, uint32_t tileX, uint32_t tileZ);
+
+		//The shared shape of the desc, created the first time. Bulk loaders resolve each distinct shape once and give it to many entities with assign
+		const std::shared_ptr<btCollisionShape>& acquire(const ColliderDesc& desc);
+		void assign(Entity entity, const std::shared_ptr<btCollisionShape>& shape);
 
 		void remove(Entity entity);
 
-		inline bool has(Entity entity) const { return m_entitiesWithShape.find(entity.ID) != m_entitiesWithShape.end(); }
+		inline bool has(Entity entity) const { return m_entityShapes[entity.ID] != nullptr; }
 
 		btCollisionShape* get(Entity entity);
 		const btCollisionShape* get(Entity entity) const;
-		
+
+		//colliders that reused an existing shape / created a new one, since the container was created
+		inline uint64_t getCacheHits() const { return m_cacheHits; }
+		inline uint64_t getCacheMisses() const { return m_cacheMisses; }
+		inline size_t getUniqueShapeCount() const { return m_uniqueCollisionShapes.size(); }
+		size_t getHeightfieldTileCount() const;
+		inline size_t getEntityCount() const { return m_entityCount; }
+
+		//the key and entity tables
+		MemoryUsage getTableMemoryUsage() const;
+		//the shapes themselves, shared between entities
+		MemoryUsage getShapeMemoryUsage() const;
+
+
+	private:
+		// Shapes are shared when their type and dimensions are bitwise equal, the key is built without allocating
+		struct ShapeKey
+		{
+			int type;
+			float dimensions[3];
+
+			bool operator==(const ShapeKey& other) const { return std::memcmp(this, &other, sizeof(ShapeKey)) == 0; }
+		};
+		static_assert(sizeof(ShapeKey) == 16, "ShapeKey must not have padding, it is compared and hashed bytewise.");
+
+		struct ShapeKeyHash
+		{
+			size_t operator()(const ShapeKey& key) const
+			{
+				//FNV-1a over the key bytes
+				const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&key);
+				uint64_t hash = 14695981039346656037ull;
+				for (size_t i = 0; i < sizeof(ShapeKey); i++)
+				{
+					hash = (hash ^ bytes[i]) * 1099511628211ull;
+				}
+				return static_cast<size_t>(hash);
+			}
+		};
+
+		template <class Shape, class... Args>
+		const std::shared_ptr<btCollisionShape>& acquireShared(const ShapeKey& key, Args&&... args);
+		template <class Shape, class... Args>
+		Shape* setShared(Entity entity, const ShapeKey& key, Args&&... args);
+		std::shared_ptr<const HeightfieldData> acquireHeightfield(const std::string& path);
+		//erases the heightfield and tile entries whose shapes were released
+		void pruneHeightfields();
 
 	private:
-		std::unordered_map <std::string, std::shared_ptr<btCollisionShape>> m_uniqueCollisionShapes;
-		std::unordered_map <entity_id_t, std::shared_ptr<btCollisionShape>> m_entitiesWithShape;
+		std::unordered_map<ShapeKey, std::shared_ptr<btCollisionShape>, ShapeKeyHash> m_uniqueCollisionShapes;
+		std::vector<std::shared_ptr<btCollisionShape>> m_entityShapes; //indexed by entity ID
+		//not owned, the entities own the tiles and the tiles their file. Expired entries are pruned once the tile map doubles since the last prune
+		std::unordered_map<std::string, std::weak_ptr<const HeightfieldData>> m_heightfields;
+		std::map<std::tuple<const HeightfieldData*, uint32_t, uint32_t>, std::weak_ptr<HeightfieldTileShape>> m_heightfieldTiles;
+		size_t m_heightfieldPruneSize = 64;
+		size_t m_entityCount = 0;
+		uint64_t m_cacheHits = 0;
+		uint64_t m_cacheMisses = 0;
+		size_t m_peakEntityCount = 0;
 	};
-}
\ No newline at end of file
+}
@@ -1,12 +1,18 @@
 #pragma once
 #include "BulletECS/Entity.h"
+#include "BulletECS/Containers/EntityBitset.h"
+#include "BulletECS/MemoryReport.h"
 #include <vector>
 #include <type_traits>
-#include <bitset>
 #include <cassert>
 #include <iostream>
 namespace BulletECS
 {
+	//Stamp of the world's change clock, see PhysicsWorld::advanceChangeTick
+	using change_tick_t = uint32_t;
+
+	enum class ChangeKind : uint8_t { None, Added, Modified, Removed };
+
 	template <class T>
 	class ComponentPool
 	{
@@ -14,10 +20,12 @@ namespace BulletECS
 
 
 	public:
-		ComponentPool() {}
+		ComponentPool() : ComponentPool(MAX_ENTITIES) {}
+		//pools of small worlds can be sized to their own entity limit instead of MAX_ENTITIES
+		explicit ComponentPool(size_t maxEntities) : m_storage(maxEntities + 1), m_hasComponent(maxEntities + 1) {}
 		~ComponentPool()
 		{
-			for (size_t i = 0; i <= m_highestEntityEver; i++)
+			for (size_t i = 0; i <= m_highestEntity; i++)
 			{
 				if (m_hasComponent[i])
 				{
@@ -31,13 +39,21 @@ namespace BulletECS
 		{
 			size_t idx = entity.ID;
 			static_assert(std::is_constructible_v<T, Args...>, "Component cannot be constructed with the given arguments.");
-			assert(idx <= MAX_ENTITIES && "Entity ID out of bounds.");
+			assert(idx < m_storage.size() && "Entity ID out of bounds.");
 			assert(!m_hasComponent[idx] && "Cannot add same component twice.");
 
 			void* location = &m_storage[idx];
 			T* component = new (location) T(std::forward<Args>(args)...);
-			m_hasComponent[idx] = true;
-			m_highestEntityEver = idx > m_highestEntityEver ? idx : m_highestEntityEver;
+			m_hasComponent.set(idx);
+			m_size++;
+			m_peakSize = m_size > m_peakSize ? m_size : m_peakSize;
+			m_highestEntity = idx > m_highestEntity ? idx : m_highestEntity;
+			if (m_changeTick)
+			{
+				markChange(idx);
+				m_addedTicks[idx] = *m_changeTick;
+				m_added.set(idx);
+			}
 			return component;
 		}
 
@@ -46,21 +62,157 @@ namespace BulletECS
 			size_t idx = entity.ID;
 			assert(m_hasComponent[idx] && "Cannot remove non existent component.");
 			ptr(idx)->~T();
-			m_hasComponent[idx] = false;
+			m_hasComponent.reset(idx);
+			m_size--;
+			if (idx == m_highestEntity)
+			{
+				size_t previous = m_hasComponent.findPrevious(idx);
+				m_highestEntity = previous == EntityBitset::NO_BIT ? NULL_ENTITY : static_cast<entity_id_t>(previous);
+			}
+			if (m_changeTick)
+			{
+				markChange(idx);
+				//added and removed since the last clearChanges() is no change at all, unless it replaced a removed component
+				if (m_added[idx])
+				{
+					m_added.reset(idx);
+				}
+				else
+				{
+					m_removed.set(idx);
+				}
+				m_modified.reset(idx);
+			}
+		}
+
+		//Moves the component to another (free) slot, e.g. when PhysicsWorld::compact changes entity IDs
+		T* relocate(Entity from, Entity to)
+		{
+			assert(m_hasComponent[from.ID] && "Cannot relocate non existent component.");
+			T* component = add(to, std::move(*ptr(from.ID)));
+			remove(from);
+			return component;
+		}
+
+#pragma region Change tracking
+
+		//Stamps every add, remove and mutable get with the tick pointed to (owned by the world), costs a branch per access while disabled
+		void enableChangeTracking(const change_tick_t* changeTick)
+		{
+			assert(changeTick && "Change tracking needs a tick source.");
+			if (m_changeTick)
+			{
+				return;
+			}
+			const size_t size = m_storage.size();
+			m_changeTick = changeTick;
+			m_added = EntityBitset(size);
+			m_removed = EntityBitset(size);
+			m_modified = EntityBitset(size);
+			m_addedTicks.assign(size, 0);
+			m_changeTicks.assign(size, 0);
+			m_wordTicks.assign(m_added.wordCount(), 0);
+			m_dirtyWords.reserve(m_added.wordCount());
+			m_dirtyWordMask = EntityBitset(m_added.wordCount());
+		}
+		inline bool isTrackingChanges() const { return m_changeTick != nullptr; }
+
+		//for writes that do not go through get(), e.g. Bullet moving a motion state
+		inline void markModified(Entity entity)
+		{
+			if (m_changeTick && m_hasComponent[entity.ID])
+			{
+				markChange(entity.ID);
+				if (!m_added[entity.ID])
+				{
+					m_modified.set(entity.ID);
+				}
+			}
+		}
+
+		//Changes since the last clearChanges(), for a single consumer that clears them once it is done, e.g. pool.filter(pool.getModifiedMask()).
+		//An entity replaced (removed and added again) is in both the added and removed masks
+		const EntityBitset& getAddedMask() const { return m_added; }
+		const EntityBitset& getRemovedMask() const { return m_removed; }
+		const EntityBitset& getModifiedMask() const { return m_modified; }
+		//only clears the words that were written since the last call
+		void clearChanges()
+		{
+			for (uint32_t wordIdx : m_dirtyWords)
+			{
+				m_added.clearWord(wordIdx);
+				m_removed.clearWord(wordIdx);
+				m_modified.clearWord(wordIdx);
+				m_dirtyWordMask.reset(wordIdx);
+			}
+			m_dirtyWords.clear();
+		}
+
+		//For consumers that run at their own pace: what happened to the slot after the given tick.
+		//Added wins over Modified, and an entity removed and added again after the tick is reported as Added
+		ChangeKind getChange(Entity entity, change_tick_t since) const
+		{
+			assert(m_changeTick && "Change tracking is not enabled for this pool.");
+			const size_t idx = entity.ID;
+			if (m_changeTicks[idx] <= since)
+			{
+				return ChangeKind::None;
+			}
+			if (!m_hasComponent[idx])
+			{
+				return ChangeKind::Removed;
+			}
+			return m_addedTicks[idx] > since ? ChangeKind::Added : ChangeKind::Modified;
 		}
+		inline change_tick_t getChangeTick(Entity entity) const { return m_changeTick ? m_changeTicks[entity.ID] : 0; }
+
+#pragma endregion
 
 		inline bool has(Entity entity) const { return m_hasComponent[entity.ID]; }
 
+		inline size_t getMaxEntities() const { return m_storage.size() - 1; }
+		inline size_t size() const { return m_size; }
+		inline size_t getPeakSize() const { return m_peakSize; }
+
+		// The storage is allocated up front for every entity ID, so reserved memory does not depend on the components added
+		MemoryUsage getMemoryUsage(std::string name) const
+		{
+			MemoryUsage usage;
+			usage.name = std::move(name);
+			usage.count = m_size;
+			usage.peakCount = m_peakSize;
+			usage.usedBytes = m_size * sizeof(T);
+			usage.peakUsedBytes = m_peakSize * sizeof(T);
+			usage.reservedBytes = m_storage.capacity() * sizeof(typename PoolArray::value_type) + m_hasComponent.getReservedBytes();
+			usage.reservedBytes += m_added.getReservedBytes() + m_removed.getReservedBytes() + m_modified.getReservedBytes() +
+				(m_addedTicks.capacity() + m_changeTicks.capacity() + m_wordTicks.capacity()) * sizeof(change_tick_t) + m_dirtyWords.capacity() * sizeof(uint32_t) + m_dirtyWordMask.getReservedBytes();
+			return usage;
+		}
+		// No entity above this ID has the component, chunked loops over IDs can stop here
+		inline entity_id_t getHighestEntity() const { return m_highestEntity; }
+
+		// Presence bits of the pool, can be used as a mask to filter other pools
+		inline const EntityBitset& getEntitiesMask() const { return m_hasComponent; }
+
+		//marks the component as modified if the pool tracks changes, use the const overload for reads
 		T* get(Entity entity)
 		{
 			size_t idx = entity.ID;
 			if (m_hasComponent[idx])
 			{
+				markModified(entity);
 				return ptr(idx);
 			}
 			return nullptr;
 		}
 
+		//for writes the change tracking should not see, and for loops split between threads (marking is not thread safe)
+		T* getUnmarked(Entity entity)
+		{
+			size_t idx = entity.ID;
+			return m_hasComponent[idx] ? ptr(idx) : nullptr;
+		}
+
 		const T* get(Entity entity) const
 		{
 			size_t idx = entity.ID;
@@ -73,6 +225,21 @@ namespace BulletECS
 
 
 	private:
+		//removed slots can be above the highest entity, so changes are looked for in every slot (skipping untouched words)
+		inline entity_id_t changedEnd() const { return static_cast<entity_id_t>(m_storage.size()); }
+
+		inline void markChange(size_t idx)
+		{
+			const size_t wordIdx = idx / EntityBitset::BITS_PER_WORD;
+			if (!m_dirtyWordMask[wordIdx])
+			{
+				m_dirtyWordMask.set(wordIdx);
+				m_dirtyWords.push_back(static_cast<uint32_t>(wordIdx));
+			}
+			m_changeTicks[idx] = *m_changeTick;
+			m_wordTicks[wordIdx] = *m_changeTick;
+		}
+
 		inline T* ptr(size_t idx)
 		{
 			return reinterpret_cast<T*>(&m_storage[idx]);
@@ -84,9 +251,22 @@ namespace BulletECS
 
 
 	private:
-		PoolArray m_storage = PoolArray(MAX_ENTITIES + 1);
-		std::bitset<MAX_ENTITIES + 1> m_hasComponent;
-		entity_id_t m_highestEntityEver = NULL_ENTITY;
+		PoolArray m_storage;
+		EntityBitset m_hasComponent;
+		entity_id_t m_highestEntity = NULL_ENTITY;
+		size_t m_size = 0;
+		size_t m_peakSize = 0;
+
+		//change tracking, empty until enableChangeTracking()
+		const change_tick_t* m_changeTick = nullptr;
+		EntityBitset m_added = EntityBitset(0);
+		EntityBitset m_removed = EntityBitset(0);
+		EntityBitset m_modified = EntityBitset(0);
+		std::vector<change_tick_t> m_addedTicks;
+		std::vector<change_tick_t> m_changeTicks;
+		std::vector<change_tick_t> m_wordTicks; //latest change of each 64 entity word, lets iterateChangedSince skip untouched words
+		std::vector<uint32_t> m_dirtyWords; //words written since the last clearChanges()
+		EntityBitset m_dirtyWordMask = EntityBitset(0); //one bit per word, so each word is listed once
 
 
 #pragma region Iterators
@@ -95,8 +275,9 @@ namespace BulletECS
 		class EntityIterator
 		{
 		public:
+			//the range is fixed when the iterator is created, so removing components while iterating does not move the end
 			EntityIterator(ComponentPool* pool, entity_id_t index)
-				: m_pool(pool), m_index(index)
+				: m_pool(pool), m_index(index), m_last(pool->m_highestEntity)
 			{
 				skipUninitialized();
 				//std::cout << "iterator created\n";
@@ -117,21 +298,19 @@ namespace BulletECS
 		private:
 			void skipUninitialized()
 			{
-				while (m_index <= m_pool->m_highestEntityEver && !m_pool->m_hasComponent[m_index])
-				{
-					m_index++;
-				}
+				m_index = static_cast<entity_id_t>(m_pool->m_hasComponent.findNext(m_index, m_last));
 			}
 		private:
 			ComponentPool* m_pool;
 			entity_id_t m_index;
+			entity_id_t m_last;
 		};
 
 		/**/class ConstEntityIterator
 		{
 		public:
 			ConstEntityIterator(const ComponentPool* pool, entity_id_t index)
-				: m_pool(pool), m_index(index)
+				: m_pool(pool), m_index(index), m_last(pool->m_highestEntity)
 			{
 				skipUninitialized();
 				//std::cout << "CONST iterator created\n";
@@ -152,23 +331,140 @@ namespace BulletECS
 		private:
 			void skipUninitialized()
 			{
-				while (m_index <= m_pool->m_highestEntityEver && !m_pool->m_hasComponent[m_index])
+				m_index = static_cast<entity_id_t>(m_pool->m_hasComponent.findNext(m_index, m_last));
+			}
+		private:
+			const ComponentPool* m_pool;
+			entity_id_t m_index;
+			entity_id_t m_last;
+		};
+
+		// Iterates only the entities that have the component and whose bit is set in the mask
+		class FilteredEntityIterator
+		{
+		public:
+			FilteredEntityIterator(const ComponentPool* pool, const EntityBitset* mask, entity_id_t index)
+				: m_pool(pool), m_mask(mask), m_index(index), m_last(pool->m_highestEntity)
+			{
+				skipUninitialized();
+			}
+
+			Entity operator *() const { return Entity{ m_index, 0 }; } //uninitialized version because it's unknown
+
+			FilteredEntityIterator& operator++()
+			{
+				m_index++;
+				skipUninitialized();
+				return *this;
+			}
+
+			bool operator==(const FilteredEntityIterator& other) const { return m_index == other.m_index && m_pool == other.m_pool; }
+			bool operator!=(const FilteredEntityIterator& other) const { return !(*this == other); }
+
+		private:
+			void skipUninitialized()
+			{
+				m_index = static_cast<entity_id_t>(m_pool->m_hasComponent.findNext(m_index, m_last, m_mask));
+			}
+		private:
+			const ComponentPool* m_pool;
+			const EntityBitset* m_mask;
+			entity_id_t m_index;
+			entity_id_t m_last;
+		};
+
+		class FilteredView
+		{
+		public:
+			FilteredView(const ComponentPool* pool, const EntityBitset* mask) : m_pool(pool), m_mask(mask) {}
+
+			FilteredEntityIterator begin() const { return FilteredEntityIterator(m_pool, m_mask, 1); }
+			FilteredEntityIterator end() const { return FilteredEntityIterator(m_pool, m_mask, m_pool->m_highestEntity + 1); }
+
+		private:
+			const ComponentPool* m_pool;
+			const EntityBitset* m_mask;
+		};
+
+		// Visits the IDs whose component was added, modified or removed after a tick, so it also yields entities no longer in the pool.
+		// Words without changes after the tick are skipped with a single compare
+		class ChangedEntityIterator
+		{
+		public:
+			ChangedEntityIterator(const ComponentPool* pool, change_tick_t since, entity_id_t index)
+				: m_pool(pool), m_since(since), m_index(index)
+			{
+				skipUnchanged();
+			}
+
+			Entity operator *() const { return Entity{ m_index, 0 }; } //uninitialized version because it's unknown
+
+			ChangedEntityIterator& operator++()
+			{
+				m_index++;
+				skipUnchanged();
+				return *this;
+			}
+
+			bool operator==(const ChangedEntityIterator& other) const { return m_index == other.m_index && m_pool == other.m_pool; }
+			bool operator!=(const ChangedEntityIterator& other) const { return !(*this == other); }
+
+		private:
+			void skipUnchanged()
+			{
+				const entity_id_t end = m_pool->changedEnd();
+				while (m_index < end)
 				{
+					const size_t wordIdx = m_index / EntityBitset::BITS_PER_WORD;
+					if (m_pool->m_wordTicks[wordIdx] <= m_since)
+					{
+						m_index = static_cast<entity_id_t>((wordIdx + 1) * EntityBitset::BITS_PER_WORD);
+						continue;
+					}
+					if (m_pool->m_changeTicks[m_index] > m_since)
+					{
+						return;
+					}
 					m_index++;
 				}
+				m_index = end;
 			}
 		private:
 			const ComponentPool* m_pool;
+			change_tick_t m_since;
 			entity_id_t m_index;
 		};
 
+		class ChangedView
+		{
+		public:
+			ChangedView(const ComponentPool* pool, change_tick_t since) : m_pool(pool), m_since(since) {}
+
+			ChangedEntityIterator begin() const { return ChangedEntityIterator(m_pool, m_since, 1); }
+			ChangedEntityIterator end() const { return ChangedEntityIterator(m_pool, m_since, m_pool->changedEnd()); }
+
+		private:
+			const ComponentPool* m_pool;
+			change_tick_t m_since;
+		};
+
 #pragma endregion
 		
+		// for(Entity e : pool.iterateChangedSince(lastTick)) with pool.getChange(e, lastTick) telling what happened
+		ChangedView iterateChangedSince(change_tick_t since) const
+		{
+			assert(m_changeTick && "Change tracking is not enabled for this pool.");
+			return ChangedView(this, since);
+		}
+
+		// for(Entity e : pool.filter(mask)) only visits entities with the component that are also set in the mask
+		FilteredView filter(const EntityBitset& mask) const { return FilteredView(this, &mask); }
+
 		
 		EntityIterator begin() { return EntityIterator(this, 1); }
-		EntityIterator end() { return EntityIterator(this, m_highestEntityEver + 1); }
+		EntityIterator end() { return EntityIterator(this, m_highestEntity + 1); }
 
 		ConstEntityIterator begin() const { return ConstEntityIterator(this, 1); }
-		ConstEntityIterator end() const { return ConstEntityIterator(this, m_highestEntityEver + 1); }
+		ConstEntityIterator end() const { return ConstEntityIterator(this, m_highestEntity + 1); }
 	};
 }
\ No newline at end of file
@@ -0,0 +1,185 @@
+#pragma once
+#include "BulletECS/Entity.h"
+#include <vector>
+#include <bitset>
+#include <algorithm>
+#include <cstdint>
+#include <cassert>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+namespace BulletECS
+{
+	// Bitset indexed by entity ID, stored as 64 bit words so iteration can skip 64 empty entities at once.
+	// Unlike std::bitset its size is chosen at runtime, so pools can be sized to the world that owns them.
+	class EntityBitset
+	{
+	public:
+		using Word = uint64_t;
+		static constexpr size_t BITS_PER_WORD = 64;
+		static constexpr size_t NO_BIT = ~size_t(0);
+
+		EntityBitset() : EntityBitset(MAX_ENTITIES + 1) {}
+		explicit EntityBitset(size_t size)
+			: m_words((size + BITS_PER_WORD - 1) / BITS_PER_WORD, 0), m_size(size) {}
+
+		inline size_t size() const { return m_size; }
+		inline size_t wordCount() const { return m_words.size(); }
+		inline Word word(size_t wordIdx) const { return m_words[wordIdx]; }
+		inline size_t getReservedBytes() const { return m_words.capacity() * sizeof(Word); }
+
+		inline bool test(size_t idx) const
+		{
+			assert(idx < m_size && "Entity ID out of bounds.");
+			return (m_words[idx / BITS_PER_WORD] >> (idx % BITS_PER_WORD)) & 1;
+		}
+		inline bool operator[](size_t idx) const { return test(idx); }
+
+		inline void set(size_t idx)
+		{
+			assert(idx < m_size && "Entity ID out of bounds.");
+			m_words[idx / BITS_PER_WORD] |= Word(1) << (idx % BITS_PER_WORD);
+		}
+		inline void reset(size_t idx)
+		{
+			assert(idx < m_size && "Entity ID out of bounds.");
+			m_words[idx / BITS_PER_WORD] &= ~(Word(1) << (idx % BITS_PER_WORD));
+		}
+		inline void assign(size_t idx, bool value) { value ? set(idx) : reset(idx); }
+
+		void clear() { std::fill(m_words.begin(), m_words.end(), Word(0)); }
+		inline void clearWord(size_t wordIdx) { m_words[wordIdx] = 0; }
+
+		size_t count() const
+		{
+			size_t total = 0;
+			for (Word w : m_words)
+			{
+				total += std::bitset<BITS_PER_WORD>(w).count();
+			}
+			return total;
+		}
+
+		// Returns the first set bit in [from, last], or last + 1 if there is none.
+		// If a mask is given, only the bits also set in the mask are considered.
+		size_t findNext(size_t from, size_t last, const EntityBitset* mask = nullptr) const
+		{
+			if (from > last)
+			{
+				return last + 1;
+			}
+			size_t wordIdx = from / BITS_PER_WORD;
+			const size_t lastWordIdx = last / BITS_PER_WORD;
+			Word w = maskedWord(wordIdx, mask) & (~Word(0) << (from % BITS_PER_WORD));
+			while (true)
+			{
+				if (w != 0)
+				{
+					size_t idx = wordIdx * BITS_PER_WORD + countTrailingZeros(w);
+					return idx <= last ? idx : last + 1;
+				}
+				if (++wordIdx > lastWordIdx)
+				{
+					return last + 1;
+				}
+				w = maskedWord(wordIdx, mask);
+			}
+		}
+
+		// Returns the first clear bit in [from, last], or last + 1 if every bit is set
+		size_t findNextClear(size_t from, size_t last) const
+		{
+			if (from > last)
+			{
+				return last + 1;
+			}
+			size_t wordIdx = from / BITS_PER_WORD;
+			const size_t lastWordIdx = last / BITS_PER_WORD;
+			Word w = ~wordOrFull(wordIdx) & (~Word(0) << (from % BITS_PER_WORD));
+			while (true)
+			{
+				if (w != 0)
+				{
+					size_t idx = wordIdx * BITS_PER_WORD + countTrailingZeros(w);
+					return idx <= last ? idx : last + 1;
+				}
+				if (++wordIdx > lastWordIdx)
+				{
+					return last + 1;
+				}
+				w = ~wordOrFull(wordIdx);
+			}
+		}
+
+		// Returns the last set bit in [0, from], or NO_BIT if there is none
+		size_t findPrevious(size_t from) const
+		{
+			if (m_words.empty())
+			{
+				return NO_BIT;
+			}
+			size_t wordIdx = std::min(from / BITS_PER_WORD, m_words.size() - 1);
+			const unsigned shift = from / BITS_PER_WORD > wordIdx ? 0 : static_cast<unsigned>(BITS_PER_WORD - 1 - from % BITS_PER_WORD);
+			Word w = m_words[wordIdx] & (~Word(0) >> shift);
+			while (true)
+			{
+				if (w != 0)
+				{
+					return wordIdx * BITS_PER_WORD + (BITS_PER_WORD - 1 - countLeadingZeros(w));
+				}
+				if (wordIdx-- == 0)
+				{
+					return NO_BIT;
+				}
+				w = m_words[wordIdx];
+			}
+		}
+
+		static inline unsigned countLeadingZeros(Word w)
+		{
+#ifdef _MSC_VER
+			unsigned long idx;
+			_BitScanReverse64(&idx, w);
+			return static_cast<unsigned>(BITS_PER_WORD - 1 - idx);
+#else
+			return static_cast<unsigned>(__builtin_clzll(w));
+#endif
+		}
+
+		static inline unsigned countTrailingZeros(Word w)
+		{
+#ifdef _MSC_VER
+			unsigned long idx;
+			_BitScanForward64(&idx, w);
+			return static_cast<unsigned>(idx);
+#else
+			return static_cast<unsigned>(__builtin_ctzll(w));
+#endif
+		}
+
+	private:
+		//words past the end read as full, so findNextClear never returns a bit outside the set
+		inline Word wordOrFull(size_t wordIdx) const
+		{
+			return wordIdx < m_words.size() ? m_words[wordIdx] : ~Word(0);
+		}
+
+		inline Word maskedWord(size_t wordIdx, const EntityBitset* mask) const
+		{
+			if (wordIdx >= m_words.size())
+			{
+				return 0;
+			}
+			Word w = m_words[wordIdx];
+			if (mask)
+			{
+				w &= wordIdx < mask->m_words.size() ? mask->m_words[wordIdx] : 0;
+			}
+			return w;
+		}
+
+	private:
+		std::vector<Word> m_words;
+		size_t m_size;
+	};
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include "BulletECS/Entity.h"
+#include "BulletECS/JointComponents.h"
+#include "BulletECS/MemoryReport.h"
+#include <vector>
+#include <cassert>
+namespace BulletECS
+{
+	// Intrusive linked lists of the joints where an entity is the "other" body, so removing a rigidBody can find
+	// every joint attached to it without scanning the joint pools. Uses flat arrays, linking never allocates.
+	class JointLinks
+	{
+	public:
+		struct JointKey
+		{
+			entity_id_t owner = NULL_ENTITY;
+			JointType type = JointType::Count;
+		};
+
+		JointLinks() : JointLinks(MAX_ENTITIES + 1) {}
+		explicit JointLinks(size_t capacity)
+			: m_capacity(capacity),
+			  m_firstOnOther(capacity),
+			  m_next(capacity * static_cast<size_t>(JointType::Count)),
+			  m_other(capacity * static_cast<size_t>(JointType::Count), NULL_ENTITY) {}
+
+		void link(entity_id_t owner, JointType type, entity_id_t other)
+		{
+			size_t s = slot(owner, type);
+			m_other[s] = other;
+			if (other == NULL_ENTITY)
+			{
+				return;
+			}
+			m_next[s] = m_firstOnOther[other];
+			m_firstOnOther[other] = JointKey{ owner, type };
+		}
+
+		void unlink(entity_id_t owner, JointType type)
+		{
+			size_t s = slot(owner, type);
+			entity_id_t other = m_other[s];
+			m_other[s] = NULL_ENTITY;
+			if (other == NULL_ENTITY)
+			{
+				return;
+			}
+
+			//the lists are as long as the joints attached to one body, so a linear walk is fine
+			JointKey* link = &m_firstOnOther[other];
+			while (link->owner != NULL_ENTITY)
+			{
+				if (link->owner == owner && link->type == type)
+				{
+					*link = m_next[s];
+					m_next[s] = JointKey{};
+					return;
+				}
+				link = &m_next[slot(link->owner, link->type)];
+			}
+			assert(false && "Joint was not linked to its other entity.");
+		}
+
+		// owner == NULL_ENTITY if no joint is attached to the entity as its other body
+		inline JointKey firstJointOn(entity_id_t other) const { return m_firstOnOther[other]; }
+
+		inline entity_id_t getOther(entity_id_t owner, JointType type) const { return m_other[slot(owner, type)]; }
+
+		MemoryUsage getMemoryUsage() const
+		{
+			MemoryUsage usage;
+			usage.name = "JointLinks";
+			usage.reservedBytes = (m_firstOnOther.capacity() + m_next.capacity()) * sizeof(JointKey) + m_other.capacity() * sizeof(entity_id_t);
+			usage.usedBytes = usage.peakUsedBytes = usage.reservedBytes;
+			return usage;
+		}
+
+	private:
+		inline size_t slot(entity_id_t owner, JointType type) const { return static_cast<size_t>(type) * m_capacity + owner; }
+
+	private:
+		size_t m_capacity;
+		std::vector<JointKey> m_firstOnOther;
+		std::vector<JointKey> m_next;
+		std::vector<entity_id_t> m_other;
+	};
+}
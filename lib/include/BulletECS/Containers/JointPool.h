@@ -0,0 +1,165 @@
+#pragma once
+#include "BulletECS/Entity.h"
+#include "BulletECS/MemoryReport.h"
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <type_traits>
+#include <cassert>
+namespace BulletECS
+{
+	// Joints are rare next to bodies and a constraint weighs up to a few KB, so unlike ComponentPool nothing is reserved per entity ID.
+	// Slots are allocated in chunks as joints are added and never move (Bullet keeps pointers to the constraints),
+	// freed slots are reused and an entity -> slot map finds them. At most maxJoints joints can exist at the same time
+	template <class T>
+	class JointPool
+	{
+		static constexpr uint32_t CHUNK_SLOTS = 64;
+		using Slot = std::aligned_storage_t<sizeof(T), alignof(T)>;
+
+	public:
+		JointPool() : JointPool(MAX_ENTITIES) {}
+		explicit JointPool(size_t maxJoints) : m_maxJoints(maxJoints) {}
+		~JointPool()
+		{
+			for (uint32_t slot = 0; slot < m_slotEntities.size(); slot++)
+			{
+				if (m_slotEntities[slot] != NULL_ENTITY)
+				{
+					ptr(slot)->~T();
+				}
+			}
+		}
+		JointPool(const JointPool&) = delete;
+		JointPool& operator=(const JointPool&) = delete;
+
+		template <typename ...Args>
+		T* add(Entity entity, Args&&... args)
+		{
+			static_assert(std::is_constructible_v<T, Args...>, "Component cannot be constructed with the given arguments.");
+			assert(!has(entity) && "Cannot add same component twice.");
+			assert(m_size < m_maxJoints && "Joint limit reached, raise PhysicsWorldConfig::maxJoints.");
+			if (m_freeSlots.empty())
+			{
+				const uint32_t first = static_cast<uint32_t>(m_slotEntities.size());
+				m_chunks.push_back(std::make_unique<Slot[]>(CHUNK_SLOTS));
+				m_slotEntities.resize(first + CHUNK_SLOTS, NULL_ENTITY);
+				//pushed backwards so the lowest slot is used first
+				for (uint32_t slot = first + CHUNK_SLOTS; slot-- > first;)
+				{
+					m_freeSlots.push_back(slot);
+				}
+			}
+			const uint32_t slot = m_freeSlots.back();
+			m_freeSlots.pop_back();
+			T* joint = new (ptr(slot)) T(std::forward<Args>(args)...);
+			m_slotEntities[slot] = entity.ID;
+			m_slots.emplace(entity.ID, slot);
+			m_size++;
+			m_peakSize = m_size > m_peakSize ? m_size : m_peakSize;
+			return joint;
+		}
+
+		void remove(Entity entity)
+		{
+			auto it = m_slots.find(entity.ID);
+			assert(it != m_slots.end() && "Cannot remove non existent component.");
+			const uint32_t slot = it->second;
+			ptr(slot)->~T();
+			m_slotEntities[slot] = NULL_ENTITY;
+			m_freeSlots.push_back(slot);
+			m_slots.erase(it);
+			m_size--;
+		}
+
+		inline bool has(Entity entity) const { return m_size != 0 && m_slots.find(entity.ID) != m_slots.end(); }
+
+		T* get(Entity entity)
+		{
+			if (m_size == 0)
+			{
+				return nullptr;
+			}
+			auto it = m_slots.find(entity.ID);
+			return it != m_slots.end() ? ptr(it->second) : nullptr;
+		}
+
+		const T* get(Entity entity) const
+		{
+			return const_cast<JointPool*>(this)->get(entity);
+		}
+
+		inline size_t size() const { return m_size; }
+		inline size_t getPeakSize() const { return m_peakSize; }
+		inline size_t getMaxJoints() const { return m_maxJoints; }
+
+		// Reserved memory grows with the peak number of joints, not with the world's entity limit
+		MemoryUsage getMemoryUsage(std::string name) const
+		{
+			MemoryUsage usage;
+			usage.name = std::move(name);
+			usage.count = m_size;
+			usage.peakCount = m_peakSize;
+			usage.usedBytes = m_size * sizeof(T);
+			usage.peakUsedBytes = m_peakSize * sizeof(T);
+			usage.reservedBytes = m_chunks.size() * CHUNK_SLOTS * sizeof(Slot) + m_chunks.capacity() * sizeof(std::unique_ptr<Slot[]>) +
+				(m_slotEntities.capacity() + m_freeSlots.capacity()) * sizeof(uint32_t) + MemoryReport::estimateHashTableBytes(m_slots);
+			return usage;
+		}
+
+		class ConstEntityIterator
+		{
+		public:
+			//removing the joint being visited is allowed, its slot is just left behind
+			ConstEntityIterator(const JointPool* pool, uint32_t slot)
+				: m_pool(pool), m_slot(slot)
+			{
+				skipFree();
+			}
+
+			Entity operator *() const { return Entity{ m_pool->m_slotEntities[m_slot], 0 }; } //uninitialized version because it's unknown
+
+			ConstEntityIterator& operator++()
+			{
+				m_slot++;
+				skipFree();
+				return *this;
+			}
+
+			bool operator==(const ConstEntityIterator& other) const { return m_slot == other.m_slot && m_pool == other.m_pool; }
+			bool operator!=(const ConstEntityIterator& other) const { return !(*this == other); }
+
+		private:
+			void skipFree()
+			{
+				const uint32_t end = static_cast<uint32_t>(m_pool->m_slotEntities.size());
+				while (m_slot < end && m_pool->m_slotEntities[m_slot] == NULL_ENTITY)
+				{
+					m_slot++;
+				}
+			}
+		private:
+			const JointPool* m_pool;
+			uint32_t m_slot;
+		};
+
+		//visits the joints in slot order, not in entity order
+		ConstEntityIterator begin() const { return ConstEntityIterator(this, 0); }
+		ConstEntityIterator end() const { return ConstEntityIterator(this, static_cast<uint32_t>(m_slotEntities.size())); }
+
+	private:
+		inline T* ptr(uint32_t slot)
+		{
+			return reinterpret_cast<T*>(&m_chunks[slot / CHUNK_SLOTS][slot % CHUNK_SLOTS]);
+		}
+
+	private:
+		std::vector<std::unique_ptr<Slot[]>> m_chunks;
+		std::vector<entity_id_t> m_slotEntities; //NULL_ENTITY for free slots
+		std::vector<uint32_t> m_freeSlots;
+		std::unordered_map<entity_id_t, uint32_t> m_slots;
+		size_t m_maxJoints;
+		size_t m_size = 0;
+		size_t m_peakSize = 0;
+	};
+}
@@ -0,0 +1,128 @@
+#pragma once
+#include "BulletECS/Entity.h"
+#include "BulletECS/TagComponent.h"
+#include "BulletECS/Span.h"
+#include "BulletECS/MemoryReport.h"
+#include <string>
+#include <string_view>
+#include <deque>
+#include <vector>
+#include <unordered_map>
+#include <cassert>
+namespace BulletECS
+{
+	// Interned tag names plus, for each tag, the list of entities that have it.
+	// Names are hashed only when interned or looked up by name, the per tag lists are contiguous and
+	// removal is a swap with the last element. Names are never released, so their IDs stay valid for the world's lifetime.
+	class TagTable
+	{
+	public:
+		TagTable() : TagTable(MAX_ENTITIES) {}
+		explicit TagTable(size_t maxEntities) : m_slotOfEntity(maxEntities + 1, 0) {}
+
+		//returns the ID of the name, creating it the first time
+		tag_id_t intern(std::string_view name)
+		{
+			auto it = m_ids.find(name);
+			if (it != m_ids.end())
+			{
+				return it->second;
+			}
+			m_names.emplace_back(name);
+			m_entities.emplace_back();
+			tag_id_t id = static_cast<tag_id_t>(m_names.size());
+			m_ids.emplace(m_names.back(), id); //the deque never moves its strings, so the view stays valid
+			return id;
+		}
+
+		//NO_TAG_ID if the name was never interned
+		tag_id_t find(std::string_view name) const
+		{
+			auto it = m_ids.find(name);
+			return it != m_ids.end() ? it->second : NO_TAG_ID;
+		}
+
+		const std::string& getName(tag_id_t id) const
+		{
+			if (id == NO_TAG_ID)
+			{
+				return NO_TAG;
+			}
+			assert(id <= m_names.size() && "Unknown tag ID.");
+			return m_names[id - 1];
+		}
+
+		size_t getTagCount() const { return m_names.size(); }
+
+		void add(Entity entity, tag_id_t id)
+		{
+			assert(id != NO_TAG_ID && id <= m_entities.size() && "Unknown tag ID.");
+			std::vector<Entity>& entities = m_entities[id - 1];
+			m_slotOfEntity[entity.ID] = static_cast<uint32_t>(entities.size());
+			entities.push_back(entity);
+		}
+
+		void remove(Entity entity, tag_id_t id)
+		{
+			assert(id != NO_TAG_ID && id <= m_entities.size() && "Unknown tag ID.");
+			std::vector<Entity>& entities = m_entities[id - 1];
+			uint32_t slot = m_slotOfEntity[entity.ID];
+			assert(slot < entities.size() && entities[slot].ID == entity.ID && "Entity does not have this tag.");
+			entities[slot] = entities.back();
+			m_slotOfEntity[entities[slot].ID] = slot;
+			entities.pop_back();
+		}
+
+		//keeps the entity's place in the list when its ID changes
+		void relocate(Entity from, Entity to, tag_id_t id)
+		{
+			assert(id != NO_TAG_ID && id <= m_entities.size() && "Unknown tag ID.");
+			std::vector<Entity>& entities = m_entities[id - 1];
+			uint32_t slot = m_slotOfEntity[from.ID];
+			assert(slot < entities.size() && entities[slot].ID == from.ID && "Entity does not have this tag.");
+			entities[slot] = to;
+			m_slotOfEntity[to.ID] = slot;
+		}
+
+		//the entities with the tag, in no particular order
+		Span<const Entity> getEntities(tag_id_t id) const
+		{
+			if (id == NO_TAG_ID)
+			{
+				return {};
+			}
+			assert(id <= m_entities.size() && "Unknown tag ID.");
+			const std::vector<Entity>& entities = m_entities[id - 1];
+			return Span<const Entity>(entities.data(), entities.size());
+		}
+
+		MemoryUsage getMemoryUsage() const
+		{
+			MemoryUsage usage;
+			usage.name = "TagTable";
+			usage.count = usage.peakCount = m_names.size(); //names are never released
+			size_t listBytes = 0;
+			for (const std::vector<Entity>& entities : m_entities)
+			{
+				usage.usedBytes += entities.size() * sizeof(Entity);
+				listBytes += entities.capacity() * sizeof(Entity);
+			}
+			size_t nameBytes = m_names.size() * sizeof(std::string);
+			for (const std::string& name : m_names)
+			{
+				nameBytes += MemoryReport::estimateStringBytes(name);
+			}
+			const size_t fixedBytes = nameBytes + MemoryReport::estimateHashTableBytes(m_ids) + m_entities.capacity() * sizeof(std::vector<Entity>);
+			usage.usedBytes += fixedBytes;
+			usage.peakUsedBytes = fixedBytes + listBytes; //the per tag lists never shrink, so their capacity is their peak
+			usage.reservedBytes = fixedBytes + listBytes + m_slotOfEntity.capacity() * sizeof(uint32_t);
+			return usage;
+		}
+
+	private:
+		std::deque<std::string> m_names; //name of tag ID i is m_names[i - 1]
+		std::unordered_map<std::string_view, tag_id_t> m_ids;
+		std::vector<std::vector<Entity>> m_entities;
+		std::vector<uint32_t> m_slotOfEntity; //position of each tagged entity in its tag's list
+	};
+}
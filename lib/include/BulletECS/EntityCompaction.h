@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "BulletECS/Entity.h"
+namespace BulletECS
+{
+	enum class CompactionOrder : uint8_t
+	{
+		ById, //the entities keep their relative order
+		Morton //sorted along a Z-order curve of their motion state position, so entities close in space are close in the pools and in Bullet's arrays
+	};
+
+	struct EntityMove
+	{
+		Entity from;
+		Entity to;
+	};
+
+	struct CompactionResult
+	{
+		//Every relocation in the order it was made, a cycle of entities goes through a free ID. Replaying them with ComponentPool::relocate(from, to)
+		//moves the components of another pool along (BasicPhysicsWorld does it for its user pools as they happen)
+		std::vector<EntityMove> moves;
+		//old handle -> final handle of each entity that changed ID, to fix the handles kept outside the world
+		std::vector<EntityMove> remap;
+	};
+}
@@ -1,18 +1,43 @@
 #pragma once
 #include "BulletECS/Entity.h"
-#include <queue>
+#include "BulletECS/MemoryReport.h"
+#include "BulletECS/Containers/EntityBitset.h"
+#include <vector>
 namespace BulletECS
 {
 	class EntityManager
 	{
 	public:
-		EntityManager() = default;
+		EntityManager() : EntityManager(MAX_ENTITIES) {}
+		//the version table and alive bits are allocated up front, so creating and destroying entities never allocates
+		explicit EntityManager(entity_id_t maxEntities)
+			: m_maxEntities(maxEntities), m_versions(static_cast<size_t>(maxEntities) + 1, 1), m_alive(static_cast<size_t>(maxEntities) + 1) {}
 
+		//Reuses the lowest free ID, so live entities stay packed at the start of the pools
 		Entity createEntity();
 		void destroyEntity(Entity entity);
+		//false for destroyed entities and stale handles
+		inline bool isAlive(Entity entity) const { return entity.ID != NULL_ENTITY && entity.ID <= m_maxEntities && m_alive[entity.ID] && m_versions[entity.ID] == entity.version; }
+		//the handle of the live entity with this ID
+		inline Entity getEntity(entity_id_t id) const { return Entity{ id, m_versions[id] }; }
+		//Moves a live entity to a free ID and returns its new handle, the old one becomes stale
+		Entity relocate(Entity entity, entity_id_t newID);
+
+		inline entity_id_t getMaxEntities() const { return m_maxEntities; }
+		inline size_t getLiveEntityCount() const { return m_liveCount; }
+		//No live entity above this ID, it goes down again when the highest entities are destroyed
+		inline entity_id_t getHighestEntity() const { return m_highestEntity; }
+		inline const EntityBitset& getAliveMask() const { return m_alive; }
+		//the version table and alive bits
+		MemoryUsage getMemoryUsage() const;
 		
 	private:
-		entity_id_t m_nextEntityID = 1;
-		std::queue<Entity> m_destroyedAvailableEntities = {};
+		entity_id_t m_maxEntities = MAX_ENTITIES;
+		//Version of the live entity, or the next one of a free ID. Versions are 16 bits, so an ID reused 65535 times can match a very old stale handle
+		std::vector<entity_version_t> m_versions;
+		EntityBitset m_alive;
+		entity_id_t m_highestEntity = NULL_ENTITY;
+		size_t m_liveCount = 0;
+		size_t m_peakLiveCount = 0;
 	};
-}
\ No newline at end of file
+}
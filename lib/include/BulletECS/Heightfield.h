@@ -0,0 +1,84 @@
+#pragma once
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <btBulletDynamicsCommon.h>
+#include <BulletCollision/CollisionShapes/btHeightfieldTerrainShape.h>
+#include "BulletECS/MappedFile.h"
+
+namespace BulletECS
+{
+	// Binary heightfield files, tiled so every tile can be given to Bullet straight from the mapped file:
+	//	Header | TileBounds[tilesX * tilesZ] | float heights[tilesX * tilesZ][(tileQuads + 1)^2]
+	// Tiles are stored row after row (tile index = tileZ * tilesX + tileX), each one a row major grid of (tileQuads + 1) samples per side,
+	// so the samples on a tile border are stored in both tiles. Every section starts at a 16 byte aligned offset, numbers are in the machine's byte order
+	namespace Heightfield
+	{
+		constexpr char MAGIC[4] = { 'B', 'E', 'H', 'F' };
+		constexpr uint32_t VERSION = 1;
+		constexpr size_t SECTION_ALIGNMENT = 16;
+
+		struct Header
+		{
+			char magic[4];
+			uint32_t version;
+			uint32_t tilesX;
+			uint32_t tilesZ;
+			uint32_t tileQuads; //quads per tile side
+			float spacing; //meters between two samples, on X and Z
+			uint64_t boundsOffset;
+			uint64_t heightsOffset;
+			uint64_t padding;
+		};
+
+		struct TileBounds
+		{
+			float minHeight;
+			float maxHeight;
+		};
+
+		static_assert(sizeof(Header) == 48 && sizeof(TileBounds) == 8, "Heightfield records are mapped as raw bytes, they must not have hidden padding.");
+
+		//Splits a row major grid of width * length samples (X then Z) into tiles. width - 1 and length - 1 must be multiples of tileQuads
+		bool write(const std::string& path, const float* heights, uint32_t width, uint32_t length, uint32_t tileQuads, float spacing);
+	}
+
+	// A heightfield file mapped in memory. Tiles are read in place, the pages of the tiles no body touches are never loaded
+	class HeightfieldData
+	{
+	public:
+		//false if the file is missing or is not a valid heightfield
+		bool open(const std::string& path);
+
+		inline uint32_t getTilesX() const { return m_header.tilesX; }
+		inline uint32_t getTilesZ() const { return m_header.tilesZ; }
+		inline uint32_t getTileQuads() const { return m_header.tileQuads; }
+		inline float getSpacing() const { return m_header.spacing; }
+
+		const float* getTileHeights(uint32_t tileX, uint32_t tileZ) const;
+		const Heightfield::TileBounds& getTileBounds(uint32_t tileX, uint32_t tileZ) const;
+		//Bullet centers a heightfield on its bounds, this is where the tile's body goes relative to the terrain's first sample
+		btVector3 getTileCenter(uint32_t tileX, uint32_t tileZ) const;
+
+	private:
+		MappedFile m_file;
+		Heightfield::Header m_header{};
+	};
+
+	// One tile of a HeightfieldData, keeps the mapping alive while Bullet reads the heights from it
+	class HeightfieldTileShape : public btHeightfieldTerrainShape
+	{
+	public:
+		HeightfieldTileShape(std::shared_ptr<const HeightfieldData> data, uint32_t tileX, uint32_t tileZ);
+
+		inline const HeightfieldData& getData() const { return *m_data; }
+		inline uint32_t getTileX() const { return m_tileX; }
+		inline uint32_t getTileZ() const { return m_tileZ; }
+		inline btVector3 getTileCenter() const { return m_data->getTileCenter(m_tileX, m_tileZ); }
+
+	private:
+		std::shared_ptr<const HeightfieldData> m_data;
+		uint32_t m_tileX;
+		uint32_t m_tileZ;
+	};
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include "BulletECS/Entity.h"
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <btBulletDynamicsCommon.h>
+namespace BulletECS
+{
+	// Joints are stored as Bullet constraints in a ComponentPool per type, owned by the first entity of the pair.
+	// An entity can own one joint of each type and be the "other" body of any number of joints.
+	enum class JointType : uint8_t
+	{
+		PointToPoint,
+		Hinge,
+		Slider,
+		Generic6Dof,
+		Count
+	};
+
+	// Only applied if JointDesc::hasLimits is true, otherwise Bullet's defaults for each joint type are kept.
+	// Hinge uses the angular Z limits (its axis is the frame's Z), Slider the X limits (its axis is the frame's X).
+	struct JointLimits
+	{
+		btVector3 linearLower = { 0, 0, 0 };
+		btVector3 linearUpper = { 0, 0, 0 };
+		btVector3 angularLower = { 0, 0, 0 };
+		btVector3 angularUpper = { 0, 0, 0 };
+	};
+
+	struct JointDesc
+	{
+		JointType type = JointType::PointToPoint;
+		Entity entity; //owner of the joint component
+		Entity other; //NULL_ENTITY means the joint is attached to a fixed point in the world
+		btTransform frameInEntity = btTransform::getIdentity(); //for PointToPoint only the origins (pivots) are used
+		btTransform frameInOther = btTransform::getIdentity();
+		bool disableCollisionsBetweenBodies = true;
+		bool hasLimits = false;
+		JointLimits limits;
+	};
+
+	// A reusable set of joints between bones referenced by index, e.g. a ragdoll skeleton or a vehicle's suspension.
+	// Instantiated with PhysicsWorld::instantiateJointPrefab and an array with one entity per bone.
+	struct JointPrefab
+	{
+		struct Joint
+		{
+			uint32_t bone; //owner of the joint
+			uint32_t parentBone;
+			JointDesc desc; //entity and other are ignored, they come from the bones
+		};
+
+		std::vector<Joint> joints;
+		uint32_t boneCount = 0;
+
+		void addJoint(uint32_t bone, uint32_t parentBone, const JointDesc& desc)
+		{
+			joints.push_back({ bone, parentBone, desc });
+			boneCount = std::max(boneCount, std::max(bone, parentBone) + 1);
+		}
+	};
+}
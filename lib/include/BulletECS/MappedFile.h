@@ -0,0 +1,36 @@
+#pragma once
+#include <string>
+#include <cstddef>
+#include <cstdint>
+namespace BulletECS
+{
+	// Read only view of a whole file mapped in memory. Pages are read by the OS when first touched and shared by every process mapping the same file,
+	// so data used in place (scene arrays, height tables) costs no copy and no allocation
+	class MappedFile
+	{
+	public:
+		MappedFile() = default;
+		explicit MappedFile(const std::string& path) { open(path); }
+		~MappedFile() { close(); }
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		MappedFile(MappedFile&& other) noexcept { *this = static_cast<MappedFile&&>(other); }
+		MappedFile& operator=(MappedFile&& other) noexcept;
+
+		//false if the file cannot be opened or is empty, a file already open is closed first
+		bool open(const std::string& path);
+		void close();
+
+		inline bool isOpen() const { return m_data != nullptr; }
+		inline const uint8_t* data() const { return m_data; }
+		inline size_t size() const { return m_size; }
+
+	private:
+		const uint8_t* m_data = nullptr;
+		size_t m_size = 0;
+#ifdef _WIN32
+		void* m_file = nullptr;
+		void* m_mapping = nullptr;
+#endif
+	};
+}
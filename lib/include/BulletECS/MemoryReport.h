@@ -0,0 +1,47 @@
+#pragma once
+#include "BulletECS/BulletAllocator.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <ostream>
+namespace BulletECS
+{
+	// Memory of one part of a world. Sizes of node based containers (hash maps, queues) are estimates,
+	// everything else is exact. Reserved memory of the library never shrinks, so it is also its high-water mark
+	struct MemoryUsage
+	{
+		std::string name;
+		size_t count = 0; //live elements (components, shapes, free IDs...)
+		size_t peakCount = 0;
+		size_t usedBytes = 0;
+		size_t peakUsedBytes = 0;
+		size_t reservedBytes = 0; //used plus capacity kept for later
+	};
+
+	struct MemoryReport
+	{
+		std::vector<MemoryUsage> sections;
+
+		//Bullet's internal allocations seen by the allocator hooks, see BulletAllocationStats
+		BulletAllocationStats bullet;
+		bool bulletStatsArePerWorld = false; //false if the world has no arena, then they count every world without one
+
+		size_t getTotalUsedBytes() const;
+		size_t getTotalReservedBytes() const; //includes Bullet's bytesReserved
+		const MemoryUsage* find(const std::string& name) const;
+		void print(std::ostream& out) const;
+
+		// Estimate for std::unordered_map/set: the bucket array plus one node (value, next pointer and cached hash) per element
+		template <class HashTable>
+		static size_t estimateHashTableBytes(const HashTable& table)
+		{
+			return table.bucket_count() * sizeof(void*) + table.size() * (sizeof(typename HashTable::value_type) + 2 * sizeof(void*));
+		}
+
+		// Heap memory of a string, 0 while it fits in the small string buffer
+		static size_t estimateStringBytes(const std::string& text)
+		{
+			return text.capacity() > std::string().capacity() ? text.capacity() + 1 : 0;
+		}
+	};
+}
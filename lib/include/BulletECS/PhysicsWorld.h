@@ -1,38 +1,106 @@
 #pragma once
 #include <LinearMath/btVector3.h>
 #include <memory>
+#include <functional>
+#include <vector>
+#include <utility>
 #include <btBulletDynamicsCommon.h>
 #include "BulletECS/EntityManager.h"
+#include "BulletECS/PhysicsWorldConfig.h"
+#include "BulletECS/BulletAllocator.h"
+#include "BulletECS/StepStats.h"
+#include "BulletECS/MemoryReport.h"
+#include "BulletECS/AllocationTracker.h"
+#include "BulletECS/Span.h"
 #include "BulletECS/Containers/ComponentPool.h"
 #include "BulletECS/Containers/CollisionShapeContainer.h"
 #include "BulletECS/TagComponent.h"
+#include "BulletECS/Containers/TagTable.h"
+#include "BulletECS/CollisionLayerComponent.h"
+#include "BulletECS/JointComponents.h"
+#include "BulletECS/Containers/JointLinks.h"
+#include "BulletECS/Containers/JointPool.h"
+#include "BulletECS/TriggerComponent.h"
+#include "BulletECS/SimulationLod.h"
+#include "BulletECS/EntityCompaction.h"
+#include "BulletECS/BodyDesc.h"
 
 namespace BulletECS
 {
+	class ThreadPool;
+
 	class PhysicsWorld
 	{
 	public:
 		PhysicsWorld(btVector3 gravity);
+		PhysicsWorld(const PhysicsWorldConfig& config);
 		
-		//Allows user to customize the Bullet managers used for the simulation
+		//Allows user to customize the Bullet managers used for the simulation.
+		//With an arena (see PhysicsWorldConfig::useArenaAllocator) BulletAllocator::install() must be called before creating them
 		PhysicsWorld(
 			std::unique_ptr<btCollisionConfiguration> collisionConfiguration, 
 			std::unique_ptr<btDispatcher> dispatcher, 
 			std::unique_ptr<btBroadphaseInterface> broadphase, 
 			std::unique_ptr<btConstraintSolver> solver, 
-			std::unique_ptr<btDynamicsWorld> dynamicsWorld);
+			std::unique_ptr<btDynamicsWorld> dynamicsWorld,
+			bool useArenaAllocator = false);
 		
-		~PhysicsWorld();
+		virtual ~PhysicsWorld();
+
 
+		//Direct access to Bullet for functionality not covered by this library
+		btDynamicsWorld* getDynamicsWorld() { return m_dynamicsWorld.get(); }
+		const btDynamicsWorld* getDynamicsWorld() const { return m_dynamicsWorld.get(); }
 
 		btVector3 getGravity() const;
 		// Sets the dynamics world gravity, that means iterating each non static rigidbody and changing its gravity
 		void setGravity(btVector3 gravity);
 
-		void stepSimulation(float timeStep, int maxSubSteps = 1, float fixedTimeStep = 1.0f / 60.0f);
+		//Returns the timings and counters of this step, which are also kept in the step stats history
+		const StepStats& stepSimulation(float timeStep, int maxSubSteps = 1, float fixedTimeStep = 1.0f / 60.0f);
+		const StepStatsHistory& getStepStatsHistory() const { return m_stepStatsHistory; }
+
+		//Called at the end of every stepSimulation with the stats of the step, in the order they were added (e.g. by a ReplayRecorder).
+		//Their time is not part of the stats. Listeners cannot be added or removed from inside a listener
+		using StepListener = std::function<void(PhysicsWorld& world, const StepStats& stats)>;
+		//returns the ID for removeStepListener
+		size_t addStepListener(StepListener listener);
+		void removeStepListener(size_t id);
+
+		//Optional pool (not owned) used to split the bulk operations in chunks, without one they run on the calling thread
+		void setThreadPool(ThreadPool* threadPool) { m_threadPool = threadPool; }
+		ThreadPool* getThreadPool() const { return m_threadPool; }
+
+		//Counters of the world's BulletArena if PhysicsWorldConfig::useArenaAllocator was set, otherwise of every Bullet allocation not made by an arena.
+		//With the arena, systemAllocations should stop growing once the simulation reaches its steady state
+		BulletAllocationStats getBulletAllocationStats() const;
+		//Memory of every pool and container of the world plus Bullet's allocations, with their high-water marks.
+		//Walks the shape and tag tables, meant for tooling and capacity planning rather than every frame
+		MemoryReport memoryReport() const;
+
+
+		//Change tracking is opt in per pool, e.g. enableChangeTracking(world.iterateMutableMotionStates()). After each step the rigidBodies and motion states of the
+		//active bodies are marked as modified. A consumer calls advanceChangeTick() before reading and passes the returned tick as since the next time:
+		//	change_tick_t now = world.advanceChangeTick(); for (Entity e : pool.iterateChangedSince(m_last)) {...} m_last = now;
+		template <class T>
+		void enableChangeTracking(ComponentPool<T>& pool) { pool.enableChangeTracking(&m_changeTick); }
+		change_tick_t getChangeTick() const { return m_changeTick; }
+		//Returns the current tick and starts a new one, every step also starts a new tick
+		change_tick_t advanceChangeTick() { return m_changeTick++; }
 
 
 		Entity createEntity();
+		entity_id_t getMaxEntities() const { return m_entityManager.getMaxEntities(); }
+		size_t getLiveEntityCount() const { return m_entityManager.getLiveEntityCount(); }
+		//false for destroyed entities and stale handles
+		bool isAlive(Entity entity) const { return m_entityManager.isAlive(entity); }
+
+		//New entities take the lowest free ID, but destroying many entities still leaves holes that the pools and chunked loops walk over.
+		//compact moves the live entities to the lowest IDs, then removes every rigidBody from the dynamics world and re-adds them in the new ID order,
+		//so Bullet's arrays follow the pools. Entities with joints or triggers keep their ID, Bullet objects point at them.
+		//The old handles of moved entities become stale, use the returned remap to fix the ones kept elsewhere. Broadphase pairs are rebuilt,
+		//so triggers report the moved bodies leaving and entering again. Meant for loading screens and level transitions, not every frame
+		CompactionResult compact(CompactionOrder order = CompactionOrder::ById);
 
 		btDefaultMotionState* addMotionState(Entity entity, const btTransform& transformData);
 		btRigidBody* addRigidBody(Entity entity, float mass, float restitution = 0.0f);
@@ -43,19 +111,107 @@ namespace BulletECS
 		btSphereShape* setSphereCollider(Entity entity, float radius);
 		btCapsuleShape* setCapsuleCollider(Entity entity, float radius, float height);
 		btCollisionShape* setColliderFromExistentEntity(Entity entity, Entity existentEntityWithCollider);
+		btCollisionShape* setCollider(Entity entity, const ColliderDesc& desc);
+		//One tile of a heightfield file written by Heightfield::write, read in place from the mapped file. Place the entity's (static) body at
+		//the terrain origin plus getTileCenter(). Null if the file is not a valid heightfield or the tile is out of range
+		HeightfieldTileShape* setHeightfieldCollider(Entity entity, const std::string& path, uint32_t tileX = 0, uint32_t tileZ = 0);
+
+		//The name is interned, entities with the same tag share the string. Returns the tag ID
+		tag_id_t addTag(Entity entity, std::string_view name);
+		//Skips the name lookup, e.g. when tagging many entities with an ID from getTagId(name)
+		void addTag(Entity entity, tag_id_t id);
+
+		//Entities without a layer are in DEFAULT_COLLISION_LAYER. If the entity already has a rigidBody it is re-added to the world with the new filter
+		void setCollisionLayer(Entity entity, collision_layer_t layer);
+		collision_layer_t getCollisionLayer(Entity entity) const;
+		//Changes only affect new broadphase pairs, bodies already overlapping keep colliding until they separate
+		void setLayersCollide(collision_layer_t layerA, collision_layer_t layerB, bool collide);
+		bool doLayersCollide(collision_layer_t layerA, collision_layer_t layerB) const { return m_collisionLayers.collides(layerA, layerB); }
 
-		void addTag(Entity entity, const std::string& name);
+		//Kinematic bodies are moved by the user (e.g. animations) instead of the simulation, and never fall asleep
+		void setKinematic(Entity entity, bool kinematic);
+		//Mass 0 makes the body static. Mass and the static/kinematic flags must be changed through the world (this and setKinematic),
+		//not on the btRigidBody, or the body is not put back in the set updateActiveRigidBodies scans
+		void setMass(Entity entity, float mass);
+		//Writes the motion state and world transform of every kinematic entity in one pass, Bullet derives their velocities in the next step.
+		//The three spans must have the same size
+		void setKinematicTransforms(Span<const Entity> entities, Span<const btVector3> positions, Span<const btQuaternion> rotations);
+
+		//Bulk operations, values[i] is applied to entities[i]. Entities must be unique and should be sorted by ID so the bodies are visited in memory order.
+		//Static and kinematic bodies are skipped, bodies that receive a non zero value are woken up
+		void applyCentralForces(Span<const Entity> entities, Span<const btVector3> forces);
+		void applyCentralImpulses(Span<const Entity> entities, Span<const btVector3> impulses);
+		void applyTorques(Span<const Entity> entities, Span<const btVector3> torques);
+		void setLinearVelocities(Span<const Entity> entities, Span<const btVector3> velocities);
+		void setAngularVelocities(Span<const Entity> entities, Span<const btVector3> velocities);
+		//Calls field(entity, position) for every dynamic body in ID order (from several threads if there is a thread pool) and applies the returned force.
+		//If a mask is given only the entities set in it are visited, e.g. the ones with a buoyancy component
+		void applyForceField(const std::function<btVector3(Entity, const btVector3&)>& field, const EntityBitset* mask = nullptr);
+		//Pushes the dynamic bodies away from center, the impulse decays linearly to zero at radius
+		void applyRadialImpulse(btVector3 center, float radius, float impulse);
+
+		//Joints are owned by the first entity and need the rigidBodies of both entities (other can be NULL_ENTITY to attach to the world)
+		//They are removed automatically when the rigidBody of either entity is removed
+		btPoint2PointConstraint* addPointToPointJoint(Entity entity, Entity other, btVector3 pivotInEntity, btVector3 pivotInOther, bool disableCollisionsBetweenBodies = true);
+		btHingeConstraint* addHingeJoint(Entity entity, Entity other, const btTransform& frameInEntity, const btTransform& frameInOther, bool disableCollisionsBetweenBodies = true);
+		btSliderConstraint* addSliderJoint(Entity entity, Entity other, const btTransform& frameInEntity, const btTransform& frameInOther, bool disableCollisionsBetweenBodies = true);
+		btGeneric6DofConstraint* addGeneric6DofJoint(Entity entity, Entity other, const btTransform& frameInEntity, const btTransform& frameInOther, bool disableCollisionsBetweenBodies = true);
+		btTypedConstraint* addJoint(const JointDesc& desc);
+		
+		//Triggers use the entity's collider and its motion state transform (identity without one) and report the entities whose aabbs enter or leave theirs.
+		//They have no collision response and are static, so static bodies are never reported. A trigger does not follow the entity's rigidBody, move it with setTriggerTransform
+		TriggerGhostObject* addTrigger(Entity entity);
+		void setTriggerTransform(Entity entity, const btTransform& transform);
+		//Events of the last step plus the ones from changes made before it (e.g. a destroyed entity leaving a trigger), valid until the next step
+		Span<const TriggerEvent> getTriggerEnterEvents() const { return m_triggerEvents.enter; }
+		Span<const TriggerEvent> getTriggerExitEvents() const { return m_triggerEvents.exit; }
+
+		//Opts the entity's rigidBody into the simulation LOD: far from every focus point it is stepped at a divided rate (Reduced) or not at all (Frozen),
+		//and promoted back to Full when it gets close to a focus point or an awake body touches it. Sleeping bodies are left alone, they cost nothing already.
+		//Meant for debris and props, entities with joints should stay Full. Without focus points every body is Full
+		void addSimulationLod(Entity entity);
+		void removeSimulationLod(Entity entity);
+		SimulationLod getSimulationLod(Entity entity) const;
+		//Copied, usually the players' positions set once per frame
+		void setSimulationLodFocusPoints(Span<const btVector3> points);
+		void setSimulationLodSettings(const SimulationLodSettings& settings) { m_lodSettings = settings; }
+		const SimulationLodSettings& getSimulationLodSettings() const { return m_lodSettings; }
+
+		//Bulk creation
+		//Creates an entity with motion state, collider, layer and rigidBody for each desc and writes it to entities[i]
+		void addBodies(const BodyDesc* descs, size_t count, Entity* entities);
+		//false if the entity has no rigidBody or its collider is not a ColliderType
+		bool getBodyDesc(Entity entity, BodyDesc& desc) const;
+		//Resolves the shared shape and the inertia once, for addPrefabInstances
+		BodyPrefab makeBodyPrefab(const ColliderDesc& collider, float mass, float restitution = 0.0f, collision_layer_t layer = DEFAULT_COLLISION_LAYER);
+		//Creates count bodies from flat arrays, e.g. the mapped arrays of a scene file: instance i uses prefabs[prefabIndices[i]], the position at positions[3 * i]
+		//and the rotation (xyzw) at rotations[4 * i]. No shape lookup or inertia computation per instance. entities (if not null) receives the new entities
+		void addPrefabInstances(Span<const BodyPrefab> prefabs, const uint32_t* prefabIndices, const float* positions, const float* rotations, size_t count, Entity* entities);
+		void addJoints(const JointDesc* descs, size_t count);
+		//joint i is owned by entities[i + 1] and attached to entities[i], type, frames and limits are taken from linkDesc
+		void addJointChain(const Entity* entities, size_t count, const JointDesc& linkDesc);
+		//boneEntities must have prefab.boneCount entities, all of them with rigidBodies
+		void instantiateJointPrefab(const JointPrefab& prefab, const Entity* boneEntities);
 
 		//only if the entity has neither collider nor rigidBody
 		void removeMotionState(Entity entity);
-		//only if the entity has no rigidBody
+		//only if the entity has neither rigidBody nor trigger
 		void removeCollider(Entity entity);
 
 		void removeRigidBody(Entity entity);
 
+		void removeTrigger(Entity entity);
+
 		void removeTag(Entity entity);
 
-		//removes (if exists) its rigidBody then its collider and then its motionState
+		void removeJoint(Entity entity, JointType type);
+		//removes the joints owned by the entity and the ones where it is the other body
+		void removeAllJoints(Entity entity);
+
+		//moves the entity back to DEFAULT_COLLISION_LAYER
+		void removeCollisionLayer(Entity entity);
+
+		//removes (if exists) its rigidBody and trigger then its collider and then its motionState
 		void destroyEntity(Entity entity);
 
 
@@ -66,8 +222,20 @@ namespace BulletECS
 		const btCollisionShape* getCollisionShape(const Entity entity) const;
 		btRigidBody* getRigidBody(Entity entity);
 		const btRigidBody* getRigidBody(const Entity entity) const;
+		TriggerGhostObject* getTrigger(Entity entity);
+		const TriggerGhostObject* getTrigger(const Entity entity) const;
 
 		const std::string& getTag(Entity entity) const;
+		//NO_TAG_ID if the entity has no tag
+		tag_id_t getTagId(Entity entity) const;
+		//NO_TAG_ID if no entity was ever tagged with the name
+		tag_id_t getTagId(std::string_view name) const { return m_tagTable.find(name); }
+		//The entities with the tag in no particular order, the span is invalidated when the tag is added or removed
+		Span<const Entity> findByTag(std::string_view name) const { return m_tagTable.getEntities(m_tagTable.find(name)); }
+		Span<const Entity> iterateTag(tag_id_t id) const { return m_tagTable.getEntities(id); }
+
+		btTypedConstraint* getJoint(Entity entity, JointType type);
+		const btTypedConstraint* getJoint(Entity entity, JointType type) const;
 
 		const ComponentPool<btRigidBody>& iterateEntitiesWithRigidBodies() const { return m_rigidBodyPool; }
 		ComponentPool<btRigidBody>& iterateMutableEntitiesWithRigidBodies() { return m_rigidBodyPool; }
@@ -75,7 +243,51 @@ namespace BulletECS
 		const ComponentPool<btDefaultMotionState>& iterateMotionStates() const { return m_motionStatePool; }
 		ComponentPool<btDefaultMotionState>& iterateMutableMotionStates() { return m_motionStatePool; }
 
+		//the entities currently overlapping a trigger are in its getOverlappingPairs(), see getCollisionObjectEntity
+		const ComponentPool<TriggerGhostObject>& iterateTriggers() const { return m_triggerPool; }
+
+		const JointPool<btPoint2PointConstraint>& iteratePointToPointJoints() const { return m_pointToPointJointPool; }
+		const JointPool<btHingeConstraint>& iterateHingeJoints() const { return m_hingeJointPool; }
+		const JointPool<btSliderConstraint>& iterateSliderJoints() const { return m_sliderJointPool; }
+		const JointPool<btGeneric6DofConstraint>& iterateGeneric6DofJoints() const { return m_generic6DofJointPool; }
+
+		// Only visits the rigid bodies that were awake after the last step (including the Reduced LOD bodies it extrapolated), sleeping and static bodies are skipped
+		ComponentPool<btRigidBody>::FilteredView iterateActiveRigidBodies() const { return m_rigidBodyPool.filter(m_activeRigidBodies); }
+		// Can be used to filter other pools by activation, e.g. for(Entity e : myPool.filter(world.getActiveRigidBodiesMask()))
+		const EntityBitset& getActiveRigidBodiesMask() const { return m_activeRigidBodies; }
+		bool isRigidBodyActive(Entity entity) const { return m_activeRigidBodies[entity.ID]; }
+
+	protected:
+		//for worlds that extend the component set (see BasicPhysicsWorld), tags and layers stay read only because their tables mirror the pools
+		const ComponentPool<TagComponent>& getTagPool() const { return m_tagPool; }
+		const ComponentPool<CollisionLayerComponent>& getCollisionLayerPool() const { return m_collisionLayerPool; }
+		ComponentPool<TriggerGhostObject>& getMutableTriggerPool() { return m_triggerPool; }
+		//destroyEntity calls this before removing the built-in components and compact calls onEntityRelocated for every entity it moves,
+		//so the pools of a derived world follow the entities even when it is used through a PhysicsWorld&
+		virtual void onEntityDestroyed(Entity entity) {}
+		virtual void onEntityRelocated(Entity from, Entity to) {}
+
+	private:
+		void installCollisionFilter();
+		void installTriggerCallbacks();
+		void addRigidBodyToWorld(btRigidBody* rigidBody, collision_layer_t layer);
+		void addTriggerToWorld(TriggerGhostObject* trigger, collision_layer_t layer);
+		// Refreshes the active bits of the dynamic bodies from their activation states, called after each step
+		void updateActiveRigidBodies();
+		void collectStepCounters(StepStats& stats);
+		//before Bullet's step: recomputes a slice of the tiers and suspends the bodies that skip this step
+		void applySimulationLod(StepStats& stats);
+		//after it: extrapolates the suspended Reduced bodies and promotes the ones touched by awake bodies
+		void finishSimulationLod(btScalar simulatedTime);
+		SimulationLod computeLodTier(SimulationLod current, const btVector3& position) const;
+		bool isPinnedForCompaction(Entity entity) const;
+		//moves every component of a live entity to a free ID, its rigidBody must be out of the dynamics world
+		Entity relocateEntity(Entity from, entity_id_t to);
+		enum class BulkOperation { CentralForce, CentralImpulse, Torque, LinearVelocity, AngularVelocity };
+		void applyBulk(BulkOperation operation, Span<const Entity> entities, Span<const btVector3> values);
+
 	private:
+		std::unique_ptr<BulletArena> m_arena = nullptr; //declared first so it outlives every Bullet object of the world
 		std::unique_ptr<btCollisionConfiguration> m_collisionConfiguration = nullptr;
 		std::unique_ptr<btDispatcher> m_dispatcher = nullptr;
 		std::unique_ptr<btBroadphaseInterface> m_broadphase = nullptr;
@@ -87,6 +299,36 @@ namespace BulletECS
 		ComponentPool<btDefaultMotionState> m_motionStatePool; //TODO: change this to custom simpler motion state that only has 1 transform ?
 		CollisionShapeContainer m_collisionShapeContainer;
 		ComponentPool<TagComponent> m_tagPool;
+		TagTable m_tagTable;
+		EntityBitset m_activeRigidBodies;
+		EntityBitset m_dynamicRigidBodies; //the bodies updateActiveRigidBodies reads, static and kinematic ones keep their active bit
+		ComponentPool<CollisionLayerComponent> m_collisionLayerPool;
+		CollisionLayerMatrix m_collisionLayers;
+		CollisionLayerFilter m_collisionLayerFilter = CollisionLayerFilter(m_collisionLayers);
+		JointPool<btPoint2PointConstraint> m_pointToPointJointPool;
+		JointPool<btHingeConstraint> m_hingeJointPool;
+		JointPool<btSliderConstraint> m_sliderJointPool;
+		JointPool<btGeneric6DofConstraint> m_generic6DofJointPool;
+		JointLinks m_jointLinks;
+		ComponentPool<TriggerGhostObject> m_triggerPool;
+		btGhostPairCallback m_ghostPairCallback;
+		TriggerEventBuffers m_pendingTriggerEvents; //filled by the ghosts, swapped into m_triggerEvents at the end of each step
+		TriggerEventBuffers m_triggerEvents;
+		ThreadPool* m_threadPool = nullptr;
+		ComponentPool<SimulationLodComponent> m_simulationLodPool;
+		SimulationLodSettings m_lodSettings;
+		std::vector<btVector3> m_lodFocusPoints;
+		StepStats m_currentStepStats; //accumulates the ECS counters until the next step
+		StepStatsHistory m_stepStatsHistory;
+		std::vector<std::pair<size_t, StepListener>> m_stepListeners;
+		size_t m_nextStepListenerId = 1;
+		uint64_t m_stepCount = 0;
+		change_tick_t m_changeTick = 1; //0 is older than every change, so since = 0 visits everything
+		uint64_t m_lastShapeCacheHits = 0;
+		uint64_t m_lastShapeCacheMisses = 0;
+		uint64_t m_lastStepEndAllocations = 0;
+		bool m_assertNoSteadyStateAllocations = false;
+		uint64_t m_steadyStateWarmupSteps = 0;
 	};
 }
 
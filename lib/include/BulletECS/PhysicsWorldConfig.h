@@ -0,0 +1,54 @@
+#pragma once
+#include "BulletECS/Entity.h"
+#include "BulletECS/StepStats.h"
+#include "BulletECS/SimulationLod.h"
+#include <LinearMath/btVector3.h>
+namespace BulletECS
+{
+	enum class BroadphaseType
+	{
+		Dbvt, //dynamic AABB trees, good default for scenes with many sleeping or static bodies
+		AxisSweep3, //sweep and prune with 16 bit handles, at most 32766 proxies, needs world bounds
+		AxisSweep3_32Bit, //sweep and prune with 32 bit handles, needs world bounds
+		UniformGrid //hashed grid, for dense scenes of evenly sized objects, needs world bounds and a cell size
+	};
+
+	struct PhysicsWorldConfig
+	{
+		btVector3 gravity = { 0, -10, 0 };
+
+		//Size of the world's component pools, small worlds (e.g. in a WorldBatch) can use much less memory than MAX_ENTITIES
+		entity_id_t maxEntities = MAX_ENTITIES;
+		//Limit of joints of each JointType, their storage grows with the joints actually added
+		size_t maxJoints = MAX_ENTITIES;
+
+		//Used to size Bullet's persistent manifold and collision algorithm pools, so they do not overflow to the heap during the simulation
+		size_t expectedEntities = MAX_ENTITIES; //should not be bigger than maxEntities
+		int manifoldsPerEntity = 2;
+		int collisionAlgorithmsPerEntity = 2;
+
+		BroadphaseType broadphase = BroadphaseType::Dbvt;
+		//Used by the sweep and prune and grid broadphases, objects outside of them still collide but much slower
+		btVector3 worldAabbMin = { -1000, -1000, -1000 };
+		btVector3 worldAabbMax = { 1000, 1000, 1000 };
+		//UniformGrid only, about the size of the biggest moving object
+		float gridCellSize = 2.0f;
+
+		//Routes every Bullet allocation made by this world to a BulletArena owned by the world,
+		//so steady state stepping does not reach the system heap. See getBulletAllocationStats.
+		//Installs the process-wide BulletAllocator hooks, which must happen before any world without an arena is created
+		bool useArenaAllocator = false;
+
+		//Number of steps kept by PhysicsWorld::getStepStatsHistory
+		size_t stepStatsHistorySize = StepStatsHistory::DEFAULT_CAPACITY;
+
+		//Asserts if a step reaches the heap once the world is warmed up (see StepStats::stepAllocations), to keep frame times deterministic.
+		//Bullet's heap allocations are seen once the allocator hooks are installed, C++ ones only with BULLET_ECS_IMPLEMENT_ALLOCATION_TRACKER (AllocationTracker.h).
+		//Best combined with useArenaAllocator, otherwise every Bullet allocation reaches the heap
+		bool assertNoSteadyStateAllocations = false;
+		uint64_t steadyStateWarmupSteps = 120;
+
+		//Distances and rates of the simulation LOD tiers, see PhysicsWorld::addSimulationLod
+		SimulationLodSettings simulationLod;
+	};
+}
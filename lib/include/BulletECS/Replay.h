@@ -0,0 +1,153 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <btBulletDynamicsCommon.h>
+#include "BulletECS/Entity.h"
+#include "BulletECS/MappedFile.h"
+#include "BulletECS/Containers/EntityBitset.h"
+
+namespace BulletECS
+{
+	class PhysicsWorld;
+
+	struct ReplaySettings
+	{
+		float positionPrecision = 0.001f; //meters per quantization step, positions are stored as 32 bit integers
+		uint32_t keyframeInterval = 300; //every Nth recorded step stores every body, the player seeks from the keyframe before the wanted step
+	};
+
+	struct ReplayRecorderStats
+	{
+		uint64_t frames = 0;
+		uint64_t keyframes = 0;
+		uint64_t bodyRecords = 0; //bodies written, sleeping bodies are only written in keyframes
+		uint64_t encodedBytes = 0;
+		uint64_t rawBytes = 0; //what the same records take as float transforms plus an entity, to compare with encodedBytes
+		uint64_t writtenBytes = 0; //by the writer thread so far
+		double lastEncodeTime = 0.0; //milliseconds on the stepping thread
+	};
+
+	// Records the transform of every rigidBody after each step of a world, to replay long sessions (e.g. to find where two machines diverged).
+	// Positions and rotations are quantized and written as variable length deltas against the previous frame, and only the bodies that were awake,
+	// added or removed are visited between keyframes. Frames are encoded on the stepping thread and written to the file by a background thread.
+	// Bodies moved while asleep (e.g. a static body teleported by the user) are only seen at the next keyframe
+	class ReplayRecorder
+	{
+	public:
+		//Creates the file and registers a step listener, recording starts with the next step
+		ReplayRecorder(PhysicsWorld& world, const std::string& path, const ReplaySettings& settings = ReplaySettings());
+		//unregisters the listener and writes the frames left
+		~ReplayRecorder();
+		ReplayRecorder(const ReplayRecorder&) = delete;
+		ReplayRecorder& operator=(const ReplayRecorder&) = delete;
+
+		//false if the file could not be created, nothing is recorded then
+		bool isOpen() const { return m_isOpen; }
+		//Encodes the world's current state as the frame of the given step, called by the step listener
+		void recordFrame(uint64_t step);
+		//blocks until every encoded frame is in the file
+		void flush();
+		const ReplayRecorderStats& getStats() const { return m_stats; }
+
+	private:
+		struct QuantizedTransform
+		{
+			int32_t position[3];
+			int16_t rotation[4];
+			entity_version_t version;
+		};
+
+		void encodeBody(std::vector<uint8_t>& buffer, uint32_t id, bool isNew);
+		void writerLoop();
+
+	private:
+		PhysicsWorld& m_world;
+		ReplaySettings m_settings;
+		ReplayRecorderStats m_stats;
+		size_t m_listenerId = 0;
+		bool m_isOpen = false;
+
+		//last written state of each recorded body, indexed by ID
+		EntityBitset m_recorded;
+		EntityBitset m_wasActive; //active mask of the previous frame
+		std::vector<QuantizedTransform> m_last;
+		uint32_t m_previousId = 0; //of the last body encoded in the current frame
+
+		//shared with the writer thread, guarded by m_mutex. Buffers go back to m_freeBuffers once written, so steady state recording does not allocate
+		std::ofstream m_file;
+		std::mutex m_mutex;
+		std::condition_variable m_wakeWriter;
+		std::condition_variable m_bufferWritten;
+		std::deque<std::vector<uint8_t>> m_queue;
+		std::vector<std::vector<uint8_t>> m_freeBuffers;
+		uint64_t m_writtenBytes = 0;
+		bool m_writing = false;
+		bool m_stopping = false;
+		std::thread m_writer;
+	};
+
+	struct ReplayBody
+	{
+		Entity entity;
+		btVector3 position;
+		btQuaternion rotation;
+	};
+
+	// Reads a file written by a ReplayRecorder. The file is memory mapped and its frames indexed when opened,
+	// seek decodes from the nearest keyframe before the frame so any step can be reached without decoding the whole session
+	class ReplayPlayer
+	{
+	public:
+		//false if the file is missing or is not a replay
+		bool open(const std::string& path);
+
+		size_t getFrameCount() const { return m_frames.size(); }
+		//the world step the frame was recorded after
+		uint64_t getFrameStep(size_t frame) const { return m_frames[frame].step; }
+		//getFrameCount() before the first seek
+		size_t getCurrentFrame() const { return m_currentFrame; }
+
+		//false if the frame does not exist or its data is corrupted
+		bool seek(size_t frame);
+		//the frame after the current one, cheaper than seek because it only decodes one delta
+		bool next();
+		//the frame recorded after the step, or the last one before it if that step was not recorded
+		bool seekToStep(uint64_t step);
+
+		//bodies of the current frame in ID order
+		const std::vector<ReplayBody>& getBodies() const { return m_bodies; }
+		//false if the entity had no body in the current frame
+		bool getTransform(entity_id_t id, btTransform& transform) const;
+
+	private:
+		struct FrameIndex
+		{
+			size_t offset; //of the frame payload in the file
+			size_t size;
+			uint64_t step;
+			bool keyframe;
+		};
+
+		bool decodeFrame(size_t frame);
+		void rebuildBodies();
+
+	private:
+		MappedFile m_file;
+		float m_positionPrecision = 0.001f;
+		std::vector<FrameIndex> m_frames;
+		std::vector<size_t> m_keyframes; //frame indices, ascending
+		size_t m_currentFrame = 0;
+
+		EntityBitset m_present = EntityBitset(0);
+		std::vector<int32_t> m_positions; //3 per ID
+		std::vector<int16_t> m_rotations; //4 per ID
+		std::vector<entity_version_t> m_versions;
+		std::vector<ReplayBody> m_bodies;
+	};
+}
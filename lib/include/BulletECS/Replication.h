@@ -0,0 +1,152 @@
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <btBulletDynamicsCommon.h>
+#include "BulletECS/Entity.h"
+#include "BulletECS/Span.h"
+
+namespace BulletECS
+{
+	class PhysicsWorld;
+
+	using client_id_t = uint32_t;
+
+	// The server and its clients must use the same settings, nothing of them is sent
+	struct ReplicationSettings
+	{
+		float positionPrecision = 0.01f; //meters per quantization step
+		//each client receives the bodies whose broadphase AABB touches the box of this half extent around its focus
+		float interestRadius = 100.0f;
+		//snapshots kept per client, an acknowledgement older than this is ignored and the next snapshot is sent in full
+		uint32_t historySize = 32;
+	};
+
+	// A buffer owned by the caller (e.g. a slot of its send queue) that receives one client's snapshot
+	struct SnapshotBuffer
+	{
+		client_id_t client = 0;
+		uint8_t* data = nullptr;
+		size_t capacity = 0;
+
+		//filled by encodeSnapshots
+		size_t size = 0; //0 if the buffer cannot hold the 16 byte header, no snapshot is recorded then
+		uint32_t sequence = 0; //to acknowledge once the client received it
+		bool truncated = false; //some changes did not fit, they are sent in later snapshots
+	};
+
+	struct ReplicationStats
+	{
+		//last encodeSnapshots
+		uint32_t snapshots = 0;
+		uint32_t fullSnapshots = 0; //without an acknowledged baseline
+		uint32_t truncatedSnapshots = 0;
+		uint32_t interestBodies = 0; //summed over clients
+		uint32_t records = 0; //bodies written, unchanged bodies are not
+		uint64_t encodedBytes = 0;
+		uint64_t fullStateBytes = 0; //every rigidBody for every client as an entity and float transforms, to compare with encodedBytes
+		double quantizeTime = 0.0; //milliseconds
+		double interestTime = 0.0;
+		double encodeTime = 0.0;
+	};
+
+	// Quantized state of one replicated body, positions in positionPrecision steps and the rotation packed in 32 bits (smallest three components)
+	struct ReplicatedState
+	{
+		entity_id_t id;
+		entity_version_t version;
+		int32_t position[3];
+		uint32_t rotation;
+	};
+
+	struct ReplicatedBody
+	{
+		Entity entity;
+		btVector3 position;
+		btQuaternion rotation;
+	};
+
+	// Encodes the world's rigidBodies for many clients. Each client gets the bodies around its focus, found with a broadphase AABB query,
+	// as bit packed quantized deltas against the last snapshot it acknowledged: bodies that did not move since cost nothing, bodies that moved
+	// cost a few bits per axis, bodies that left the interest area or were destroyed cost their ID.
+	// Snapshots are encoded into caller buffers, one per client, on the world's ThreadPool when it has one.
+	// Everything runs on the thread that owns the world, between steps
+	class ReplicationServer
+	{
+	public:
+		explicit ReplicationServer(PhysicsWorld& world, const ReplicationSettings& settings = ReplicationSettings());
+
+		client_id_t addClient();
+		void removeClient(client_id_t client);
+		//center of the client's interest area, e.g. its camera or avatar
+		void setClientFocus(client_id_t client, const btVector3& focus);
+		//the client received the snapshot, later snapshots are deltas against it. Older or unknown sequences are ignored
+		void acknowledge(client_id_t client, uint32_t sequence);
+
+		//Encodes one snapshot per buffer and records what each client will hold once it receives it
+		void encodeSnapshots(Span<SnapshotBuffer> buffers);
+
+		const ReplicationStats& getStats() const { return m_stats; }
+		const ReplicationSettings& getSettings() const { return m_settings; }
+
+	private:
+		struct Snapshot
+		{
+			uint32_t sequence = 0; //0 for an empty slot
+			std::vector<ReplicatedState> states; //ID order
+		};
+
+		struct Client
+		{
+			btVector3 focus = btVector3(0, 0, 0);
+			uint32_t nextSequence = 1;
+			uint32_t ackedSequence = 0;
+			std::vector<Snapshot> history; //indexed by sequence % historySize
+			std::vector<entity_id_t> interest; //ID order
+		};
+
+		void queryInterest(Client& client);
+		void encodeSnapshot(Client& client, SnapshotBuffer& buffer, ReplicationStats& stats);
+
+	private:
+		PhysicsWorld& m_world;
+		ReplicationSettings m_settings;
+		ReplicationStats m_stats;
+		std::unordered_map<client_id_t, Client> m_clients;
+		client_id_t m_nextClientId = 1;
+
+		//quantized state of every rigidBody for the current encodeSnapshots, indexed by ID
+		std::vector<ReplicatedState> m_current;
+		std::vector<Client*> m_encodingClients; //per buffer
+		std::vector<ReplicationStats> m_bufferStats;
+	};
+
+	// Decodes the snapshots of a ReplicationServer for one client, e.g. on a game client or in process as a loopback to check a server
+	class ReplicationClient
+	{
+	public:
+		explicit ReplicationClient(const ReplicationSettings& settings = ReplicationSettings());
+
+		//false if the snapshot is corrupted or its baseline is no longer kept, the client state is left as it was
+		bool receive(const uint8_t* data, size_t size);
+		//sequence of the last snapshot received, to send back to ReplicationServer::acknowledge
+		uint32_t getLastSequence() const { return m_lastSequence; }
+
+		//bodies of the last snapshot in ID order
+		const std::vector<ReplicatedBody>& getBodies() const { return m_bodies; }
+		//false if the entity was not in the last snapshot
+		bool getTransform(Entity entity, btTransform& transform) const;
+
+	private:
+		struct Snapshot
+		{
+			uint32_t sequence = 0;
+			std::vector<ReplicatedState> states;
+		};
+
+		ReplicationSettings m_settings;
+		std::vector<Snapshot> m_history;
+		uint32_t m_lastSequence = 0;
+		std::vector<ReplicatedBody> m_bodies;
+	};
+}
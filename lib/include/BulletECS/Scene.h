@@ -0,0 +1,74 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "BulletECS/Entity.h"
+
+namespace BulletECS
+{
+	class PhysicsWorld;
+
+	struct SceneLoadStats
+	{
+		uint32_t shapes = 0;
+		uint32_t prefabs = 0;
+		uint64_t instances = 0;
+
+		//milliseconds
+		double mapTime = 0.0; //opening, mapping and validating the file
+		double prefabTime = 0.0; //resolving the shapes and prefabs
+		double instanceTime = 0.0; //creating the bodies
+		double totalTime = 0.0;
+	};
+
+	// Binary scene files, laid out to be memory mapped and used in place:
+	//	Header | ShapeRecord[shapeCount] | PrefabRecord[prefabCount] | uint32 prefabIndices[instanceCount] | float positions[3 * instanceCount] | float rotations[4 * instanceCount]
+	// Every section starts at a 16 byte aligned offset given by the header. Numbers are in the machine's byte order.
+	// A prefab is a shape plus mass, restitution and layer, instances are stored as arrays (one per field) so the loader reads them in order
+	namespace Scene
+	{
+		constexpr char MAGIC[4] = { 'B', 'E', 'S', 'N' };
+		constexpr uint32_t VERSION = 1;
+		constexpr size_t SECTION_ALIGNMENT = 16;
+
+		struct Header
+		{
+			char magic[4];
+			uint32_t version;
+			uint32_t shapeCount;
+			uint32_t prefabCount;
+			uint64_t instanceCount;
+			uint64_t shapesOffset;
+			uint64_t prefabsOffset;
+			uint64_t prefabIndicesOffset;
+			uint64_t positionsOffset;
+			uint64_t rotationsOffset;
+		};
+
+		struct ShapeRecord
+		{
+			uint8_t type; //ColliderType
+			uint8_t padding[3];
+			float size[3]; //see ColliderDesc::size
+		};
+
+		struct PrefabRecord
+		{
+			uint32_t shape;
+			float mass;
+			float restitution;
+			uint8_t layer;
+			uint8_t padding[3];
+		};
+
+		static_assert(sizeof(Header) == 64 && sizeof(ShapeRecord) == 16 && sizeof(PrefabRecord) == 16, "Scene records are mapped as raw bytes, they must not have hidden padding.");
+
+		//Writes every rigidBody that PhysicsWorld::getBodyDesc can describe, in entity ID order. Bodies with the same collider, mass, restitution and layer share a prefab
+		bool save(const PhysicsWorld& world, const std::string& path);
+
+		//Maps the file, resolves each shape once through the world's CollisionShapeContainer and creates the bodies with PhysicsWorld::addPrefabInstances
+		//straight from the mapped arrays. entities (if not null) receives them in file order. Returns false without touching the world if the file is missing, invalid,
+		//or has more bodies than the world has free entities
+		bool load(PhysicsWorld& world, const std::string& path, std::vector<Entity>* entities = nullptr, SceneLoadStats* stats = nullptr);
+	}
+}
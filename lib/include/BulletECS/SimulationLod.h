@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdint>
+namespace BulletECS
+{
+	enum class SimulationLod : uint8_t
+	{
+		Full, //simulated every step
+		Reduced, //simulated one step out of reducedStepDivisor, moved with its velocity in the others
+		Frozen //not simulated, keeps its velocities until it is promoted again
+	};
+
+	// Tiers come from the distance to the nearest focus point (players, cameras...), with a margin so bodies on a border do not flicker.
+	// Only entities added with PhysicsWorld::addSimulationLod are affected, everything else is always Full
+	struct SimulationLodSettings
+	{
+		float fullRadius = 50.0f;
+		float reducedRadius = 150.0f; //beyond it bodies are Frozen
+		float hysteresis = 0.1f; //a body is demoted once it is this fraction beyond the radius
+		uint32_t reducedStepDivisor = 4;
+		//Tiers are recomputed for 1/updateInterval of the entities each step, so the distance checks are spread over the frames
+		uint32_t updateInterval = 8;
+	};
+
+	struct SimulationLodComponent
+	{
+		SimulationLod tier = SimulationLod::Full;
+		bool suspended = false; //DISABLE_SIMULATION was set by the LOD, restored when the body has to be simulated again
+	};
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include <array>
+#include <type_traits>
+#include <cassert>
+namespace BulletECS
+{
+	// Non owning view of contiguous elements, used by the bulk APIs (std::span is C++20)
+	template <class T>
+	class Span
+	{
+	public:
+		Span() = default;
+		Span(T* data, size_t size) : m_data(data), m_size(size) {}
+		template <class U, class = std::enable_if_t<std::is_convertible_v<U(*)[], T(*)[]>>>
+		Span(std::vector<U>& vector) : m_data(vector.data()), m_size(vector.size()) {}
+		template <class U, class = std::enable_if_t<std::is_convertible_v<const U(*)[], T(*)[]>>>
+		Span(const std::vector<U>& vector) : m_data(vector.data()), m_size(vector.size()) {}
+		template <class U, size_t N, class = std::enable_if_t<std::is_convertible_v<U(*)[], T(*)[]>>>
+		Span(std::array<U, N>& array) : m_data(array.data()), m_size(N) {}
+		template <size_t N>
+		Span(T(&array)[N]) : m_data(array), m_size(N) {}
+
+		inline T* data() const { return m_data; }
+		inline size_t size() const { return m_size; }
+		inline bool empty() const { return m_size == 0; }
+		inline T& operator[](size_t idx) const
+		{
+			assert(idx < m_size && "Span index out of bounds.");
+			return m_data[idx];
+		}
+		inline T* begin() const { return m_data; }
+		inline T* end() const { return m_data + m_size; }
+
+		Span subspan(size_t offset, size_t count) const
+		{
+			assert(offset + count <= m_size && "Subspan out of bounds.");
+			return Span(m_data + offset, count);
+		}
+
+	private:
+		T* m_data = nullptr;
+		size_t m_size = 0;
+	};
+}
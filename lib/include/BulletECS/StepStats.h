@@ -0,0 +1,127 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <vector>
+namespace BulletECS
+{
+	// Bullet phases timed from its BT_PROFILE zones, nested zones are counted in the outermost phase
+	enum class StepPhase
+	{
+		PredictMotion, //predictUnconstraintMotion
+		UpdateAabbs, //updateAabbs
+		Broadphase, //calculateOverlappingPairs
+		Narrowphase, //dispatchAllCollisionPairs
+		Islands, //calculateSimulationIslands
+		Solver, //solveConstraints
+		Integration, //integrateTransforms, createPredictiveContacts
+		Deactivation, //updateActivationState
+		MotionStates, //synchronizeMotionStates
+		Count
+	};
+
+	const char* getStepPhaseName(StepPhase phase);
+
+	struct StepStats
+	{
+		uint64_t frame = 0;
+		int subSteps = 0;
+
+		//milliseconds
+		double totalTime = 0.0; //the whole PhysicsWorld::stepSimulation
+		double bulletTime = 0.0; //btDynamicsWorld::stepSimulation
+		double ecsTime = 0.0; //library bookkeeping around Bullet's step
+		std::array<double, static_cast<size_t>(StepPhase::Count)> phaseTimes = {}; //zero if Bullet was built with BT_NO_PROFILE
+
+		//Bullet state after the step
+		uint32_t overlappingPairs = 0;
+		uint32_t manifolds = 0;
+		uint32_t contacts = 0;
+		uint32_t islands = 0; //simulation islands of non static bodies, awake or sleeping
+		uint32_t activeBodies = 0;
+		uint32_t lodSuspendedBodies = 0; //Reduced and Frozen bodies skipped by this step, see PhysicsWorld::addSimulationLod
+
+		//ECS counters since the previous step
+		uint32_t entitiesCreated = 0;
+		uint32_t entitiesDestroyed = 0;
+		uint32_t shapeCacheHits = 0; //colliders that reused an existing shape
+		uint32_t shapeCacheMisses = 0; //colliders that created a new shape
+
+		//heap allocations made by the stepping thread, see AllocationTracker
+		uint32_t stepAllocations = 0; //inside stepSimulation
+		uint32_t allocationsBetweenSteps = 0; //since the previous step ended (spawns, destroys and user code)
+
+		//pool occupancy after the step
+		uint32_t liveEntities = 0;
+		uint32_t rigidBodies = 0;
+		uint32_t motionStates = 0;
+		uint32_t colliders = 0;
+		uint32_t uniqueShapes = 0;
+
+		double getPhaseTime(StepPhase phase) const { return phaseTimes[static_cast<size_t>(phase)]; }
+	};
+
+	// Keeps the stats of the last N steps, older frames are overwritten. Recording never allocates
+	class StepStatsHistory
+	{
+	public:
+		static constexpr size_t DEFAULT_CAPACITY = 120;
+
+		StepStatsHistory() : StepStatsHistory(DEFAULT_CAPACITY) {}
+		explicit StepStatsHistory(size_t capacity) : m_frames(capacity > 0 ? capacity : 1) {}
+
+		void push(const StepStats& stats)
+		{
+			m_frames[m_next] = stats;
+			m_next = (m_next + 1) % m_frames.size();
+			m_size = m_size < m_frames.size() ? m_size + 1 : m_size;
+		}
+
+		size_t size() const { return m_size; }
+		size_t capacity() const { return m_frames.size(); }
+		bool empty() const { return m_size == 0; }
+
+		//0 is the last step, size() - 1 the oldest one kept
+		const StepStats& getFramesAgo(size_t framesAgo) const
+		{
+			return m_frames[(m_next + m_frames.size() - 1 - framesAgo) % m_frames.size()];
+		}
+		const StepStats& getLast() const { return getFramesAgo(0); }
+
+		//the slowest kept step, e.g. to inspect a spike
+		const StepStats& getSlowest() const
+		{
+			size_t slowest = 0;
+			for (size_t i = 1; i < m_size; i++)
+			{
+				slowest = getFramesAgo(i).totalTime > getFramesAgo(slowest).totalTime ? i : slowest;
+			}
+			return getFramesAgo(slowest);
+		}
+
+	private:
+		std::vector<StepStats> m_frames;
+		size_t m_next = 0;
+		size_t m_size = 0;
+	};
+
+	// Process-wide hooks set with btSetCustomEnterProfileZoneFunc / btSetCustomLeaveProfileZoneFunc that time Bullet's phases.
+	// The previous hooks are still called, so CProfileManager keeps working. Zones only reach a StepStats while it is bound to the calling thread
+	namespace StepProfiler
+	{
+		void install();
+
+		// Binds the stats to the current thread for the lifetime of the object, nullptr binds none
+		class ScopedCapture
+		{
+		public:
+			ScopedCapture(StepStats* stats);
+			~ScopedCapture();
+			ScopedCapture(const ScopedCapture&) = delete;
+			ScopedCapture& operator=(const ScopedCapture&) = delete;
+
+		private:
+			StepStats* m_previous;
+		};
+	}
+}
@@ -0,0 +1,134 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <cassert>
+
+namespace BulletECS
+{
+	class PhysicsWorld;
+	class ThreadPool;
+
+	using component_type_id = const void*;
+
+	template <class T>
+	struct ComponentTypeTag
+	{
+		static inline char id = 0; //only its address is used, one per type
+	};
+
+	template <class T>
+	inline component_type_id getComponentTypeId() { return &ComponentTypeTag<T>::id; }
+
+	enum class SystemPhase : uint8_t { PreStep, PostStep, Count };
+
+	struct SystemTiming
+	{
+		std::string_view name;
+		SystemPhase phase = SystemPhase::PreStep;
+		double time = 0.0; //milliseconds
+	};
+
+	// Runs the gameplay systems of a world around stepSimulation. Each system declares the components it reads and writes,
+	// two systems of the same phase that conflict (one writes what the other reads or writes) run in registration order
+	// unless after/before says otherwise, and the rest run at the same time on the world's thread pool.
+	// Components are any types, e.g. reads<btRigidBody>() or writes<Health>(). Systems that create or destroy entities or add/remove
+	// components change the world itself and must declare writes<PhysicsWorld>(), the mutable get of a pool with change tracking is a write too
+	class SystemScheduler
+	{
+	public:
+		using SystemFunction = std::function<void(float timeStep)>;
+
+		class SystemBuilder
+		{
+		public:
+			SystemBuilder(SystemScheduler& scheduler, size_t system) : m_scheduler(scheduler), m_system(system) {}
+
+			template <class... Ts>
+			SystemBuilder& reads()
+			{
+				(m_scheduler.addAccess(m_system, getComponentTypeId<Ts>(), false), ...);
+				return *this;
+			}
+			template <class... Ts>
+			SystemBuilder& writes()
+			{
+				(m_scheduler.addAccess(m_system, getComponentTypeId<Ts>(), true), ...);
+				return *this;
+			}
+			//the other system must be in the same phase, systems of PreStep always run before the step and PostStep ones after it
+			SystemBuilder& after(std::string_view other) { m_scheduler.addOrder(m_system, other, true); return *this; }
+			SystemBuilder& before(std::string_view other) { m_scheduler.addOrder(m_system, other, false); return *this; }
+
+		private:
+			SystemScheduler& m_scheduler;
+			size_t m_system;
+		};
+
+		SystemBuilder addSystem(std::string name, SystemPhase phase, SystemFunction function);
+
+		//PreStep systems, world.stepSimulation, then PostStep systems. Uses the world's thread pool, without one everything runs on the calling thread
+		void run(PhysicsWorld& world, float timeStep, int maxSubSteps = 1, float fixedTimeStep = 1.0f / 60.0f);
+		//one phase without stepping, e.g. for systems that run at render rate
+		void runPhase(SystemPhase phase, float timeStep, ThreadPool* threadPool);
+
+		//every system of the last run in registration order, the names stay valid while the scheduler lives
+		const std::vector<SystemTiming>& getTimings() const { return m_timings; }
+		double getPhaseTime(SystemPhase phase) const { return m_phaseTimes[static_cast<size_t>(phase)]; }
+		double getStepTime() const { return m_stepTime; }
+		size_t getSystemCount() const { return m_systems.size(); }
+
+	private:
+		struct OrderConstraint
+		{
+			std::string other;
+			bool after;
+		};
+
+		struct System
+		{
+			std::string name;
+			SystemPhase phase;
+			SystemFunction function;
+			std::vector<component_type_id> reads;
+			std::vector<component_type_id> writes;
+			std::vector<OrderConstraint> order;
+			//built by buildGraphs
+			std::vector<size_t> dependents;
+			uint32_t dependencyCount = 0;
+		};
+
+		struct PhaseGraph
+		{
+			std::vector<size_t> systems; //registration order
+			std::vector<size_t> roots;
+		};
+
+		void addAccess(size_t system, component_type_id component, bool write);
+		void addOrder(size_t system, std::string_view other, bool after);
+		void buildGraphs();
+		static bool conflict(const System& a, const System& b);
+		void runSystem(size_t system, float timeStep);
+
+	private:
+		std::deque<System> m_systems; //deque so the names keep their address for the timings and the trace
+		PhaseGraph m_graphs[static_cast<size_t>(SystemPhase::Count)];
+		bool m_graphsDirty = true;
+
+		//state of the phase being run, guarded by m_mutex
+		std::mutex m_mutex;
+		std::condition_variable m_systemFinished;
+		std::vector<size_t> m_ready;
+		std::vector<uint32_t> m_remainingDependencies;
+		size_t m_finishedSystems = 0;
+
+		std::vector<SystemTiming> m_timings;
+		double m_phaseTimes[static_cast<size_t>(SystemPhase::Count)] = {};
+		double m_stepTime = 0.0;
+	};
+}
@@ -1,11 +1,16 @@
 #pragma once
 #include <string>
+#include <cstdint>
 namespace BulletECS
 {
+	using tag_id_t = uint32_t;
+	constexpr tag_id_t NO_TAG_ID = 0;
 	const std::string NO_TAG = "Unnamed-Entity";
+
+	//Tag names are interned in the world's TagTable, entities only store the ID
 	struct TagComponent
 	{
-		TagComponent(const std::string& n) : name(n) {}
-		std::string name;
+		TagComponent(tag_id_t i) : id(i) {}
+		tag_id_t id;
 	};
-}
\ No newline at end of file
+}
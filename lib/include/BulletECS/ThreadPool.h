@@ -0,0 +1,53 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <thread>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+namespace BulletECS
+{
+	// Fixed set of worker threads used by the library for data parallel work (batched worlds, bulk operations...).
+	// The calling thread also takes chunks, so a pool with 0 workers runs everything inline.
+	class ThreadPool
+	{
+	public:
+		//0 means one thread per hardware thread (counting the caller)
+		explicit ThreadPool(size_t threadCount = 0);
+		~ThreadPool();
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		//workers plus the calling thread
+		size_t getThreadCount() const { return m_workers.size() + 1; }
+
+		// Calls function(begin, end) over [0, count) split in chunks of grainSize, blocks until every chunk is done.
+		// Calls made from inside a task run inline, so nested parallelFor does not deadlock
+		void parallelFor(size_t count, const std::function<void(size_t begin, size_t end)>& function, size_t grainSize = 1);
+
+	private:
+		struct Job
+		{
+			const std::function<void(size_t, size_t)>* function = nullptr;
+			size_t count = 0;
+			size_t grainSize = 1;
+			std::atomic<size_t> nextIndex{ 0 };
+			std::atomic<size_t> pendingChunks{ 0 };
+		};
+
+		void workerLoop();
+		void runChunks(Job& job);
+
+	private:
+		std::vector<std::thread> m_workers;
+		std::mutex m_mutex;
+		std::condition_variable m_wakeWorkers;
+		std::condition_variable m_jobDone;
+		std::mutex m_submitMutex; //one parallelFor at a time
+		Job m_job;
+		uint64_t m_jobGeneration = 0;
+		size_t m_activeWorkers = 0;
+		bool m_stopping = false;
+	};
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <string>
+#include <ostream>
+
+// Timeline of the library's hot paths, exported as Chrome trace JSON (chrome://tracing, ui.perfetto.dev).
+// Enabled with the BULLET_ECS_ENABLE_TRACING CMake option, otherwise every macro compiles to nothing.
+//
+//	BULLET_ECS_TRACE_SCOPE("MySystem");	//span from here to the end of the scope, the name must be a string literal
+//	BulletECS::Trace::writeChromeTrace("trace.json");
+
+#ifdef BULLET_ECS_ENABLE_TRACING
+
+#include <cstdint>
+
+#ifndef BULLET_ECS_TRACE_BUFFER_EVENTS
+#define BULLET_ECS_TRACE_BUFFER_EVENTS 65536 //spans kept per thread, older ones are overwritten
+#endif
+
+#define BULLET_ECS_TRACE_CONCAT_INNER(a, b) a##b
+#define BULLET_ECS_TRACE_CONCAT(a, b) BULLET_ECS_TRACE_CONCAT_INNER(a, b)
+#define BULLET_ECS_TRACE_SCOPE(name) ::BulletECS::Trace::ScopedSpan BULLET_ECS_TRACE_CONCAT(bulletEcsTraceSpan, __LINE__)(name)
+#define BULLET_ECS_TRACE_THREAD_NAME(name) ::BulletECS::Trace::setThreadName(name)
+
+namespace BulletECS
+{
+	namespace Trace
+	{
+		uint64_t now(); //nanoseconds since the first traced span of the process
+		void record(const char* name, uint64_t start, uint64_t end);
+		void setThreadName(const char* name);
+
+		class ScopedSpan
+		{
+		public:
+			ScopedSpan(const char* name) : m_name(name), m_start(now()) {}
+			~ScopedSpan() { record(m_name, m_start, now()); }
+			ScopedSpan(const ScopedSpan&) = delete;
+			ScopedSpan& operator=(const ScopedSpan&) = delete;
+
+		private:
+			const char* m_name;
+			uint64_t m_start;
+		};
+
+		// Can be called while other threads keep tracing, spans overwritten during the copy are skipped
+		void writeChromeTrace(std::ostream& out);
+		bool writeChromeTrace(const std::string& path);
+		// Drops the spans recorded so far, can also be called while other threads keep tracing
+		void clear();
+	}
+}
+
+#else
+
+#define BULLET_ECS_TRACE_SCOPE(name) ((void)0)
+#define BULLET_ECS_TRACE_THREAD_NAME(name) ((void)0)
+
+namespace BulletECS
+{
+	namespace Trace
+	{
+		inline void writeChromeTrace(std::ostream&) {}
+		inline bool writeChromeTrace(const std::string&) { return false; }
+		inline void clear() {}
+	}
+}
+
+#endif
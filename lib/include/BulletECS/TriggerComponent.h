@@ -0,0 +1,87 @@
+#pragma once
+#include <vector>
+#include <btBulletDynamicsCommon.h>
+#include <BulletCollision/CollisionDispatch/btGhostObject.h>
+#include "BulletECS/Entity.h"
+namespace BulletECS
+{
+	//Collision objects created by the library keep their entity in the user indices, objects added directly through Bullet keep the default -1
+	inline void setCollisionObjectEntity(btCollisionObject* object, Entity entity)
+	{
+		object->setUserIndex(static_cast<int>(entity.ID));
+		object->setUserIndex2(static_cast<int>(entity.version));
+	}
+
+	//NULL_ENTITY for objects that do not belong to an entity
+	inline Entity getCollisionObjectEntity(const btCollisionObject* object)
+	{
+		if (object->getUserIndex() < 0)
+		{
+			return Entity{};
+		}
+		return Entity{ static_cast<entity_id_t>(object->getUserIndex()), static_cast<entity_version_t>(object->getUserIndex2()) };
+	}
+
+	struct TriggerEvent
+	{
+		Entity trigger;
+		Entity other;
+	};
+
+	struct TriggerEventBuffers
+	{
+		std::vector<TriggerEvent> enter;
+		std::vector<TriggerEvent> exit;
+
+		void clear() { enter.clear(); exit.clear(); }
+	};
+
+	// Ghost object of a trigger entity. Bullet's btGhostPairCallback calls these when the broadphase adds or removes a pair with the ghost,
+	// so the cached overlaps and the events only cost work when a pair changes. Overlaps are aabb overlaps, there is no narrowphase test
+	class TriggerGhostObject : public btPairCachingGhostObject
+	{
+	public:
+		TriggerGhostObject(Entity entity, TriggerEventBuffers* events) : m_entity(entity), m_events(events)
+		{
+			setCollisionObjectEntity(this, entity);
+			setCollisionFlags(getCollisionFlags() | CF_NO_CONTACT_RESPONSE);
+		}
+
+		void addOverlappingObjectInternal(btBroadphaseProxy* otherProxy, btBroadphaseProxy* thisProxy = nullptr) override
+		{
+			//the base class ignores pairs it already has, only a new entry in the cache is an enter
+			const int overlapCount = getNumOverlappingObjects();
+			btPairCachingGhostObject::addOverlappingObjectInternal(otherProxy, thisProxy);
+			if (getNumOverlappingObjects() != overlapCount)
+			{
+				pushEvent(m_events->enter, otherProxy);
+			}
+		}
+
+		void removeOverlappingObjectInternal(btBroadphaseProxy* otherProxy, btDispatcher* dispatcher, btBroadphaseProxy* thisProxy = nullptr) override
+		{
+			const int overlapCount = getNumOverlappingObjects();
+			btPairCachingGhostObject::removeOverlappingObjectInternal(otherProxy, dispatcher, thisProxy);
+			if (getNumOverlappingObjects() != overlapCount)
+			{
+				pushEvent(m_events->exit, otherProxy);
+			}
+		}
+
+		inline Entity getEntity() const { return m_entity; }
+
+	private:
+		void pushEvent(std::vector<TriggerEvent>& events, const btBroadphaseProxy* otherProxy)
+		{
+			const Entity other = getCollisionObjectEntity(static_cast<const btCollisionObject*>(otherProxy->m_clientObject));
+			if (other.ID != NULL_ENTITY)
+			{
+				events.push_back(TriggerEvent{ m_entity, other });
+			}
+		}
+
+	private:
+		Entity m_entity;
+		TriggerEventBuffers* m_events;
+	};
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <btBulletDynamicsCommon.h>
+#include <vector>
+#include <memory>
+#include <cstdint>
+namespace BulletECS
+{
+	// Broadphase for dense scenes of evenly sized objects: every frame the proxies are binned into a hashed uniform grid
+	// and only proxies sharing a cell are tested. The cell size should be about the size of the biggest moving object.
+	// Proxies that span too many cells (floors, terrain) are kept apart and tested against every other proxy.
+	class UniformGridBroadphase : public btBroadphaseInterface
+	{
+	public:
+		UniformGridBroadphase(const btVector3& worldAabbMin, const btVector3& worldAabbMax, btScalar cellSize, int maxProxies, btOverlappingPairCache* pairCache = nullptr);
+		~UniformGridBroadphase() override;
+
+		btBroadphaseProxy* createProxy(const btVector3& aabbMin, const btVector3& aabbMax, int shapeType, void* userPtr, int collisionFilterGroup, int collisionFilterMask, btDispatcher* dispatcher) override;
+		void destroyProxy(btBroadphaseProxy* proxy, btDispatcher* dispatcher) override;
+		void setAabb(btBroadphaseProxy* proxy, const btVector3& aabbMin, const btVector3& aabbMax, btDispatcher* dispatcher) override;
+		void getAabb(btBroadphaseProxy* proxy, btVector3& aabbMin, btVector3& aabbMax) const override;
+
+		void rayTest(const btVector3& rayFrom, const btVector3& rayTo, btBroadphaseRayCallback& rayCallback, const btVector3& aabbMin = btVector3(0, 0, 0), const btVector3& aabbMax = btVector3(0, 0, 0)) override;
+		void aabbTest(const btVector3& aabbMin, const btVector3& aabbMax, btBroadphaseAabbCallback& callback) override;
+
+		void calculateOverlappingPairs(btDispatcher* dispatcher) override;
+
+		btOverlappingPairCache* getOverlappingPairCache() override { return m_pairCache; }
+		const btOverlappingPairCache* getOverlappingPairCache() const override { return m_pairCache; }
+
+		void getBroadphaseAabb(btVector3& aabbMin, btVector3& aabbMax) const override;
+		void printStats() override {}
+
+	private:
+		struct CellEntry
+		{
+			uint32_t bucket;
+			int proxy;
+			int x, y, z;
+		};
+
+		static inline bool aabbOverlap(const btBroadphaseProxy* a, const btBroadphaseProxy* b)
+		{
+			return a->m_aabbMin.x() <= b->m_aabbMax.x() && b->m_aabbMin.x() <= a->m_aabbMax.x() &&
+				a->m_aabbMin.y() <= b->m_aabbMax.y() && b->m_aabbMin.y() <= a->m_aabbMax.y() &&
+				a->m_aabbMin.z() <= b->m_aabbMax.z() && b->m_aabbMin.z() <= a->m_aabbMax.z();
+		}
+
+		inline int proxyIndex(const btBroadphaseProxy* proxy) const { return static_cast<int>(proxy - m_proxies.data()); }
+		void cellOf(const btVector3& point, int& x, int& y, int& z) const;
+		void addPairIfOverlapping(btBroadphaseProxy* a, btBroadphaseProxy* b);
+
+	private:
+		btVector3 m_worldAabbMin;
+		btVector3 m_worldAabbMax;
+		btScalar m_inverseCellSize;
+		int m_maxCellsPerProxy = 64; //bigger proxies are treated as oversized
+
+		std::vector<btBroadphaseProxy> m_proxies; //fixed size so proxy pointers stay valid
+		std::vector<int> m_freeProxies;
+		std::vector<int> m_liveProxies;
+		std::vector<int> m_livePosition; //index of each proxy in m_liveProxies
+
+		//rebuilt every frame, kept as members so steady state frames do not allocate
+		std::vector<CellEntry> m_entries;
+		std::vector<CellEntry> m_sortedEntries;
+		std::vector<uint32_t> m_bucketStart;
+		std::vector<int> m_oversizedProxies;
+
+		btOverlappingPairCache* m_pairCache;
+		std::unique_ptr<btHashedOverlappingPairCache> m_ownedPairCache;
+	};
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include "BulletECS/PhysicsWorld.h"
+#include "BulletECS/ThreadPool.h"
+#include <vector>
+#include <memory>
+#include <functional>
+namespace BulletECS
+{
+	// Owns many small independent worlds (e.g. for training or what-if evaluation) and steps them in parallel.
+	// After each step the state of every rigid body is gathered into one contiguous float buffer laid out as
+	// [world][entity ID][OBSERVATION_SIZE], with zeros for IDs without a rigid body.
+	class WorldBatch
+	{
+	public:
+		//position xyz, rotation quaternion xyzw, linear velocity xyz, angular velocity xyz
+		static constexpr size_t OBSERVATION_SIZE = 13;
+
+		//worldConfig.maxEntities should be sized to the worlds, it is also the size of each world's observation block.
+		//threadCount 0 means one thread per hardware thread
+		WorldBatch(size_t worldCount, const PhysicsWorldConfig& worldConfig, size_t threadCount = 0);
+
+		size_t size() const { return m_worlds.size(); }
+		PhysicsWorld& getWorld(size_t index) { return *m_worlds[index]; }
+		const PhysicsWorld& getWorld(size_t index) const { return *m_worlds[index]; }
+
+		//Runs function(worldIndex, world) for every world in parallel, e.g. to reset or spawn entities
+		void forEachWorld(const std::function<void(size_t, PhysicsWorld&)>& function);
+
+		//Steps every world in parallel and then gathers the observations
+		void stepSimulation(float timeStep, int maxSubSteps = 1, float fixedTimeStep = 1.0f / 60.0f);
+		void gatherObservations();
+
+		const float* getObservations() const { return m_observations.data(); }
+		const float* getObservations(size_t worldIndex) const { return m_observations.data() + worldIndex * getObservationStride(); }
+		//floats between two consecutive worlds in the observation buffer
+		size_t getObservationStride() const { return m_entitySlots * OBSERVATION_SIZE; }
+		size_t getEntitySlots() const { return m_entitySlots; }
+
+		ThreadPool& getThreadPool() { return m_threadPool; }
+
+	private:
+		void gatherObservations(size_t worldIndex);
+
+	private:
+		std::vector<std::unique_ptr<PhysicsWorld>> m_worlds;
+		size_t m_entitySlots;
+		std::vector<float> m_observations;
+		ThreadPool m_threadPool;
+	};
+}
@@ -0,0 +1,176 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <functional>
+#include <cstdint>
+#include "BulletECS/Entity.h"
+#include "BulletECS/BodyDesc.h"
+#include "BulletECS/Span.h"
+
+namespace BulletECS
+{
+	class PhysicsWorld;
+
+	// Cells are columns of the XZ plane, cellSize wide, so a map is split without caring about heights
+	struct CellCoord
+	{
+		int32_t x = 0;
+		int32_t z = 0;
+
+		bool operator==(const CellCoord& other) const { return x == other.x && z == other.z; }
+		bool operator!=(const CellCoord& other) const { return !(*this == other); }
+	};
+
+	struct CellCoordHash
+	{
+		size_t operator()(const CellCoord& cell) const { return std::hash<uint64_t>()((uint64_t(uint32_t(cell.x)) << 32) | uint32_t(cell.z)); }
+	};
+
+	enum class CellState : uint8_t
+	{
+		Unloaded,
+		Loading, //queued or being decoded by the loader thread
+		Committing, //decoded, its bodies are being added by update()
+		Loaded,
+		Unloading, //its entities are being destroyed by update()
+		Failed //missing or invalid file, requestLoad skips it until requestUnload (or streamAround leaving it) resets it to Unloaded
+	};
+
+	struct StreamingSettings
+	{
+		float cellSize = 100.0f;
+		//Main thread time per update() spent adding and removing bodies, what is left waits for the next update. At least one batch is done per update
+		double commitBudgetMs = 1.0;
+		//bodies added or removed between two reads of the clock
+		size_t commitBatchSize = 64;
+	};
+
+	struct StreamingStats
+	{
+		uint32_t cellsLoading = 0; //requested and not fully committed yet
+		uint32_t cellsLoaded = 0;
+		uint32_t cellsUnloading = 0;
+
+		//last update()
+		uint32_t bodiesAdded = 0;
+		uint32_t bodiesRemoved = 0;
+		double updateTime = 0.0; //milliseconds
+
+		//from requestLoad to the last body of the cell added, milliseconds
+		double lastLoadLatency = 0.0;
+		double maxLoadLatency = 0.0;
+		double averageLoadLatency = 0.0;
+		uint64_t loadsCompleted = 0;
+		uint64_t loadsFailed = 0; //missing or invalid cell files, the cell is left Failed
+	};
+
+	// Loads and unloads cells of a big map while the world runs. A loader thread reads and decodes a cell file into a staging buffer of BodyDescs,
+	// then update() adds the bodies with PhysicsWorld::addBodies in batches until its time budget is spent, so a cell with thousands of bodies
+	// is spread over several frames instead of hitching one. Unloads are batched the same way.
+	// The streamer owns the entities it creates and destroys them with PhysicsWorld::destroyEntity, the user can destroy them earlier.
+	// Everything but the loader thread runs on the thread that owns the world
+	class WorldStreamer
+	{
+	public:
+		//cell files are directory/cell_<x>_<z>.bin
+		WorldStreamer(PhysicsWorld& world, std::string directory, const StreamingSettings& settings = StreamingSettings());
+		//stops the loader thread, the entities of the loaded cells stay in the world
+		~WorldStreamer();
+		WorldStreamer(const WorldStreamer&) = delete;
+		WorldStreamer& operator=(const WorldStreamer&) = delete;
+
+		CellCoord getCell(const btVector3& position) const;
+		std::string getCellPath(CellCoord cell) const;
+
+		//Writes every rigidBody of the world whose position is inside the cell, e.g. to split an authored level. Bodies that getBodyDesc cannot describe are skipped
+		bool saveCell(CellCoord cell) const;
+
+		//Cell files are a header and one fixed size record per body, in the machine's byte order
+		static bool writeCellFile(const std::string& path, Span<const BodyDesc> bodies);
+		static bool readCellFile(const std::string& path, std::vector<BodyDesc>& bodies);
+
+		//Nothing happens if the cell is loaded, loading or failed. An unloading cell is loaded again once its entities are gone
+		void requestLoad(CellCoord cell);
+		//A cell still being decoded is dropped when it arrives, the bodies already added by a committing cell are removed.
+		//A failed cell goes back to Unloaded, so the next requestLoad retries it
+		void requestUnload(CellCoord cell);
+		//Requests the cells touching the circle around the focus and unloads the loaded ones beyond radius plus one cell, so a focus on a border does not flicker
+		void streamAround(const btVector3& focus, float radius);
+
+		//Commits the decoded cells and removes the unloaded ones within the budget, call it from the world's thread, e.g. before each step
+		void update();
+		//Blocks until every requested cell is loaded or failed and every unload is done, ignoring the budget (e.g. behind a loading screen)
+		void flush();
+
+		CellState getCellState(CellCoord cell) const;
+		//entities added so far, some may have been destroyed by the user since
+		Span<const Entity> getCellEntities(CellCoord cell) const;
+		const StreamingStats& getStats() const { return m_stats; }
+		const StreamingSettings& getSettings() const { return m_settings; }
+
+	private:
+		using Clock = std::chrono::steady_clock;
+
+		struct Cell
+		{
+			CellState state = CellState::Unloaded;
+			uint32_t generation = 0; //bumped on unload, decoded results of older generations are dropped
+			bool reloadAfterUnload = false;
+			Clock::time_point requestTime;
+			std::vector<BodyDesc> staging;
+			size_t committed = 0; //bodies of staging already added
+			std::vector<Entity> entities;
+		};
+
+		struct LoadRequest
+		{
+			CellCoord cell;
+			uint32_t generation;
+			std::string path;
+		};
+
+		struct DecodedCell
+		{
+			CellCoord cell;
+			uint32_t generation;
+			bool ok;
+			std::vector<BodyDesc> bodies;
+		};
+
+		void loaderLoop();
+		void queueLoad(CellCoord coord, Cell& cell);
+		void collectDecodedCells();
+		//return true when the cell is done
+		bool commitBatch(Cell& cell, size_t batchSize);
+		bool unloadBatch(Cell& cell, size_t batchSize);
+		void finishLoad(Cell& cell);
+		void updateCellCounts();
+
+	private:
+		PhysicsWorld& m_world;
+		std::string m_directory;
+		StreamingSettings m_settings;
+		StreamingStats m_stats;
+		double m_totalLoadLatency = 0.0;
+
+		std::unordered_map<CellCoord, Cell, CellCoordHash> m_cells;
+		std::deque<CellCoord> m_commitQueue; //oldest request first
+		std::deque<CellCoord> m_unloadQueue;
+
+		//shared with the loader thread, guarded by m_mutex
+		std::mutex m_mutex;
+		std::condition_variable m_wakeLoader;
+		std::condition_variable m_cellDecoded;
+		std::deque<LoadRequest> m_requests;
+		std::vector<DecodedCell> m_decoded;
+		size_t m_pendingDecodes = 0; //requests not yet in m_decoded
+		bool m_stopping = false;
+		std::thread m_loader; //last, started once everything else is constructed
+	};
+}
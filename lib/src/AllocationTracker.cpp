@@ -0,0 +1,42 @@
+#include "BulletECS/AllocationTracker.h"
+#include <atomic>
+
+namespace BulletECS
+{
+	namespace AllocationTracker
+	{
+		namespace
+		{
+			//plain thread_local integers, so counting inside operator new never allocates or takes a lock
+			thread_local uint64_t t_allocationCount = 0;
+			thread_local uint64_t t_allocatedBytes = 0;
+			std::atomic<bool> s_interposed{ false };
+		}
+
+		void recordAllocation(size_t size)
+		{
+			t_allocationCount++;
+			t_allocatedBytes += size;
+		}
+
+		void markInterposed()
+		{
+			s_interposed.store(true, std::memory_order_relaxed);
+		}
+
+		bool isInterposed()
+		{
+			return s_interposed.load(std::memory_order_relaxed);
+		}
+
+		uint64_t getAllocationCount()
+		{
+			return t_allocationCount;
+		}
+
+		uint64_t getAllocatedBytes()
+		{
+			return t_allocatedBytes;
+		}
+	}
+}
@@ -0,0 +1,265 @@
+#include "BulletECS/BulletAllocator.h"
+#include "BulletECS/AllocationTracker.h"
+#include <LinearMath/btAlignedAllocator.h>
+#include <atomic>
+#include <mutex>
+#include <cstdlib>
+#include <cassert>
+
+namespace BulletECS
+{
+	namespace
+	{
+		// Placed before every block handed to Bullet. 16 bytes, so the block keeps malloc's alignment
+		struct alignas(16) BlockHeader
+		{
+			BulletArena* owner;
+			uint32_t sizeClass;
+			uint32_t size;
+		};
+		static_assert(sizeof(BlockHeader) == 16, "BlockHeader must keep 16 byte alignment.");
+
+		thread_local BulletArena* t_boundArena = nullptr;
+
+		std::atomic<uint64_t> s_unboundAllocations{ 0 };
+		std::atomic<uint64_t> s_unboundFrees{ 0 };
+		std::atomic<uint64_t> s_unboundBytesInUse{ 0 };
+		std::atomic<uint64_t> s_unboundPeakBytesInUse{ 0 };
+
+		std::mutex s_installMutex;
+		std::atomic<bool> s_installed{ false };
+		bool s_bulletInUse = false; //a world allocated with Bullet's own allocator, guarded by s_installMutex
+
+		void* systemAllocate(size_t size)
+		{
+			BlockHeader* header = static_cast<BlockHeader*>(std::malloc(sizeof(BlockHeader) + size));
+			AllocationTracker::recordAllocation(sizeof(BlockHeader) + size);
+			if (!header)
+			{
+				return nullptr;
+			}
+			header->owner = nullptr;
+			header->sizeClass = 0;
+			header->size = static_cast<uint32_t>(size);
+
+			s_unboundAllocations.fetch_add(1, std::memory_order_relaxed);
+			uint64_t inUse = s_unboundBytesInUse.fetch_add(size, std::memory_order_relaxed) + size;
+			uint64_t peak = s_unboundPeakBytesInUse.load(std::memory_order_relaxed);
+			while (inUse > peak && !s_unboundPeakBytesInUse.compare_exchange_weak(peak, inUse, std::memory_order_relaxed)) {}
+			return header + 1;
+		}
+
+		void* hookAllocate(size_t size)
+		{
+			if (BulletArena* arena = t_boundArena)
+			{
+				return arena->allocate(size);
+			}
+			return systemAllocate(size);
+		}
+
+		void hookFree(void* block)
+		{
+			if (!block)
+			{
+				return;
+			}
+			BlockHeader* header = static_cast<BlockHeader*>(block) - 1;
+			if (header->owner)
+			{
+				header->owner->free(block);
+				return;
+			}
+			s_unboundFrees.fetch_add(1, std::memory_order_relaxed);
+			s_unboundBytesInUse.fetch_sub(header->size, std::memory_order_relaxed);
+			std::free(header);
+		}
+	}
+
+	BulletArena::BulletArena(size_t chunkSize)
+		: m_chunkSize(chunkSize)
+	{
+	}
+
+	BulletArena::~BulletArena()
+	{
+		assert(m_stats.bytesInUse == 0 && "BulletArena destroyed while Bullet still owns some of its blocks.");
+		if (m_stats.bytesInUse != 0)
+		{
+			return; //leaking the chunks is safer than leaving Bullet with dangling blocks
+		}
+		for (void* chunk : m_chunks)
+		{
+			std::free(chunk);
+		}
+	}
+
+	uint32_t BulletArena::sizeClassOf(size_t blockSize)
+	{
+		uint32_t sizeClass = 0;
+		while (sizeClass < SIZE_CLASS_COUNT && blockSizeOf(sizeClass) < blockSize)
+		{
+			sizeClass++;
+		}
+		return sizeClass < SIZE_CLASS_COUNT ? sizeClass : LARGE_BLOCK;
+	}
+
+	void* BulletArena::carveBlock(uint32_t sizeClass)
+	{
+		size_t blockSize = blockSizeOf(sizeClass);
+		if (blockSize >= m_chunkSize)
+		{
+			//big blocks get a chunk of their own, they are still reused through the free lists
+			char* chunk = static_cast<char*>(std::malloc(blockSize));
+			AllocationTracker::recordAllocation(blockSize);
+			if (!chunk)
+			{
+				return nullptr;
+			}
+			m_chunks.push_back(chunk);
+			m_stats.systemAllocations++;
+			m_stats.bytesReserved += blockSize;
+			return chunk;
+		}
+		if (m_chunkCursor + blockSize > m_chunkEnd)
+		{
+			//the tail of the previous chunk is lost, it is smaller than the block being carved
+			char* chunk = static_cast<char*>(std::malloc(m_chunkSize));
+			AllocationTracker::recordAllocation(m_chunkSize);
+			if (!chunk)
+			{
+				return nullptr;
+			}
+			m_chunks.push_back(chunk);
+			m_chunkCursor = chunk;
+			m_chunkEnd = chunk + m_chunkSize;
+			m_stats.systemAllocations++;
+			m_stats.bytesReserved += m_chunkSize;
+		}
+		void* block = m_chunkCursor;
+		m_chunkCursor += blockSize;
+		return block;
+	}
+
+	void* BulletArena::allocate(size_t size)
+	{
+		size_t blockSize = sizeof(BlockHeader) + size;
+		uint32_t sizeClass = sizeClassOf(blockSize);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		BlockHeader* header = nullptr;
+		if (sizeClass == LARGE_BLOCK)
+		{
+			header = static_cast<BlockHeader*>(std::malloc(blockSize));
+			AllocationTracker::recordAllocation(blockSize);
+			m_stats.systemAllocations++;
+			m_stats.bytesReserved += blockSize;
+		}
+		else if (FreeBlock* freeBlock = m_freeLists[sizeClass])
+		{
+			m_freeLists[sizeClass] = freeBlock->next;
+			header = reinterpret_cast<BlockHeader*>(freeBlock);
+		}
+		else
+		{
+			header = static_cast<BlockHeader*>(carveBlock(sizeClass));
+		}
+		if (!header)
+		{
+			return nullptr;
+		}
+
+		header->owner = this;
+		header->sizeClass = sizeClass;
+		header->size = static_cast<uint32_t>(size);
+		m_stats.allocations++;
+		m_stats.bytesInUse += size;
+		m_stats.peakBytesInUse = m_stats.bytesInUse > m_stats.peakBytesInUse ? m_stats.bytesInUse : m_stats.peakBytesInUse;
+		return header + 1;
+	}
+
+	void BulletArena::free(void* block)
+	{
+		BlockHeader* header = static_cast<BlockHeader*>(block) - 1;
+		assert(header->owner == this && "Block freed in the wrong BulletArena.");
+		const uint32_t sizeClass = header->sizeClass;
+		const uint32_t size = header->size;
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stats.frees++;
+		m_stats.bytesInUse -= size;
+		if (sizeClass == LARGE_BLOCK)
+		{
+			m_stats.bytesReserved -= sizeof(BlockHeader) + size;
+			std::free(header);
+			return;
+		}
+		//the free list link overwrites the header, it is rewritten when the block is reused
+		FreeBlock* freeBlock = reinterpret_cast<FreeBlock*>(header);
+		freeBlock->next = m_freeLists[sizeClass];
+		m_freeLists[sizeClass] = freeBlock;
+	}
+
+	BulletAllocationStats BulletArena::getStats() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_stats;
+	}
+
+	namespace BulletAllocator
+	{
+		bool install()
+		{
+			std::lock_guard<std::mutex> lock(s_installMutex);
+			if (s_installed.load(std::memory_order_relaxed))
+			{
+				return true;
+			}
+			assert(!s_bulletInUse && "Bullet allocator hooks installed after a world was created without them, call BulletAllocator::install() first.");
+			if (s_bulletInUse)
+			{
+				return false;
+			}
+			btAlignedAllocSetCustom(hookAllocate, hookFree);
+			s_installed.store(true, std::memory_order_release);
+			return true;
+		}
+
+		bool isInstalled()
+		{
+			return s_installed.load(std::memory_order_acquire);
+		}
+
+		void markBulletInUse()
+		{
+			std::lock_guard<std::mutex> lock(s_installMutex);
+			if (!s_installed.load(std::memory_order_relaxed))
+			{
+				s_bulletInUse = true;
+			}
+		}
+
+		ScopedArena::ScopedArena(BulletArena* arena)
+			: m_previous(t_boundArena)
+		{
+			t_boundArena = arena;
+		}
+
+		ScopedArena::~ScopedArena()
+		{
+			t_boundArena = m_previous;
+		}
+
+		BulletAllocationStats getUnboundStats()
+		{
+			BulletAllocationStats stats;
+			stats.allocations = s_unboundAllocations.load(std::memory_order_relaxed);
+			stats.frees = s_unboundFrees.load(std::memory_order_relaxed);
+			stats.systemAllocations = stats.allocations;
+			stats.bytesInUse = s_unboundBytesInUse.load(std::memory_order_relaxed);
+			stats.peakBytesInUse = s_unboundPeakBytesInUse.load(std::memory_order_relaxed);
+			stats.bytesReserved = stats.bytesInUse;
+			return stats;
+		}
+	}
+}
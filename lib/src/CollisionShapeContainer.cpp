@@ -1,132 +1,232 @@
 #include "BulletECS/Containers/CollisionShapeContainer.h"
-#include <sstream>
+#include "BulletECS/Trace.h"
+#include <algorithm>
+#include <iterator>
+#include <cassert>
 
 namespace BulletECS
 {
-	btBoxShape* CollisionShapeContainer::setBox(Entity entity, btVector3 halfExtents)
+	template <class Shape, class... Args>
+	const std::shared_ptr<btCollisionShape>& CollisionShapeContainer::acquireShared(const ShapeKey& key, Args&&... args)
 	{
-		std::ostringstream oss;
-		oss << "box:" << halfExtents.getX() << "," << halfExtents.getY() << "," << halfExtents.getZ();
-		std::string key = oss.str();
-
-		btBoxShape* ptr = nullptr;
-		if (m_uniqueCollisionShapes.find(key) == m_uniqueCollisionShapes.end())
+		auto it = m_uniqueCollisionShapes.find(key);
+		if (it == m_uniqueCollisionShapes.end())
 		{
-			std::shared_ptr<btBoxShape> sharedPtr = std::make_shared<btBoxShape>(halfExtents);
-			m_uniqueCollisionShapes[key] = sharedPtr;
-			ptr = sharedPtr.get();
+			it = m_uniqueCollisionShapes.emplace(key, std::make_shared<Shape>(std::forward<Args>(args)...)).first;
+			m_cacheMisses++;
 		}
 		else
 		{
-			ptr = dynamic_cast<btBoxShape*>(m_uniqueCollisionShapes[key].get());
+			m_cacheHits++;
 		}
-
-		m_entitiesWithShape[entity.ID] = m_uniqueCollisionShapes[key];
-		return ptr;
+		return it->second;
 	}
 
-	btCylinderShape* CollisionShapeContainer::setCylinder(Entity entity, btVector3 halfExtents)
+	template <class Shape, class... Args>
+	Shape* CollisionShapeContainer::setShared(Entity entity, const ShapeKey& key, Args&&... args)
 	{
-		std::ostringstream oss;
-		oss << "cyl:" << halfExtents.getX() << ',' << halfExtents.getY() << ',' << halfExtents.getZ();
-		std::string key = oss.str();
+		const std::shared_ptr<btCollisionShape>& shape = acquireShared<Shape>(key, std::forward<Args>(args)...);
+		assign(entity, shape);
+		return static_cast<Shape*>(shape.get()); //the key contains the shape type
+	}
 
-		btCylinderShape* ptr = nullptr;
-		if (m_uniqueCollisionShapes.find(key) == m_uniqueCollisionShapes.end())
-		{
-			std::shared_ptr<btCylinderShape> sharedPtr = std::make_shared<btCylinderShape>(halfExtents);
-			m_uniqueCollisionShapes[key] = sharedPtr;
-			ptr = sharedPtr.get();
-		}
-		else
+	void CollisionShapeContainer::assign(Entity entity, const std::shared_ptr<btCollisionShape>& shape)
+	{
+		std::shared_ptr<btCollisionShape>& slot = m_entityShapes[entity.ID];
+		if (!slot)
 		{
-			ptr = dynamic_cast<btCylinderShape*>(m_uniqueCollisionShapes[key].get());
+			m_entityCount++;
+			m_peakEntityCount = m_entityCount > m_peakEntityCount ? m_entityCount : m_peakEntityCount;
 		}
+		slot = shape;
+	}
+
+	btBoxShape* CollisionShapeContainer::setBox(Entity entity, btVector3 halfExtents)
+	{
+		BULLET_ECS_TRACE_SCOPE("CollisionShapeContainer::setBox");
+		ShapeKey key{ BOX_SHAPE_PROXYTYPE, { halfExtents.getX(), halfExtents.getY(), halfExtents.getZ() } };
+		return setShared<btBoxShape>(entity, key, halfExtents);
+	}
 
-		m_entitiesWithShape[entity.ID] = m_uniqueCollisionShapes[key];
-		return ptr;
+	btCylinderShape* CollisionShapeContainer::setCylinder(Entity entity, btVector3 halfExtents)
+	{
+		BULLET_ECS_TRACE_SCOPE("CollisionShapeContainer::setCylinder");
+		ShapeKey key{ CYLINDER_SHAPE_PROXYTYPE, { halfExtents.getX(), halfExtents.getY(), halfExtents.getZ() } };
+		return setShared<btCylinderShape>(entity, key, halfExtents);
 	}
 
 	btSphereShape* CollisionShapeContainer::setSphere(Entity entity, float radius)
 	{
-		std::ostringstream oss;
-		oss << "sph:" << radius;
-		std::string key = oss.str();
+		BULLET_ECS_TRACE_SCOPE("CollisionShapeContainer::setSphere");
+		ShapeKey key{ SPHERE_SHAPE_PROXYTYPE, { radius, 0.0f, 0.0f } };
+		return setShared<btSphereShape>(entity, key, radius);
+	}
+
+	btCapsuleShape* CollisionShapeContainer::setCapsule(Entity entity, float radius, float height)
+	{
+		BULLET_ECS_TRACE_SCOPE("CollisionShapeContainer::setCapsule");
+		ShapeKey key{ CAPSULE_SHAPE_PROXYTYPE, { radius, height, 0.0f } };
+		return setShared<btCapsuleShape>(entity, key, radius, height);
+	}
+
 
-		btSphereShape* ptr = nullptr;
-		if (m_uniqueCollisionShapes.find(key) == m_uniqueCollisionShapes.end())
+	const std::shared_ptr<btCollisionShape>& CollisionShapeContainer::acquire(const ColliderDesc& desc)
+	{
+		//same keys as the set functions, so shapes from descs and from direct calls are shared
+		const btVector3& size = desc.size;
+		switch (desc.type)
 		{
-			std::shared_ptr<btSphereShape> sharedPtr = std::make_shared<btSphereShape>(radius);
-			m_uniqueCollisionShapes[key] = sharedPtr;
-			ptr = sharedPtr.get();
+		case ColliderType::Sphere:
+			return acquireShared<btSphereShape>(ShapeKey{ SPHERE_SHAPE_PROXYTYPE, { size.getX(), 0.0f, 0.0f } }, size.getX());
+		case ColliderType::Cylinder:
+			return acquireShared<btCylinderShape>(ShapeKey{ CYLINDER_SHAPE_PROXYTYPE, { size.getX(), size.getY(), size.getZ() } }, size);
+		case ColliderType::Capsule:
+			return acquireShared<btCapsuleShape>(ShapeKey{ CAPSULE_SHAPE_PROXYTYPE, { size.getX(), size.getY(), 0.0f } }, size.getX(), size.getY());
+		default:
+			assert(desc.type == ColliderType::Box && "Unknown ColliderType.");
+			return acquireShared<btBoxShape>(ShapeKey{ BOX_SHAPE_PROXYTYPE, { size.getX(), size.getY(), size.getZ() } }, size);
 		}
-		else
+	}
+
+	btCollisionShape* CollisionShapeContainer::setFromExistentEntity(Entity entity, Entity existentEntityWithCollider)
+	{
+		const std::shared_ptr<btCollisionShape>& shape = m_entityShapes[existentEntityWithCollider.ID];
+		if (!shape)
 		{
-			ptr = dynamic_cast<btSphereShape*>(m_uniqueCollisionShapes[key].get());
+			return nullptr;
 		}
-
-		m_entitiesWithShape[entity.ID] = m_uniqueCollisionShapes[key];
-		return ptr;
+		assign(entity, shape);
+		return shape.get();
 	}
 
-	btCapsuleShape* CollisionShapeContainer::setCapsule(Entity entity, float radius, float height)
+	std::shared_ptr<const HeightfieldData> CollisionShapeContainer::acquireHeightfield(const std::string& path)
 	{
-		std::ostringstream oss;
-		oss << "cap:" << radius << ',' << height;
-		std::string key = oss.str();
+		std::weak_ptr<const HeightfieldData>& entry = m_heightfields[path];
+		std::shared_ptr<const HeightfieldData> data = entry.lock();
+		if (!data)
+		{
+			auto opened = std::make_shared<HeightfieldData>();
+			if (!opened->open(path))
+			{
+				m_heightfields.erase(path);
+				return nullptr;
+			}
+			data = opened;
+			entry = data;
+		}
+		return data;
+	}
 
-		btCapsuleShape* ptr = nullptr;
-		if (m_uniqueCollisionShapes.find(key) == m_uniqueCollisionShapes.end())
+	void CollisionShapeContainer::pruneHeightfields()
+	{
+		for (auto it = m_heightfieldTiles.begin(); it != m_heightfieldTiles.end();)
 		{
-			std::shared_ptr<btCapsuleShape> sharedPtr = std::make_shared<btCapsuleShape>(radius, height);
-			m_uniqueCollisionShapes[key] = sharedPtr;
-			ptr = sharedPtr.get();
+			it = it->second.expired() ? m_heightfieldTiles.erase(it) : std::next(it);
 		}
-		else
+		for (auto it = m_heightfields.begin(); it != m_heightfields.end();)
 		{
-			ptr = dynamic_cast<btCapsuleShape*>(m_uniqueCollisionShapes[key].get());
+			it = it->second.expired() ? m_heightfields.erase(it) : std::next(it);
 		}
-
-		m_entitiesWithShape[entity.ID] = m_uniqueCollisionShapes[key];
-		return ptr;
 	}
 
-
-	btCollisionShape* CollisionShapeContainer::setFromExistentEntity(Entity entity, Entity existentEntityWithCollider)
+	HeightfieldTileShape* CollisionShapeContainer::setHeightfieldTile(Entity entity, const std::string& path, uint32_t tileX, uint32_t tileZ)
 	{
-		auto it = m_entitiesWithShape.find(existentEntityWithCollider.ID);
-		if (it == m_entitiesWithShape.end())
+		BULLET_ECS_TRACE_SCOPE("CollisionShapeContainer::setHeightfieldTile");
+		//streaming releases tiles without telling the container, a full sweep every time the map doubles keeps the cost amortized constant
+		if (m_heightfieldTiles.size() >= m_heightfieldPruneSize)
+		{
+			pruneHeightfields();
+			m_heightfieldPruneSize = std::max<size_t>(64, m_heightfieldTiles.size() * 2);
+		}
+		std::shared_ptr<const HeightfieldData> data = acquireHeightfield(path);
+		if (!data || tileX >= data->getTilesX() || tileZ >= data->getTilesZ())
 		{
 			return nullptr;
 		}
-		m_entitiesWithShape[entity.ID] = it->second;
-		return it->second.get();
+		std::weak_ptr<HeightfieldTileShape>& entry = m_heightfieldTiles[std::make_tuple(data.get(), tileX, tileZ)];
+		std::shared_ptr<HeightfieldTileShape> shape = entry.lock();
+		if (!shape)
+		{
+			shape = std::make_shared<HeightfieldTileShape>(data, tileX, tileZ);
+			entry = shape;
+			m_cacheMisses++;
+		}
+		else
+		{
+			m_cacheHits++;
+		}
+		assign(entity, shape);
+		return shape.get();
 	}
 
+	size_t CollisionShapeContainer::getHeightfieldTileCount() const
+	{
+		size_t count = 0;
+		for (const auto& [key, tile] : m_heightfieldTiles)
+		{
+			count += tile.expired() ? 0 : 1;
+		}
+		return count;
+	}
 
 	void CollisionShapeContainer::remove(Entity entity)
 	{
-		m_entitiesWithShape.erase(entity.ID);
+		std::shared_ptr<btCollisionShape>& slot = m_entityShapes[entity.ID];
+		if (slot)
+		{
+			slot.reset();
+			m_entityCount--;
+		}
 	}
 
 
 	btCollisionShape* CollisionShapeContainer::get(Entity entity)
 	{
-		auto it = m_entitiesWithShape.find(entity.ID);
-		if (it == m_entitiesWithShape.end())
-		{
-			return nullptr;
-		}
-		return it->second.get();
+		return m_entityShapes[entity.ID].get();
 	}
 
 	const btCollisionShape* CollisionShapeContainer::get(Entity entity) const
 	{
-		auto it = m_entitiesWithShape.find(entity.ID);
-		if (it == m_entitiesWithShape.end())
+		return m_entityShapes[entity.ID].get();
+	}
+
+	MemoryUsage CollisionShapeContainer::getTableMemoryUsage() const
+	{
+		MemoryUsage usage;
+		usage.name = "CollisionShapeContainer tables";
+		usage.count = m_entityCount;
+		usage.peakCount = m_peakEntityCount;
+		const size_t uniqueTableBytes = MemoryReport::estimateHashTableBytes(m_uniqueCollisionShapes);
+		usage.usedBytes = uniqueTableBytes + m_entityCount * sizeof(std::shared_ptr<btCollisionShape>);
+		usage.peakUsedBytes = uniqueTableBytes + m_peakEntityCount * sizeof(std::shared_ptr<btCollisionShape>);
+		usage.reservedBytes = uniqueTableBytes + m_entityShapes.capacity() * sizeof(std::shared_ptr<btCollisionShape>);
+		return usage;
+	}
+
+	MemoryUsage CollisionShapeContainer::getShapeMemoryUsage() const
+	{
+		//shapes other than heightfield tiles are never released, so the current size is also the peak
+		MemoryUsage usage;
+		usage.name = "Collision shapes";
+		usage.count = usage.peakCount = m_uniqueCollisionShapes.size();
+		for (const auto& [key, shape] : m_uniqueCollisionShapes)
 		{
-			return nullptr;
+			size_t shapeBytes = sizeof(btCollisionShape);
+			switch (shape->getShapeType())
+			{
+			case BOX_SHAPE_PROXYTYPE: shapeBytes = sizeof(btBoxShape); break;
+			case SPHERE_SHAPE_PROXYTYPE: shapeBytes = sizeof(btSphereShape); break;
+			case CYLINDER_SHAPE_PROXYTYPE: shapeBytes = sizeof(btCylinderShape); break;
+			case CAPSULE_SHAPE_PROXYTYPE: shapeBytes = sizeof(btCapsuleShape); break;
+			default: break;
+			}
+			usage.usedBytes += shapeBytes + 2 * sizeof(long); //make_shared puts the reference counts next to the shape
 		}
-		return it->second.get();
+		//heightfield tiles point into their mapped file, only the shapes are counted
+		const size_t tileCount = getHeightfieldTileCount();
+		usage.count = usage.peakCount = usage.count + tileCount;
+		usage.usedBytes += tileCount * (sizeof(HeightfieldTileShape) + 2 * sizeof(long));
+		usage.peakUsedBytes = usage.reservedBytes = usage.usedBytes;
+		return usage;
 	}
-}
\ No newline at end of file
+}
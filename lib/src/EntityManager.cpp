@@ -1,24 +1,53 @@
 #include "BulletECS/EntityManager.h"
 #include <cassert>
-#include <set>
 namespace BulletECS
 {
 	Entity EntityManager::createEntity()
 	{
-		if (m_destroyedAvailableEntities.empty())
+		//a hole below the highest entity if there is one, otherwise the ID right after it
+		entity_id_t id = static_cast<entity_id_t>(m_alive.findNextClear(1, m_highestEntity));
+		assert(id <= m_maxEntities && "Too many entities created.");
+		m_alive.set(id);
+		m_highestEntity = id > m_highestEntity ? id : m_highestEntity;
+		m_liveCount++;
+		m_peakLiveCount = m_liveCount > m_peakLiveCount ? m_liveCount : m_peakLiveCount;
+		return Entity{ id, m_versions[id] }; //versions start at 1, version 0 means not initialized
+	}
+
+	void EntityManager::destroyEntity(Entity entity)
+	{
+		//version 0 handles (e.g. from pool iteration) are not versioned, only their ID is checked
+		assert(entity.ID != NULL_ENTITY && entity.ID <= m_maxEntities && m_alive[entity.ID] && "Entity destroyed twice.");
+		assert((entity.version == 0 || entity.version == m_versions[entity.ID]) && "Stale entity handle, its ID was destroyed and reused.");
+		m_alive.reset(entity.ID);
+		//the next entity with this ID gets a new version, skipping 0 when it wraps around
+		entity_version_t& version = m_versions[entity.ID];
+		version = static_cast<entity_version_t>(version + 1) != 0 ? static_cast<entity_version_t>(version + 1) : 1;
+		m_liveCount--;
+		if (entity.ID == m_highestEntity)
 		{
-			assert(m_nextEntityID <= MAX_ENTITIES && "Too many entities created.");
-			return Entity{ m_nextEntityID++, 1 }; //version = 1 because it's the 1st entity created with that ID, version 0 means not initialized
+			size_t previous = m_alive.findPrevious(entity.ID);
+			m_highestEntity = previous == EntityBitset::NO_BIT ? NULL_ENTITY : static_cast<entity_id_t>(previous);
 		}
+	}
 
-		//get a destroyed entity and increment its version to make a new one
-		Entity entity = m_destroyedAvailableEntities.front();
-		m_destroyedAvailableEntities.pop();
-		entity.version++;
-		return entity;
+	Entity EntityManager::relocate(Entity entity, entity_id_t newID)
+	{
+		assert(newID != NULL_ENTITY && newID <= m_maxEntities && !m_alive[newID] && "Entities can only be relocated to a free ID.");
+		destroyEntity(entity);
+		m_alive.set(newID);
+		m_highestEntity = newID > m_highestEntity ? newID : m_highestEntity;
+		m_liveCount++;
+		return Entity{ newID, m_versions[newID] };
 	}
-	void BulletECS::EntityManager::destroyEntity(Entity entity)
+
+	MemoryUsage EntityManager::getMemoryUsage() const
 	{
-		m_destroyedAvailableEntities.push(entity);
+		MemoryUsage usage;
+		usage.name = "EntityManager versions";
+		usage.count = m_liveCount;
+		usage.peakCount = m_peakLiveCount;
+		usage.usedBytes = usage.peakUsedBytes = usage.reservedBytes = m_versions.capacity() * sizeof(entity_version_t) + m_alive.getReservedBytes();
+		return usage;
 	}
-}
\ No newline at end of file
+}
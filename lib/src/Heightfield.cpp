@@ -0,0 +1,136 @@
+#include "BulletECS/Heightfield.h"
+#include "BulletECS/Trace.h"
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <climits>
+#include <cassert>
+
+namespace BulletECS
+{
+	static inline uint64_t alignSection(uint64_t offset)
+	{
+		return (offset + Heightfield::SECTION_ALIGNMENT - 1) / Heightfield::SECTION_ALIGNMENT * Heightfield::SECTION_ALIGNMENT;
+	}
+
+	//in 64 bits, tileQuads comes from the file and tileQuads + 1 can wrap in 32
+	static inline uint64_t tileSampleCount(uint32_t tileQuads)
+	{
+		return (uint64_t(tileQuads) + 1) * (uint64_t(tileQuads) + 1);
+	}
+
+	bool Heightfield::write(const std::string& path, const float* heights, uint32_t width, uint32_t length, uint32_t tileQuads, float spacing)
+	{
+		BULLET_ECS_TRACE_SCOPE("Heightfield::write");
+		if (tileQuads == 0 || width < 2 || length < 2 || (width - 1) % tileQuads != 0 || (length - 1) % tileQuads != 0 || !(spacing > 0.0f))
+		{
+			return false;
+		}
+		Header header{};
+		std::memcpy(header.magic, MAGIC, sizeof(header.magic));
+		header.version = VERSION;
+		header.tilesX = (width - 1) / tileQuads;
+		header.tilesZ = (length - 1) / tileQuads;
+		header.tileQuads = tileQuads;
+		header.spacing = spacing;
+		const size_t tileCount = size_t(header.tilesX) * header.tilesZ;
+		header.boundsOffset = alignSection(sizeof(Header));
+		header.heightsOffset = alignSection(header.boundsOffset + tileCount * sizeof(TileBounds));
+
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		if (!file)
+		{
+			return false;
+		}
+		std::vector<TileBounds> bounds(tileCount);
+		std::vector<float> tile(tileSampleCount(tileQuads));
+		static const char zeros[SECTION_ALIGNMENT] = {};
+		file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+		file.write(zeros, static_cast<std::streamsize>(header.boundsOffset - sizeof(Header)));
+		//the bounds are rewritten once the tiles are known
+		file.write(reinterpret_cast<const char*>(bounds.data()), static_cast<std::streamsize>(bounds.size() * sizeof(TileBounds)));
+		file.write(zeros, static_cast<std::streamsize>(header.heightsOffset - header.boundsOffset - bounds.size() * sizeof(TileBounds)));
+		for (uint32_t tileZ = 0; tileZ < header.tilesZ; tileZ++)
+		{
+			for (uint32_t tileX = 0; tileX < header.tilesX; tileX++)
+			{
+				TileBounds& tileBounds = bounds[size_t(tileZ) * header.tilesX + tileX];
+				tileBounds.minHeight = tileBounds.maxHeight = heights[size_t(tileZ) * tileQuads * width + size_t(tileX) * tileQuads];
+				for (uint32_t z = 0; z <= tileQuads; z++)
+				{
+					const float* row = heights + (size_t(tileZ) * tileQuads + z) * width + size_t(tileX) * tileQuads;
+					float* tileRow = tile.data() + size_t(z) * (tileQuads + 1);
+					std::copy(row, row + tileQuads + 1, tileRow);
+					const auto [minIt, maxIt] = std::minmax_element(tileRow, tileRow + tileQuads + 1);
+					tileBounds.minHeight = std::min(tileBounds.minHeight, *minIt);
+					tileBounds.maxHeight = std::max(tileBounds.maxHeight, *maxIt);
+				}
+				file.write(reinterpret_cast<const char*>(tile.data()), static_cast<std::streamsize>(tile.size() * sizeof(float)));
+			}
+		}
+		file.seekp(static_cast<std::streamoff>(header.boundsOffset));
+		file.write(reinterpret_cast<const char*>(bounds.data()), static_cast<std::streamsize>(bounds.size() * sizeof(TileBounds)));
+		return static_cast<bool>(file);
+	}
+
+	bool HeightfieldData::open(const std::string& path)
+	{
+		BULLET_ECS_TRACE_SCOPE("HeightfieldData::open");
+		m_header = Heightfield::Header{};
+		if (!m_file.open(path) || m_file.size() < sizeof(Heightfield::Header))
+		{
+			m_file.close();
+			return false;
+		}
+		Heightfield::Header header;
+		std::memcpy(&header, m_file.data(), sizeof(header));
+		const uint64_t tileCount = uint64_t(header.tilesX) * header.tilesZ;
+		//btHeightfieldTerrainShape takes the samples per side as an int, which also keeps tileBytes from overflowing
+		const bool validTileQuads = header.tileQuads > 0 && uint64_t(header.tileQuads) + 1 <= uint64_t(INT_MAX);
+		const uint64_t tileBytes = validTileQuads ? tileSampleCount(header.tileQuads) * sizeof(float) : 0;
+		const bool valid = std::memcmp(header.magic, Heightfield::MAGIC, sizeof(header.magic)) == 0 && header.version == Heightfield::VERSION &&
+			tileCount > 0 && validTileQuads && header.spacing > 0.0f &&
+			header.boundsOffset % Heightfield::SECTION_ALIGNMENT == 0 && header.heightsOffset % Heightfield::SECTION_ALIGNMENT == 0 &&
+			header.boundsOffset <= m_file.size() && tileCount <= (m_file.size() - header.boundsOffset) / sizeof(Heightfield::TileBounds) &&
+			header.heightsOffset <= m_file.size() && tileCount <= (m_file.size() - header.heightsOffset) / tileBytes;
+		if (!valid)
+		{
+			m_file.close();
+			return false;
+		}
+		m_header = header;
+		return true;
+	}
+
+	const float* HeightfieldData::getTileHeights(uint32_t tileX, uint32_t tileZ) const
+	{
+		assert(tileX < m_header.tilesX && tileZ < m_header.tilesZ && "Heightfield tile out of range.");
+		const size_t tile = size_t(tileZ) * m_header.tilesX + tileX;
+		return reinterpret_cast<const float*>(m_file.data() + m_header.heightsOffset) + tile * tileSampleCount(m_header.tileQuads);
+	}
+
+	const Heightfield::TileBounds& HeightfieldData::getTileBounds(uint32_t tileX, uint32_t tileZ) const
+	{
+		assert(tileX < m_header.tilesX && tileZ < m_header.tilesZ && "Heightfield tile out of range.");
+		const size_t tile = size_t(tileZ) * m_header.tilesX + tileX;
+		return reinterpret_cast<const Heightfield::TileBounds*>(m_file.data() + m_header.boundsOffset)[tile];
+	}
+
+	btVector3 HeightfieldData::getTileCenter(uint32_t tileX, uint32_t tileZ) const
+	{
+		const Heightfield::TileBounds& bounds = getTileBounds(tileX, tileZ);
+		const float tileSize = float(m_header.tileQuads) * m_header.spacing;
+		return btVector3((float(tileX) + 0.5f) * tileSize, (bounds.minHeight + bounds.maxHeight) * 0.5f, (float(tileZ) + 0.5f) * tileSize);
+	}
+
+	HeightfieldTileShape::HeightfieldTileShape(std::shared_ptr<const HeightfieldData> data, uint32_t tileX, uint32_t tileZ)
+		: btHeightfieldTerrainShape(static_cast<int>(data->getTileQuads() + 1), static_cast<int>(data->getTileQuads() + 1), data->getTileHeights(tileX, tileZ),
+			btScalar(1), data->getTileBounds(tileX, tileZ).minHeight, data->getTileBounds(tileX, tileZ).maxHeight, 1, PHY_FLOAT, false),
+		  m_data(std::move(data)),
+		  m_tileX(tileX),
+		  m_tileZ(tileZ)
+	{
+		setLocalScaling(btVector3(m_data->getSpacing(), 1.0f, m_data->getSpacing()));
+	}
+}
@@ -0,0 +1,60 @@
+#include "BulletECS/MemoryReport.h"
+#include <iomanip>
+
+namespace BulletECS
+{
+	size_t MemoryReport::getTotalUsedBytes() const
+	{
+		size_t total = static_cast<size_t>(bullet.bytesInUse);
+		for (const MemoryUsage& section : sections)
+		{
+			total += section.usedBytes;
+		}
+		return total;
+	}
+
+	size_t MemoryReport::getTotalReservedBytes() const
+	{
+		size_t total = static_cast<size_t>(bullet.bytesReserved);
+		for (const MemoryUsage& section : sections)
+		{
+			total += section.reservedBytes;
+		}
+		return total;
+	}
+
+	const MemoryUsage* MemoryReport::find(const std::string& name) const
+	{
+		for (const MemoryUsage& section : sections)
+		{
+			if (section.name == name)
+			{
+				return &section;
+			}
+		}
+		return nullptr;
+	}
+
+	void MemoryReport::print(std::ostream& out) const
+	{
+		const auto kilobytes = [](size_t bytes) { return bytes / 1024.0; };
+		const std::ios::fmtflags flags = out.flags();
+		const std::streamsize precision = out.precision();
+		out << std::fixed << std::setprecision(1);
+		out << std::left << std::setw(28) << "Section" << std::right << std::setw(10) << "Count" << std::setw(10) << "Peak"
+			<< std::setw(14) << "Used KB" << std::setw(14) << "Peak KB" << std::setw(14) << "Reserved KB" << "\n";
+		for (const MemoryUsage& section : sections)
+		{
+			out << std::left << std::setw(28) << section.name << std::right << std::setw(10) << section.count << std::setw(10) << section.peakCount
+				<< std::setw(14) << kilobytes(section.usedBytes) << std::setw(14) << kilobytes(section.peakUsedBytes)
+				<< std::setw(14) << kilobytes(section.reservedBytes) << "\n";
+		}
+		out << std::left << std::setw(28) << (bulletStatsArePerWorld ? "Bullet (world arena)" : "Bullet (shared, no arena)") << std::right
+			<< std::setw(10) << (bullet.allocations - bullet.frees) << std::setw(10) << "-"
+			<< std::setw(14) << kilobytes(static_cast<size_t>(bullet.bytesInUse)) << std::setw(14) << kilobytes(static_cast<size_t>(bullet.peakBytesInUse))
+			<< std::setw(14) << kilobytes(static_cast<size_t>(bullet.bytesReserved)) << "\n";
+		out << "Total used " << kilobytes(getTotalUsedBytes()) << " KB, reserved " << kilobytes(getTotalReservedBytes()) << " KB\n";
+		out.flags(flags);
+		out.precision(precision);
+	}
+}
@@ -1,15 +1,140 @@
 #include "BulletECS/PhysicsWorld.h"
+#include "BulletECS/UniformGridBroadphase.h"
+#include "BulletECS/ThreadPool.h"
+#include "BulletECS/Trace.h"
+#include <BulletCollision/CollisionDispatch/btSimulationIslandManager.h>
+#include <chrono>
+#include <utility>
+#include <algorithm>
 #include <cassert>
 
 namespace BulletECS
 {
+	static PhysicsWorldConfig configWithGravity(btVector3 gravity)
+	{
+		PhysicsWorldConfig config;
+		config.gravity = gravity;
+		return config;
+	}
+
+	//multiple of 64 so chunks of entity IDs never share an EntityBitset word
+	static constexpr size_t BULK_GRAIN_SIZE = 1024;
+
+	template <class Function>
+	static void runBulkChunks(ThreadPool* threadPool, size_t count, const Function& function)
+	{
+		if (!threadPool || count <= BULK_GRAIN_SIZE)
+		{
+			function(size_t(0), count);
+			return;
+		}
+		threadPool->parallelFor(count, function, BULK_GRAIN_SIZE);
+	}
+
+	//spreads the low 10 bits so there are two zero bits between each of them
+	static inline uint32_t spreadBits10(uint32_t x)
+	{
+		x &= 0x3FF;
+		x = (x | (x << 16)) & 0x030000FF;
+		x = (x | (x << 8)) & 0x0300F00F;
+		x = (x | (x << 4)) & 0x030C30C3;
+		x = (x | (x << 2)) & 0x09249249;
+		return x;
+	}
+
+	//30 bit Z-order code of a point inside [min, min + 1024 / scale]
+	static inline uint32_t mortonCode(const btVector3& point, const btVector3& min, const btVector3& scale)
+	{
+		auto cell = [](btScalar value) { return static_cast<uint32_t>(std::min(std::max(value, btScalar(0)), btScalar(1023))); };
+		const btVector3 local = (point - min) * scale;
+		return spreadBits10(cell(local.x())) | (spreadBits10(cell(local.y())) << 1) | (spreadBits10(cell(local.z())) << 2);
+	}
+
+	static inline bool isTrigger(const btBroadphaseProxy* proxy)
+	{
+		const btCollisionObject* object = static_cast<const btCollisionObject*>(proxy->m_clientObject);
+		return object->getInternalType() == btCollisionObject::CO_GHOST_OBJECT && dynamic_cast<const TriggerGhostObject*>(object);
+	}
+
+	//trigger pairs only exist to keep the ghosts' overlap caches, skipping them here saves a narrowphase test and a manifold per overlap
+	static void triggerNearCallback(btBroadphasePair& pair, btCollisionDispatcher& dispatcher, const btDispatcherInfo& dispatchInfo)
+	{
+		if (isTrigger(pair.m_pProxy0) || isTrigger(pair.m_pProxy1))
+		{
+			return;
+		}
+		btCollisionDispatcher::defaultNearCallback(pair, dispatcher, dispatchInfo);
+	}
+
+	static std::unique_ptr<btBroadphaseInterface> createBroadphase(const PhysicsWorldConfig& config)
+	{
+		//one proxy per rigidBody plus one for the NULL_ENTITY slot
+		const size_t maxProxies = static_cast<size_t>(config.maxEntities) + 1;
+		switch (config.broadphase)
+		{
+		case BroadphaseType::AxisSweep3:
+			assert(maxProxies < 32767 && "AxisSweep3 supports at most 32766 proxies, use AxisSweep3_32Bit.");
+			return std::make_unique<btAxisSweep3>(config.worldAabbMin, config.worldAabbMax, static_cast<unsigned short>(maxProxies));
+		case BroadphaseType::AxisSweep3_32Bit:
+			return std::make_unique<bt32BitAxisSweep3>(config.worldAabbMin, config.worldAabbMax, static_cast<unsigned int>(maxProxies));
+		case BroadphaseType::UniformGrid:
+			return std::make_unique<UniformGridBroadphase>(config.worldAabbMin, config.worldAabbMax, config.gridCellSize, static_cast<int>(maxProxies));
+		case BroadphaseType::Dbvt:
+		default:
+			return std::make_unique<btDbvtBroadphase>();
+		}
+	}
+
 	PhysicsWorld::PhysicsWorld(btVector3 gravity)
+		: PhysicsWorld(configWithGravity(gravity))
 	{
-		m_collisionConfiguration = std::make_unique<btDefaultCollisionConfiguration>();
+	}
+
+	PhysicsWorld::PhysicsWorld(const PhysicsWorldConfig& config)
+		: m_entityManager(config.maxEntities),
+		  m_rigidBodyPool(config.maxEntities),
+		  m_motionStatePool(config.maxEntities),
+		  m_collisionShapeContainer(config.maxEntities),
+		  m_tagPool(config.maxEntities),
+		  m_tagTable(config.maxEntities),
+		  m_activeRigidBodies(config.maxEntities + 1),
+		  m_dynamicRigidBodies(config.maxEntities + 1),
+		  m_collisionLayerPool(config.maxEntities),
+		  m_pointToPointJointPool(config.maxJoints),
+		  m_hingeJointPool(config.maxJoints),
+		  m_sliderJointPool(config.maxJoints),
+		  m_generic6DofJointPool(config.maxJoints),
+		  m_jointLinks(config.maxEntities + 1),
+		  m_triggerPool(config.maxEntities),
+		  m_simulationLodPool(config.maxEntities),
+		  m_lodSettings(config.simulationLod),
+		  m_stepStatsHistory(config.stepStatsHistorySize),
+		  m_assertNoSteadyStateAllocations(config.assertNoSteadyStateAllocations),
+		  m_steadyStateWarmupSteps(config.steadyStateWarmupSteps)
+	{
+		//the hooks only replace Bullet's allocator when an arena is asked for, install refuses once a world runs without them
+		if (config.useArenaAllocator && BulletAllocator::install())
+		{
+			m_arena = std::make_unique<BulletArena>();
+		}
+		BulletAllocator::markBulletInUse();
+		BulletAllocator::ScopedArena arenaScope(m_arena.get());
+
+		//Bullet falls back to the heap when these pools are full, so they are sized for the expected load up front
+		btDefaultCollisionConstructionInfo constructionInfo;
+		constructionInfo.m_defaultMaxPersistentManifoldPoolSize = static_cast<int>(config.expectedEntities) * config.manifoldsPerEntity;
+		constructionInfo.m_defaultMaxCollisionAlgorithmPoolSize = static_cast<int>(config.expectedEntities) * config.collisionAlgorithmsPerEntity;
+
+		m_collisionConfiguration = std::make_unique<btDefaultCollisionConfiguration>(constructionInfo);
 		m_dispatcher = std::make_unique<btCollisionDispatcher>(m_collisionConfiguration.get());
-		m_broadphase = std::make_unique<btDbvtBroadphase>();
+		m_broadphase = createBroadphase(config);
 		m_solver = std::make_unique<btSequentialImpulseConstraintSolver>();
 		m_dynamicsWorld = std::make_unique<btDiscreteDynamicsWorld>(m_dispatcher.get(), m_broadphase.get(), m_solver.get(), m_collisionConfiguration.get());
+		m_dynamicsWorld->setGravity(config.gravity);
+		installCollisionFilter();
+		installTriggerCallbacks();
+		StepProfiler::install();
+		m_lastStepEndAllocations = AllocationTracker::getAllocationCount();
 	}
 
 	PhysicsWorld::PhysicsWorld(
@@ -17,18 +142,61 @@ namespace BulletECS
 		std::unique_ptr<btDispatcher> dispatcher,
 		std::unique_ptr<btBroadphaseInterface> broadphase,
 		std::unique_ptr<btConstraintSolver> solver,
-		std::unique_ptr<btDynamicsWorld> dynamicsWorld)
+		std::unique_ptr<btDynamicsWorld> dynamicsWorld,
+		bool useArenaAllocator)
 		: m_collisionConfiguration(std::move(collisionConfiguration)),
 		  m_dispatcher(std::move(dispatcher)),
 		  m_broadphase(std::move(broadphase)),
 		  m_solver(std::move(solver)),
 		  m_dynamicsWorld(std::move(dynamicsWorld))
 	{
+		//the managers already exist, so the hooks can only be used if they were installed before them
+		assert((!useArenaAllocator || BulletAllocator::isInstalled()) && "Call BulletAllocator::install() before creating the managers of a world with an arena.");
+		if (useArenaAllocator && BulletAllocator::isInstalled())
+		{
+			m_arena = std::make_unique<BulletArena>();
+		}
+		BulletAllocator::markBulletInUse();
+		installCollisionFilter();
+		installTriggerCallbacks();
+		StepProfiler::install();
+		m_lastStepEndAllocations = AllocationTracker::getAllocationCount();
+	}
 
+	void PhysicsWorld::installCollisionFilter()
+	{
+		//pairs rejected here are never added to the pair cache, so no manifold is ever allocated for them
+		m_dynamicsWorld->getPairCache()->setOverlapFilterCallback(&m_collisionLayerFilter);
+	}
+
+	void PhysicsWorld::installTriggerCallbacks()
+	{
+		//forwards the pair cache changes to the ghosts, without it their overlap caches stay empty
+		m_dynamicsWorld->getPairCache()->setInternalGhostPairCallback(&m_ghostPairCallback);
+		//a user provided near callback is kept, then trigger pairs also go through the narrowphase
+		auto* collisionDispatcher = dynamic_cast<btCollisionDispatcher*>(m_dispatcher.get());
+		if (collisionDispatcher && collisionDispatcher->getNearCallback() == &btCollisionDispatcher::defaultNearCallback)
+		{
+			collisionDispatcher->setNearCallback(&triggerNearCallback);
+		}
 	}
 
 	PhysicsWorld::~PhysicsWorld()
 	{
+		BulletAllocator::ScopedArena arenaScope(m_arena.get());
+		//btTypedConstraint's destructor leaves its bodies' constraint refs, which ~btRigidBody asserts are empty,
+		//and the joint pools are destroyed before the rigidBody pool. removeJoint clears both refs through the dynamics world
+		auto removeAll = [this](auto& pool, JointType type)
+		{
+			for (Entity entity : pool)
+			{
+				removeJoint(entity, type);
+			}
+		};
+		removeAll(m_pointToPointJointPool, JointType::PointToPoint);
+		removeAll(m_hingeJointPool, JointType::Hinge);
+		removeAll(m_sliderJointPool, JointType::Slider);
+		removeAll(m_generic6DofJointPool, JointType::Generic6Dof);
 		m_dynamicsWorld = nullptr; //delete dynamics wolrd before everything else
 		//TODO: maybe force the deletion order following the bullet helloworld example
 	}
@@ -36,6 +204,56 @@ namespace BulletECS
 
 
 
+	BulletAllocationStats PhysicsWorld::getBulletAllocationStats() const
+	{
+		return m_arena ? m_arena->getStats() : BulletAllocator::getUnboundStats();
+	}
+
+	MemoryReport PhysicsWorld::memoryReport() const
+	{
+		MemoryReport report;
+		report.sections.push_back(m_rigidBodyPool.getMemoryUsage("RigidBody pool"));
+		report.sections.push_back(m_motionStatePool.getMemoryUsage("MotionState pool"));
+		report.sections.push_back(m_tagPool.getMemoryUsage("Tag pool"));
+		report.sections.push_back(m_collisionLayerPool.getMemoryUsage("CollisionLayer pool"));
+		report.sections.push_back(m_pointToPointJointPool.getMemoryUsage("PointToPoint joint pool"));
+		report.sections.push_back(m_hingeJointPool.getMemoryUsage("Hinge joint pool"));
+		report.sections.push_back(m_sliderJointPool.getMemoryUsage("Slider joint pool"));
+		report.sections.push_back(m_generic6DofJointPool.getMemoryUsage("Generic6Dof joint pool"));
+		report.sections.push_back(m_jointLinks.getMemoryUsage());
+		report.sections.push_back(m_triggerPool.getMemoryUsage("Trigger pool"));
+		report.sections.push_back(m_simulationLodPool.getMemoryUsage("SimulationLod pool"));
+		report.sections.push_back(m_tagTable.getMemoryUsage());
+		report.sections.push_back(m_collisionShapeContainer.getTableMemoryUsage());
+		report.sections.push_back(m_collisionShapeContainer.getShapeMemoryUsage());
+		report.sections.push_back(m_entityManager.getMemoryUsage());
+
+		MemoryUsage activeBits;
+		activeBits.name = "Active and dynamic rigidBodies masks";
+		activeBits.count = activeBits.peakCount = m_activeRigidBodies.size() + m_dynamicRigidBodies.size();
+		activeBits.usedBytes = activeBits.peakUsedBytes = activeBits.reservedBytes = m_activeRigidBodies.getReservedBytes() + m_dynamicRigidBodies.getReservedBytes();
+		report.sections.push_back(activeBits);
+
+		MemoryUsage triggerEvents;
+		triggerEvents.name = "Trigger event buffers";
+		triggerEvents.count = triggerEvents.peakCount = m_triggerEvents.enter.size() + m_triggerEvents.exit.size() + m_pendingTriggerEvents.enter.size() + m_pendingTriggerEvents.exit.size();
+		triggerEvents.usedBytes = triggerEvents.peakUsedBytes = triggerEvents.count * sizeof(TriggerEvent);
+		triggerEvents.reservedBytes = (m_triggerEvents.enter.capacity() + m_triggerEvents.exit.capacity() + m_pendingTriggerEvents.enter.capacity() + m_pendingTriggerEvents.exit.capacity()) * sizeof(TriggerEvent);
+		report.sections.push_back(triggerEvents);
+
+		MemoryUsage stepStats;
+		stepStats.name = "StepStats history";
+		stepStats.count = m_stepStatsHistory.size();
+		stepStats.peakCount = m_stepStatsHistory.capacity();
+		stepStats.usedBytes = m_stepStatsHistory.size() * sizeof(StepStats);
+		stepStats.peakUsedBytes = stepStats.reservedBytes = m_stepStatsHistory.capacity() * sizeof(StepStats);
+		report.sections.push_back(stepStats);
+
+		report.bullet = getBulletAllocationStats();
+		report.bulletStatsArePerWorld = m_arena != nullptr;
+		return report;
+	}
+
 	btVector3 PhysicsWorld::getGravity() const
 	{
 		return m_dynamicsWorld->getGravity();
@@ -49,17 +267,499 @@ namespace BulletECS
 
 
 
-	void PhysicsWorld::stepSimulation(float timeStep, int maxSubSteps, float fixedTimeStep)
+	const StepStats& PhysicsWorld::stepSimulation(float timeStep, int maxSubSteps, float fixedTimeStep)
+	{
+		BULLET_ECS_TRACE_SCOPE("PhysicsWorld::stepSimulation");
+		using Clock = std::chrono::steady_clock;
+		using Milliseconds = std::chrono::duration<double, std::milli>;
+		BulletAllocator::ScopedArena arenaScope(m_arena.get());
+		StepStats& stats = m_currentStepStats;
+		stats.frame = m_stepCount++;
+		m_changeTick++;
+		AllocationTracker::ScopedCounter stepAllocations;
+		//the counters are per thread, a world stepped from another thread than last time cannot tell
+		const uint64_t allocationCount = AllocationTracker::getAllocationCount();
+		stats.allocationsBetweenSteps = allocationCount >= m_lastStepEndAllocations ? static_cast<uint32_t>(allocationCount - m_lastStepEndAllocations) : 0;
+
+		const Clock::time_point start = Clock::now();
+		applySimulationLod(stats);
+		const Clock::time_point bulletStart = Clock::now();
+		{
+			StepProfiler::ScopedCapture capture(&stats);
+			stats.subSteps = m_dynamicsWorld->stepSimulation(static_cast<btScalar>(timeStep), maxSubSteps, static_cast<btScalar>(fixedTimeStep));
+		}
+		const Clock::time_point bulletEnd = Clock::now();
+		finishSimulationLod(static_cast<btScalar>(stats.subSteps * fixedTimeStep));
+		updateActiveRigidBodies();
+		const Clock::time_point ecsEnd = Clock::now();
+		collectStepCounters(stats);
+		//the buffers keep their capacity across swaps, so steady state steps do not allocate events
+		std::swap(m_triggerEvents, m_pendingTriggerEvents);
+		m_pendingTriggerEvents.clear();
+
+		stats.bulletTime = Milliseconds(bulletEnd - bulletStart).count();
+		stats.ecsTime = Milliseconds((bulletStart - start) + (ecsEnd - bulletEnd)).count();
+		stats.totalTime = Milliseconds(Clock::now() - start).count();
+		stats.stepAllocations = static_cast<uint32_t>(stepAllocations.getAllocations());
+		m_lastStepEndAllocations = AllocationTracker::getAllocationCount();
+		assert((!m_assertNoSteadyStateAllocations || stats.frame < m_steadyStateWarmupSteps || stats.stepAllocations == 0)
+			&& "A steady state step allocated from the heap, see StepStats::stepAllocations.");
+		m_stepStatsHistory.push(stats);
+		m_currentStepStats = StepStats{};
+		for (auto& [id, listener] : m_stepListeners)
+		{
+			listener(*this, m_stepStatsHistory.getLast());
+		}
+		return m_stepStatsHistory.getLast();
+	}
+
+	size_t PhysicsWorld::addStepListener(StepListener listener)
+	{
+		const size_t id = m_nextStepListenerId++;
+		m_stepListeners.emplace_back(id, std::move(listener));
+		return id;
+	}
+
+	void PhysicsWorld::removeStepListener(size_t id)
+	{
+		auto it = std::find_if(m_stepListeners.begin(), m_stepListeners.end(), [id](const auto& entry) { return entry.first == id; });
+		assert(it != m_stepListeners.end() && "Unknown step listener.");
+		m_stepListeners.erase(it);
+	}
+
+	void PhysicsWorld::collectStepCounters(StepStats& stats)
+	{
+		BULLET_ECS_TRACE_SCOPE("PhysicsWorld::collectStepCounters");
+		btDispatcher* dispatcher = m_dynamicsWorld->getDispatcher();
+		stats.overlappingPairs = static_cast<uint32_t>(m_dynamicsWorld->getPairCache()->getNumOverlappingPairs());
+		stats.manifolds = static_cast<uint32_t>(dispatcher->getNumManifolds());
+		for (int i = 0; i < dispatcher->getNumManifolds(); i++)
+		{
+			stats.contacts += static_cast<uint32_t>(dispatcher->getManifoldByIndexInternal(i)->getNumContacts());
+		}
+
+		//after the solver the union find holds the non static bodies sorted by island, so each run of equal ids is one island
+		if (auto* discreteWorld = dynamic_cast<btDiscreteDynamicsWorld*>(m_dynamicsWorld.get()))
+		{
+			const btUnionFind& unionFind = discreteWorld->getSimulationIslandManager()->getUnionFind();
+			for (int i = 0; i < unionFind.getNumElements(); i++)
+			{
+				if (i == 0 || unionFind.getElement(i).m_id != unionFind.getElement(i - 1).m_id)
+				{
+					stats.islands++;
+				}
+			}
+		}
+		stats.activeBodies = static_cast<uint32_t>(m_activeRigidBodies.count());
+
+		stats.shapeCacheHits = static_cast<uint32_t>(m_collisionShapeContainer.getCacheHits() - m_lastShapeCacheHits);
+		stats.shapeCacheMisses = static_cast<uint32_t>(m_collisionShapeContainer.getCacheMisses() - m_lastShapeCacheMisses);
+		m_lastShapeCacheHits = m_collisionShapeContainer.getCacheHits();
+		m_lastShapeCacheMisses = m_collisionShapeContainer.getCacheMisses();
+
+		stats.liveEntities = static_cast<uint32_t>(m_entityManager.getLiveEntityCount());
+		stats.rigidBodies = static_cast<uint32_t>(m_rigidBodyPool.getEntitiesMask().count());
+		stats.motionStates = static_cast<uint32_t>(m_motionStatePool.getEntitiesMask().count());
+		stats.colliders = static_cast<uint32_t>(m_collisionShapeContainer.getEntityCount());
+		stats.uniqueShapes = static_cast<uint32_t>(m_collisionShapeContainer.getUniqueShapeCount());
+	}
+
+	void PhysicsWorld::updateActiveRigidBodies()
+	{
+		BULLET_ECS_TRACE_SCOPE("PhysicsWorld::updateActiveRigidBodies");
+		//Bullet has no activation change callback, so the states are read once here instead of in every system.
+		//Static and kinematic bodies never change state on their own, only the dynamic ones are visited
+		const size_t last = getMaxEntities();
+		for (size_t id = m_dynamicRigidBodies.findNext(1, last); id <= last; id = m_dynamicRigidBodies.findNext(id + 1, last))
+		{
+			const Entity e{ static_cast<entity_id_t>(id), 0 };
+			const btRigidBody* rigidBody = m_rigidBodyPool.getUnmarked(e);
+			//made static or kinematic through the btRigidBody, its active bit is read one last time and it leaves the scan
+			if (rigidBody->isStaticOrKinematicObject())
+			{
+				m_dynamicRigidBodies.reset(id);
+			}
+			bool active = rigidBody->isActive();
+			//suspended Reduced bodies were moved by finishSimulationLod, they stay active so the active views and recorders see them move
+			if (!active && rigidBody->getActivationState() == DISABLE_SIMULATION)
+			{
+				const SimulationLodComponent* lod = std::as_const(m_simulationLodPool).get(e);
+				active = lod && lod->suspended && lod->tier == SimulationLod::Reduced;
+			}
+			m_activeRigidBodies.assign(e.ID, active);
+			//only awake bodies can have moved, the marks are no-ops for pools without change tracking
+			if (active)
+			{
+				m_rigidBodyPool.markModified(e);
+				m_motionStatePool.markModified(e);
+			}
+		}
+	}
+
+	void PhysicsWorld::addSimulationLod(Entity entity)
+	{
+		assert(m_rigidBodyPool.has(entity) && "Cannot add Simulation LOD to an entity without RigidBody.");
+		m_simulationLodPool.add(entity);
+	}
+
+	void PhysicsWorld::removeSimulationLod(Entity entity)
+	{
+		const SimulationLodComponent* lod = std::as_const(m_simulationLodPool).get(entity);
+		assert(lod && "Cannot remove non existent Simulation LOD.");
+		if (lod->suspended)
+		{
+			m_rigidBodyPool.getUnmarked(entity)->forceActivationState(ACTIVE_TAG);
+		}
+		m_simulationLodPool.remove(entity);
+	}
+
+	SimulationLod PhysicsWorld::getSimulationLod(Entity entity) const
+	{
+		if (const SimulationLodComponent* lod = m_simulationLodPool.get(entity))
+		{
+			return lod->tier;
+		}
+		return SimulationLod::Full;
+	}
+
+	void PhysicsWorld::setSimulationLodFocusPoints(Span<const btVector3> points)
+	{
+		m_lodFocusPoints.assign(points.begin(), points.end());
+	}
+
+	SimulationLod PhysicsWorld::computeLodTier(SimulationLod current, const btVector3& position) const
+	{
+		if (m_lodFocusPoints.empty())
+		{
+			return SimulationLod::Full;
+		}
+		btScalar distance2 = BT_LARGE_FLOAT;
+		for (const btVector3& point : m_lodFocusPoints)
+		{
+			distance2 = btMin(distance2, point.distance2(position));
+		}
+
+		//moving to a cheaper tier needs the margin, moving back does not
+		const btScalar margin = 1.0f + m_lodSettings.hysteresis;
+		const btScalar fullRadius = current == SimulationLod::Full ? m_lodSettings.fullRadius * margin : m_lodSettings.fullRadius;
+		const btScalar reducedRadius = current == SimulationLod::Frozen ? m_lodSettings.reducedRadius : m_lodSettings.reducedRadius * margin;
+		if (distance2 <= fullRadius * fullRadius)
+		{
+			return SimulationLod::Full;
+		}
+		return distance2 <= reducedRadius * reducedRadius ? SimulationLod::Reduced : SimulationLod::Frozen;
+	}
+
+	void PhysicsWorld::applySimulationLod(StepStats& stats)
 	{
-		m_dynamicsWorld->stepSimulation(static_cast<btScalar>(timeStep), maxSubSteps, static_cast<btScalar>(fixedTimeStep));
+		if (m_simulationLodPool.size() == 0)
+		{
+			return;
+		}
+		BULLET_ECS_TRACE_SCOPE("PhysicsWorld::applySimulationLod");
+		const uint64_t updateInterval = m_lodSettings.updateInterval > 0 ? m_lodSettings.updateInterval : 1;
+		const uint64_t stepDivisor = m_lodSettings.reducedStepDivisor > 0 ? m_lodSettings.reducedStepDivisor : 1;
+
+		//DISABLE_SIMULATION bodies are skipped by the integration and every pair with another inactive body. Their aabbs are still
+		//updated every step under Bullet's default forced aabb updates, with setForceUpdateAllAabbs(false) the Frozen ones skip that too
+		for (Entity e : m_simulationLodPool)
+		{
+			SimulationLodComponent* lod = m_simulationLodPool.getUnmarked(e);
+			btRigidBody* rigidBody = m_rigidBodyPool.getUnmarked(e);
+			if (rigidBody->isStaticOrKinematicObject())
+			{
+				continue;
+			}
+			if ((e.ID + stats.frame) % updateInterval == 0)
+			{
+				lod->tier = computeLodTier(lod->tier, rigidBody->getCenterOfMassPosition());
+			}
+
+			//Reduced bodies are staggered by ID so each step simulates about the same number of them
+			const bool simulate = lod->tier == SimulationLod::Full || (lod->tier == SimulationLod::Reduced && (e.ID + stats.frame) % stepDivisor == 0);
+			if (simulate && lod->suspended)
+			{
+				rigidBody->forceActivationState(ACTIVE_TAG);
+				lod->suspended = false;
+			}
+			else if (!simulate && !lod->suspended && rigidBody->isActive())
+			{
+				rigidBody->forceActivationState(DISABLE_SIMULATION);
+				lod->suspended = true;
+			}
+			stats.lodSuspendedBodies += lod->suspended ? 1 : 0;
+		}
+	}
+
+	void PhysicsWorld::finishSimulationLod(btScalar simulatedTime)
+	{
+		if (m_simulationLodPool.size() == 0)
+		{
+			return;
+		}
+		BULLET_ECS_TRACE_SCOPE("PhysicsWorld::finishSimulationLod");
+
+		//a suspended body does not move when hit, so the awake bodies touching one wake it up before it acts like a wall
+		btDispatcher* dispatcher = m_dynamicsWorld->getDispatcher();
+		for (int i = 0; i < dispatcher->getNumManifolds(); i++)
+		{
+			const btPersistentManifold* manifold = dispatcher->getManifoldByIndexInternal(i);
+			if (manifold->getNumContacts() == 0)
+			{
+				continue;
+			}
+			const btCollisionObject* bodies[2] = { manifold->getBody0(), manifold->getBody1() };
+			for (int b = 0; b < 2; b++)
+			{
+				if (bodies[b]->getActivationState() != DISABLE_SIMULATION || !bodies[1 - b]->isActive())
+				{
+					continue;
+				}
+				const Entity entity = getCollisionObjectEntity(bodies[b]);
+				SimulationLodComponent* lod = entity.ID != NULL_ENTITY ? m_simulationLodPool.getUnmarked(entity) : nullptr;
+				if (lod && lod->suspended)
+				{
+					lod->tier = SimulationLod::Full;
+					lod->suspended = false;
+					m_rigidBodyPool.getUnmarked(entity)->forceActivationState(ACTIVE_TAG);
+				}
+			}
+		}
+
+		//skipped Reduced bodies keep moving with their velocities and gravity, so they are not slowed down by the divided rate
+		if (simulatedTime <= 0)
+		{
+			return;
+		}
+		for (Entity e : m_simulationLodPool)
+		{
+			const SimulationLodComponent* lod = std::as_const(m_simulationLodPool).get(e);
+			if (!lod->suspended || lod->tier != SimulationLod::Reduced)
+			{
+				continue;
+			}
+			btRigidBody* rigidBody = m_rigidBodyPool.getUnmarked(e);
+			//Bullet does not apply gravity to suspended bodies, without this a falling body would accelerate at g / reducedStepDivisor
+			rigidBody->setLinearVelocity(rigidBody->getLinearVelocity() + rigidBody->getGravity() * simulatedTime);
+			btTransform predicted;
+			rigidBody->predictIntegratedTransform(simulatedTime, predicted);
+			rigidBody->setWorldTransform(predicted);
+			rigidBody->setInterpolationWorldTransform(predicted);
+			if (btMotionState* motionState = rigidBody->getMotionState())
+			{
+				motionState->setWorldTransform(predicted);
+			}
+			//without forced aabb updates Bullet only refreshes the active bodies, these moved while suspended
+			if (!m_dynamicsWorld->getForceUpdateAllAabbs())
+			{
+				m_dynamicsWorld->updateSingleAabb(rigidBody);
+			}
+			m_rigidBodyPool.markModified(e);
+			m_motionStatePool.markModified(e);
+		}
 	}
 
 	Entity PhysicsWorld::createEntity()
 	{
+		BULLET_ECS_TRACE_SCOPE("PhysicsWorld::createEntity");
+		m_currentStepStats.entitiesCreated++;
 		return m_entityManager.createEntity();
 	}
 
 
+	CompactionResult PhysicsWorld::compact(CompactionOrder order)
+	{
+		BULLET_ECS_TRACE_SCOPE("PhysicsWorld::compact");
+		BulletAllocator::ScopedArena arenaScope(m_arena.get());
+		CompactionResult result;
+		const EntityBitset& alive = m_entityManager.getAliveMask();
+		const entity_id_t highest = m_entityManager.getHighestEntity();
+
+		EntityBitset pinned(static_cast<size_t>(highest) + 1);
+		std::vector<Entity> movable;
+		movable.reserve(m_entityManager.getLiveEntityCount());
+		for (size_t id = alive.findNext(1, highest); id <= highest; id = alive.findNext(id + 1, highest))
+		{
+			const Entity entity = m_entityManager.getEntity(static_cast<entity_id_t>(id));
+			if (isPinnedForCompaction(entity))
+			{
+				pinned.set(id);
+			}
+			else
+			{
+				movable.push_back(entity);
+			}
+		}
+
+		if (order == CompactionOrder::Morton)
+		{
+			btVector3 min(BT_LARGE_FLOAT, BT_LARGE_FLOAT, BT_LARGE_FLOAT);
+			btVector3 max(-BT_LARGE_FLOAT, -BT_LARGE_FLOAT, -BT_LARGE_FLOAT);
+			for (Entity entity : movable)
+			{
+				if (const btDefaultMotionState* motionState = m_motionStatePool.get(entity))
+				{
+					min.setMin(motionState->m_graphicsWorldTrans.getOrigin());
+					max.setMax(motionState->m_graphicsWorldTrans.getOrigin());
+				}
+			}
+			const btVector3 extent = (max - min).absolute();
+			auto axisScale = [](btScalar size) { return size > SIMD_EPSILON ? btScalar(1023) / size : btScalar(0); };
+			const btVector3 scale(axisScale(extent.x()), axisScale(extent.y()), axisScale(extent.z()));
+
+			//entities without a motion state go last, in ID order
+			std::vector<std::pair<uint32_t, Entity>> keyed;
+			keyed.reserve(movable.size());
+			for (Entity entity : movable)
+			{
+				const btDefaultMotionState* motionState = m_motionStatePool.get(entity);
+				keyed.emplace_back(motionState ? mortonCode(motionState->m_graphicsWorldTrans.getOrigin(), min, scale) : UINT32_MAX, entity);
+			}
+			std::stable_sort(keyed.begin(), keyed.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+			for (size_t i = 0; i < keyed.size(); i++)
+			{
+				movable[i] = keyed[i].second;
+			}
+		}
+
+		//the movable entities take the lowest IDs that are not pinned, in their sorted order
+		std::vector<EntityMove> planned;
+		constexpr uint32_t NO_MOVE = UINT32_MAX;
+		std::vector<uint32_t> moveInto(static_cast<size_t>(highest) + 1, NO_MOVE);
+		entity_id_t next = 1;
+		for (Entity entity : movable)
+		{
+			while (pinned[next])
+			{
+				next++;
+			}
+			if (entity.ID != next)
+			{
+				moveInto[next] = static_cast<uint32_t>(planned.size());
+				planned.push_back(EntityMove{ entity, Entity{ next, 0 } });
+			}
+			next++;
+		}
+
+		//Bullet keeps pointers to the bodies, so they leave the world before their slots move
+		for (Entity entity : m_rigidBodyPool)
+		{
+			m_dynamicsWorld->removeRigidBody(m_rigidBodyPool.getUnmarked(entity));
+		}
+
+		std::vector<Entity> finalHandles(planned.size());
+		std::vector<char> done(planned.size(), 0);
+		//runs the move into a free ID, then the move into the ID it just freed, and so on
+		auto runChainInto = [&](entity_id_t freeID)
+		{
+			for (uint32_t move = moveInto[freeID]; move != NO_MOVE && !done[move]; move = moveInto[planned[move].from.ID])
+			{
+				done[move] = 1;
+				finalHandles[move] = relocateEntity(planned[move].from, planned[move].to.ID);
+				result.moves.push_back(EntityMove{ planned[move].from, finalHandles[move] });
+			}
+		};
+
+		//chains end on an ID that is free now, what is left are cycles where every target is taken by another moving entity
+		for (size_t move = 0; move < planned.size(); move++)
+		{
+			if (!done[move] && !alive[planned[move].to.ID])
+			{
+				runChainInto(planned[move].to.ID);
+			}
+		}
+		for (size_t move = 0; move < planned.size(); move++)
+		{
+			if (done[move])
+			{
+				continue;
+			}
+			//the first entity of the cycle waits on a free ID while the rest of the cycle shifts into place
+			const entity_id_t parkingID = static_cast<entity_id_t>(alive.findNextClear(1, getMaxEntities()));
+			assert(parkingID <= getMaxEntities() && "Compacting a full world in Morton order needs one free entity ID.");
+			done[move] = 1;
+			const Entity parked = relocateEntity(planned[move].from, parkingID);
+			result.moves.push_back(EntityMove{ planned[move].from, parked });
+			runChainInto(planned[move].from.ID);
+			finalHandles[move] = relocateEntity(parked, planned[move].to.ID);
+			result.moves.push_back(EntityMove{ parked, finalHandles[move] });
+		}
+
+		result.remap.reserve(planned.size());
+		for (size_t move = 0; move < planned.size(); move++)
+		{
+			result.remap.push_back(EntityMove{ planned[move].from, finalHandles[move] });
+		}
+
+		for (Entity entity : m_rigidBodyPool)
+		{
+			btRigidBody* rigidBody = m_rigidBodyPool.getUnmarked(entity);
+			const btVector3 gravity = rigidBody->getGravity();
+			addRigidBodyToWorld(rigidBody, getCollisionLayer(entity));
+			rigidBody->setGravity(gravity); //adding a body gives it the world's gravity
+		}
+		return result;
+	}
+
+	bool PhysicsWorld::isPinnedForCompaction(Entity entity) const
+	{
+		//the ghost keeps its entity, joints keep their bodies' addresses and the links keep the IDs
+		if (m_triggerPool.has(entity) || m_jointLinks.firstJointOn(entity.ID).owner != NULL_ENTITY)
+		{
+			return true;
+		}
+		for (uint8_t type = 0; type < static_cast<uint8_t>(JointType::Count); type++)
+		{
+			if (getJoint(entity, static_cast<JointType>(type)))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	Entity PhysicsWorld::relocateEntity(Entity from, entity_id_t toID)
+	{
+		const Entity to = m_entityManager.relocate(from, toID);
+		if (m_motionStatePool.has(from))
+		{
+			m_motionStatePool.relocate(from, to);
+		}
+		if (m_collisionShapeContainer.has(from))
+		{
+			m_collisionShapeContainer.setFromExistentEntity(to, from);
+			m_collisionShapeContainer.remove(from);
+		}
+		if (m_rigidBodyPool.has(from))
+		{
+			//the body is copied to its new slot, it has to point at the moved motion state without taking the motion state's transform
+			const btTransform worldTransform = m_rigidBodyPool.getUnmarked(from)->getWorldTransform();
+			btRigidBody* rigidBody = m_rigidBodyPool.relocate(from, to);
+			rigidBody->setMotionState(m_motionStatePool.getUnmarked(to));
+			rigidBody->setWorldTransform(worldTransform);
+			setCollisionObjectEntity(rigidBody, to);
+			m_activeRigidBodies.assign(to.ID, m_activeRigidBodies[from.ID]);
+			m_activeRigidBodies.reset(from.ID);
+			m_dynamicRigidBodies.assign(to.ID, m_dynamicRigidBodies[from.ID]);
+			m_dynamicRigidBodies.reset(from.ID);
+		}
+		if (const TagComponent* tag = std::as_const(m_tagPool).get(from))
+		{
+			m_tagTable.relocate(from, to, tag->id);
+			m_tagPool.relocate(from, to);
+		}
+		if (m_collisionLayerPool.has(from))
+		{
+			m_collisionLayerPool.relocate(from, to);
+		}
+		if (m_simulationLodPool.has(from))
+		{
+			m_simulationLodPool.relocate(from, to);
+		}
+		onEntityRelocated(from, to);
+		return to;
+	}
+
 	btDefaultMotionState* PhysicsWorld::addMotionState(Entity entity, const btTransform& transformData)
 	{
 		return m_motionStatePool.add(entity, transformData);
@@ -90,13 +790,80 @@ namespace BulletECS
 		return m_collisionShapeContainer.setFromExistentEntity(entity, existentEntityWithCollider);
 	}
 
-	void PhysicsWorld::addTag(Entity entity, const std::string& name)
+	btCollisionShape* PhysicsWorld::setCollider(Entity entity, const ColliderDesc& desc)
+	{
+		switch (desc.type)
+		{
+		case ColliderType::Box: return setBoxCollider(entity, desc.size);
+		case ColliderType::Sphere: return setSphereCollider(entity, desc.size.x());
+		case ColliderType::Cylinder: return setCylinderCollider(entity, desc.size);
+		case ColliderType::Capsule: return setCapsuleCollider(entity, desc.size.x(), desc.size.y());
+		default: assert(false && "Unknown ColliderType."); return nullptr;
+		}
+	}
+
+	HeightfieldTileShape* PhysicsWorld::setHeightfieldCollider(Entity entity, const std::string& path, uint32_t tileX, uint32_t tileZ)
+	{
+		return m_collisionShapeContainer.setHeightfieldTile(entity, path, tileX, tileZ);
+	}
+
+	tag_id_t PhysicsWorld::addTag(Entity entity, std::string_view name)
+	{
+		tag_id_t id = m_tagTable.intern(name);
+		addTag(entity, id);
+		return id;
+	}
+
+	void PhysicsWorld::addTag(Entity entity, tag_id_t id)
 	{
-		m_tagPool.add(entity, name);
+		m_tagPool.add(entity, id);
+		m_tagTable.add(entity, id);
+	}
+
+	void PhysicsWorld::setCollisionLayer(Entity entity, collision_layer_t layer)
+	{
+		BulletAllocator::ScopedArena arenaScope(m_arena.get());
+		assert(layer < MAX_COLLISION_LAYERS && "Collision layer out of bounds.");
+		if (CollisionLayerComponent* layerComponent = m_collisionLayerPool.get(entity))
+		{
+			layerComponent->layer = layer;
+		}
+		else
+		{
+			m_collisionLayerPool.add(entity, layer);
+		}
+
+		if (btRigidBody* rigidBody = getRigidBody(entity))
+		{
+			//the broadphase proxy keeps the group it was created with, so the body has to be re-added
+			m_dynamicsWorld->removeRigidBody(rigidBody);
+			addRigidBodyToWorld(rigidBody, layer);
+		}
+		if (TriggerGhostObject* trigger = getTrigger(entity))
+		{
+			m_dynamicsWorld->removeCollisionObject(trigger);
+			addTriggerToWorld(trigger, layer);
+		}
+	}
+
+	collision_layer_t PhysicsWorld::getCollisionLayer(Entity entity) const
+	{
+		if (auto* layerComponent = m_collisionLayerPool.get(entity))
+		{
+			return layerComponent->layer;
+		}
+		return DEFAULT_COLLISION_LAYER;
+	}
+
+	void PhysicsWorld::setLayersCollide(collision_layer_t layerA, collision_layer_t layerB, bool collide)
+	{
+		m_collisionLayers.setCollides(layerA, layerB, collide);
 	}
 
 	btRigidBody* PhysicsWorld::addRigidBody(Entity entity, float mass, float restitution)
 	{
+		BULLET_ECS_TRACE_SCOPE("PhysicsWorld::addRigidBody");
+		BulletAllocator::ScopedArena arenaScope(m_arena.get());
 		//TODO: make sure the entity has a motionState and collider
 		btDefaultMotionState* motionState = getMotionState(entity);
 		btCollisionShape* collider = getCollisionShape(entity);
@@ -114,14 +881,486 @@ namespace BulletECS
 		rbData.m_restitution = restitution;
 
 		btRigidBody* rigidBody = m_rigidBodyPool.add(entity, rbData);
+		setCollisionObjectEntity(rigidBody, entity);
 
-		m_dynamicsWorld->addRigidBody(rigidBody);
+		addRigidBodyToWorld(rigidBody, getCollisionLayer(entity));
+		m_activeRigidBodies.assign(entity.ID, rigidBody->isActive());
+		m_dynamicRigidBodies.assign(entity.ID, !rigidBody->isStaticOrKinematicObject());
 
 		return rigidBody;
 	}
 
 
 
+	void PhysicsWorld::setKinematic(Entity entity, bool kinematic)
+	{
+		btRigidBody* rigidBody = getRigidBody(entity);
+		assert(rigidBody && "Cannot make kinematic an entity without RigidBody.");
+		if (kinematic)
+		{
+			rigidBody->setCollisionFlags(rigidBody->getCollisionFlags() | btCollisionObject::CF_KINEMATIC_OBJECT);
+			rigidBody->forceActivationState(DISABLE_DEACTIVATION);
+		}
+		else
+		{
+			rigidBody->setCollisionFlags(rigidBody->getCollisionFlags() & ~btCollisionObject::CF_KINEMATIC_OBJECT);
+			rigidBody->forceActivationState(ACTIVE_TAG);
+		}
+		m_activeRigidBodies.assign(entity.ID, rigidBody->isActive());
+		m_dynamicRigidBodies.assign(entity.ID, !rigidBody->isStaticOrKinematicObject());
+	}
+
+	void PhysicsWorld::setMass(Entity entity, float mass)
+	{
+		BulletAllocator::ScopedArena arenaScope(m_arena.get());
+		btRigidBody* rigidBody = getRigidBody(entity);
+		assert(rigidBody && "Cannot set the mass of an entity without RigidBody.");
+		btVector3 localInertia(0, 0, 0);
+		if (mass != 0.0f)
+		{
+			rigidBody->getCollisionShape()->calculateLocalInertia(mass, localInertia);
+		}
+		//Bullet gives gravity and the static filter only when a body is added, so it is re-added with its new mass
+		m_dynamicsWorld->removeRigidBody(rigidBody);
+		rigidBody->setMassProps(mass, localInertia);
+		rigidBody->updateInertiaTensor();
+		addRigidBodyToWorld(rigidBody, getCollisionLayer(entity));
+		if (!rigidBody->isStaticOrKinematicObject())
+		{
+			rigidBody->activate(true);
+		}
+		m_activeRigidBodies.assign(entity.ID, rigidBody->isActive());
+		m_dynamicRigidBodies.assign(entity.ID, !rigidBody->isStaticOrKinematicObject());
+	}
+
+	void PhysicsWorld::setKinematicTransforms(Span<const Entity> entities, Span<const btVector3> positions, Span<const btQuaternion> rotations)
+	{
+		BULLET_ECS_TRACE_SCOPE("PhysicsWorld::setKinematicTransforms");
+		assert(entities.size() == positions.size() && entities.size() == rotations.size() && "Kinematic transform spans must have the same size.");
+
+		//the interpolation transform is left as the previous pose, Bullet computes the kinematic velocity (used for friction with
+		//the bodies on top of the platform) from it and the motion state in the next step
+		for (size_t i = 0; i < entities.size(); i++)
+		{
+			const Entity entity = entities[i];
+			btRigidBody* rigidBody = m_rigidBodyPool.get(entity);
+			btDefaultMotionState* motionState = m_motionStatePool.get(entity);
+			assert(rigidBody && motionState && rigidBody->isKinematicObject() && "setKinematicTransforms needs kinematic rigidBodies.");
+
+			const btTransform transform(rotations[i], positions[i]);
+			motionState->m_graphicsWorldTrans = transform; //the library's motion states have no center of mass offset
+			rigidBody->setWorldTransform(transform);
+			//kinematic bodies are not visited by updateActiveRigidBodies, they are marked where they move
+			m_rigidBodyPool.markModified(entity);
+			m_motionStatePool.markModified(entity);
+		}
+
+		//with forced aabb updates (Bullet's default) the next step updates every aabb anyway,
+		//otherwise the kinematic aabbs are refreshed here in a second pass so queries before the step see the new poses
+		if (!m_dynamicsWorld->getForceUpdateAllAabbs())
+		{
+			for (const Entity entity : entities)
+			{
+				m_dynamicsWorld->updateSingleAabb(m_rigidBodyPool.get(entity));
+			}
+		}
+	}
+
+	void PhysicsWorld::applyCentralForces(Span<const Entity> entities, Span<const btVector3> forces)
+	{
+		applyBulk(BulkOperation::CentralForce, entities, forces);
+	}
+
+	void PhysicsWorld::applyCentralImpulses(Span<const Entity> entities, Span<const btVector3> impulses)
+	{
+		applyBulk(BulkOperation::CentralImpulse, entities, impulses);
+	}
+
+	void PhysicsWorld::applyTorques(Span<const Entity> entities, Span<const btVector3> torques)
+	{
+		applyBulk(BulkOperation::Torque, entities, torques);
+	}
+
+	void PhysicsWorld::setLinearVelocities(Span<const Entity> entities, Span<const btVector3> velocities)
+	{
+		applyBulk(BulkOperation::LinearVelocity, entities, velocities);
+	}
+
+	void PhysicsWorld::setAngularVelocities(Span<const Entity> entities, Span<const btVector3> velocities)
+	{
+		applyBulk(BulkOperation::AngularVelocity, entities, velocities);
+	}
+
+	void PhysicsWorld::applyBulk(BulkOperation operation, Span<const Entity> entities, Span<const btVector3> values)
+	{
+		BULLET_ECS_TRACE_SCOPE("PhysicsWorld::applyBulk");
+		assert(entities.size() == values.size() && "Bulk operation spans must have the same size.");
+
+		//the active bits are not touched (they could share words between chunks), they are refreshed after the next step as usual
+		runBulkChunks(m_threadPool, entities.size(), [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				//the bodies woken up here are marked after the step like every active body
+				btRigidBody* rigidBody = m_rigidBodyPool.getUnmarked(entities[i]);
+				assert(rigidBody && "Bulk operations need entities with RigidBody.");
+				if (rigidBody->isStaticOrKinematicObject())
+				{
+					continue;
+				}
+				const btVector3& value = values[i];
+				switch (operation)
+				{
+				case BulkOperation::CentralForce: rigidBody->applyCentralForce(value); break;
+				case BulkOperation::CentralImpulse: rigidBody->applyCentralImpulse(value); break;
+				case BulkOperation::Torque: rigidBody->applyTorque(value); break;
+				case BulkOperation::LinearVelocity: rigidBody->setLinearVelocity(value); break;
+				case BulkOperation::AngularVelocity: rigidBody->setAngularVelocity(value); break;
+				}
+				if (!value.fuzzyZero())
+				{
+					rigidBody->activate();
+				}
+			}
+		});
+	}
+
+	void PhysicsWorld::applyForceField(const std::function<btVector3(Entity, const btVector3&)>& field, const EntityBitset* mask)
+	{
+		BULLET_ECS_TRACE_SCOPE("PhysicsWorld::applyForceField");
+		const EntityBitset& rigidBodies = m_rigidBodyPool.getEntitiesMask();
+		const size_t idCount = static_cast<size_t>(m_rigidBodyPool.getHighestEntity()) + 1;
+
+		//chunks are ranges of IDs, so each thread walks its own contiguous part of the pool
+		runBulkChunks(m_threadPool, idCount, [&](size_t begin, size_t end)
+		{
+			for (size_t id = rigidBodies.findNext(begin, end - 1, mask); id < end; id = rigidBodies.findNext(id + 1, end - 1, mask))
+			{
+				const Entity entity{ static_cast<entity_id_t>(id), 0 };
+				btRigidBody* rigidBody = m_rigidBodyPool.getUnmarked(entity);
+				if (rigidBody->isStaticOrKinematicObject())
+				{
+					continue;
+				}
+				const btVector3 force = field(entity, rigidBody->getCenterOfMassPosition());
+				if (!force.fuzzyZero())
+				{
+					rigidBody->applyCentralForce(force);
+					rigidBody->activate();
+				}
+			}
+		});
+	}
+
+	void PhysicsWorld::applyRadialImpulse(btVector3 center, float radius, float impulse)
+	{
+		BULLET_ECS_TRACE_SCOPE("PhysicsWorld::applyRadialImpulse");
+		assert(radius > 0.0f && "Radial impulse radius must be positive.");
+		const EntityBitset& rigidBodies = m_rigidBodyPool.getEntitiesMask();
+		const size_t idCount = static_cast<size_t>(m_rigidBodyPool.getHighestEntity()) + 1;
+		const btScalar radius2 = radius * radius;
+
+		runBulkChunks(m_threadPool, idCount, [&](size_t begin, size_t end)
+		{
+			for (size_t id = rigidBodies.findNext(begin, end - 1); id < end; id = rigidBodies.findNext(id + 1, end - 1))
+			{
+				btRigidBody* rigidBody = m_rigidBodyPool.getUnmarked(Entity{ static_cast<entity_id_t>(id), 0 });
+				if (rigidBody->isStaticOrKinematicObject())
+				{
+					continue;
+				}
+				const btVector3 offset = rigidBody->getCenterOfMassPosition() - center;
+				const btScalar distance2 = offset.length2();
+				if (distance2 >= radius2)
+				{
+					continue;
+				}
+				const btScalar distance = btSqrt(distance2);
+				//bodies exactly at the center are pushed up
+				const btVector3 direction = distance > SIMD_EPSILON ? offset / distance : btVector3(0, 1, 0);
+				rigidBody->applyCentralImpulse(direction * (impulse * (1.0f - distance / radius)));
+				rigidBody->activate();
+			}
+		});
+	}
+
+	TriggerGhostObject* PhysicsWorld::addTrigger(Entity entity)
+	{
+		BULLET_ECS_TRACE_SCOPE("PhysicsWorld::addTrigger");
+		BulletAllocator::ScopedArena arenaScope(m_arena.get());
+		btCollisionShape* collider = getCollisionShape(entity);
+		assert(collider && "Cannot add a Trigger to an entity without collider");
+
+		TriggerGhostObject* trigger = m_triggerPool.add(entity, entity, &m_pendingTriggerEvents);
+		trigger->setCollisionShape(collider);
+		if (const btDefaultMotionState* motionState = getMotionState(entity))
+		{
+			trigger->setWorldTransform(motionState->m_graphicsWorldTrans);
+		}
+		addTriggerToWorld(trigger, getCollisionLayer(entity));
+		return trigger;
+	}
+
+	void PhysicsWorld::setTriggerTransform(Entity entity, const btTransform& transform)
+	{
+		TriggerGhostObject* trigger = getTrigger(entity);
+		assert(trigger && "Cannot move non existent Trigger.");
+		trigger->setWorldTransform(transform);
+		//queries before the step see the new pose, the pairs (and events) are updated by the broadphase in the next step
+		m_dynamicsWorld->updateSingleAabb(trigger);
+	}
+
+	btPoint2PointConstraint* PhysicsWorld::addPointToPointJoint(Entity entity, Entity other, btVector3 pivotInEntity, btVector3 pivotInOther, bool disableCollisionsBetweenBodies)
+	{
+		JointDesc desc;
+		desc.type = JointType::PointToPoint;
+		desc.entity = entity;
+		desc.other = other;
+		desc.frameInEntity.setOrigin(pivotInEntity);
+		desc.frameInOther.setOrigin(pivotInOther);
+		desc.disableCollisionsBetweenBodies = disableCollisionsBetweenBodies;
+		return static_cast<btPoint2PointConstraint*>(addJoint(desc));
+	}
+
+	btHingeConstraint* PhysicsWorld::addHingeJoint(Entity entity, Entity other, const btTransform& frameInEntity, const btTransform& frameInOther, bool disableCollisionsBetweenBodies)
+	{
+		JointDesc desc;
+		desc.type = JointType::Hinge;
+		desc.entity = entity;
+		desc.other = other;
+		desc.frameInEntity = frameInEntity;
+		desc.frameInOther = frameInOther;
+		desc.disableCollisionsBetweenBodies = disableCollisionsBetweenBodies;
+		return static_cast<btHingeConstraint*>(addJoint(desc));
+	}
+
+	btSliderConstraint* PhysicsWorld::addSliderJoint(Entity entity, Entity other, const btTransform& frameInEntity, const btTransform& frameInOther, bool disableCollisionsBetweenBodies)
+	{
+		JointDesc desc;
+		desc.type = JointType::Slider;
+		desc.entity = entity;
+		desc.other = other;
+		desc.frameInEntity = frameInEntity;
+		desc.frameInOther = frameInOther;
+		desc.disableCollisionsBetweenBodies = disableCollisionsBetweenBodies;
+		return static_cast<btSliderConstraint*>(addJoint(desc));
+	}
+
+	btGeneric6DofConstraint* PhysicsWorld::addGeneric6DofJoint(Entity entity, Entity other, const btTransform& frameInEntity, const btTransform& frameInOther, bool disableCollisionsBetweenBodies)
+	{
+		JointDesc desc;
+		desc.type = JointType::Generic6Dof;
+		desc.entity = entity;
+		desc.other = other;
+		desc.frameInEntity = frameInEntity;
+		desc.frameInOther = frameInOther;
+		desc.disableCollisionsBetweenBodies = disableCollisionsBetweenBodies;
+		return static_cast<btGeneric6DofConstraint*>(addJoint(desc));
+	}
+
+	btTypedConstraint* PhysicsWorld::addJoint(const JointDesc& desc)
+	{
+		BULLET_ECS_TRACE_SCOPE("PhysicsWorld::addJoint");
+		BulletAllocator::ScopedArena arenaScope(m_arena.get());
+		btRigidBody* rigidBody = getRigidBody(desc.entity);
+		btRigidBody* otherRigidBody = desc.other.ID != NULL_ENTITY ? getRigidBody(desc.other) : nullptr;
+		assert(rigidBody && "Cannot add a Joint to an entity without RigidBody");
+		assert((desc.other.ID == NULL_ENTITY || otherRigidBody) && "Cannot attach a Joint to an entity without RigidBody");
+		
+		//constraints with a single body are attached to Bullet's fixed body
+		btTypedConstraint* constraint = nullptr;
+		switch (desc.type)
+		{
+		case JointType::PointToPoint:
+		{
+			btPoint2PointConstraint* pointToPoint = otherRigidBody
+				? m_pointToPointJointPool.add(desc.entity, *rigidBody, *otherRigidBody, desc.frameInEntity.getOrigin(), desc.frameInOther.getOrigin())
+				: m_pointToPointJointPool.add(desc.entity, *rigidBody, desc.frameInEntity.getOrigin());
+			constraint = pointToPoint;
+			break;
+		}
+		case JointType::Hinge:
+		{
+			btHingeConstraint* hinge = otherRigidBody
+				? m_hingeJointPool.add(desc.entity, *rigidBody, *otherRigidBody, desc.frameInEntity, desc.frameInOther)
+				: m_hingeJointPool.add(desc.entity, *rigidBody, desc.frameInEntity);
+			if (desc.hasLimits)
+			{
+				hinge->setLimit(desc.limits.angularLower.z(), desc.limits.angularUpper.z());
+			}
+			constraint = hinge;
+			break;
+		}
+		case JointType::Slider:
+		{
+			btSliderConstraint* slider = otherRigidBody
+				? m_sliderJointPool.add(desc.entity, *rigidBody, *otherRigidBody, desc.frameInEntity, desc.frameInOther, true)
+				: m_sliderJointPool.add(desc.entity, *rigidBody, desc.frameInEntity, true);
+			if (desc.hasLimits)
+			{
+				slider->setLowerLinLimit(desc.limits.linearLower.x());
+				slider->setUpperLinLimit(desc.limits.linearUpper.x());
+				slider->setLowerAngLimit(desc.limits.angularLower.x());
+				slider->setUpperAngLimit(desc.limits.angularUpper.x());
+			}
+			constraint = slider;
+			break;
+		}
+		case JointType::Generic6Dof:
+		{
+			btGeneric6DofConstraint* generic6Dof = otherRigidBody
+				? m_generic6DofJointPool.add(desc.entity, *rigidBody, *otherRigidBody, desc.frameInEntity, desc.frameInOther, true)
+				: m_generic6DofJointPool.add(desc.entity, *rigidBody, desc.frameInEntity, true);
+			if (desc.hasLimits)
+			{
+				generic6Dof->setLinearLowerLimit(desc.limits.linearLower);
+				generic6Dof->setLinearUpperLimit(desc.limits.linearUpper);
+				generic6Dof->setAngularLowerLimit(desc.limits.angularLower);
+				generic6Dof->setAngularUpperLimit(desc.limits.angularUpper);
+			}
+			constraint = generic6Dof;
+			break;
+		}
+		default:
+			assert(false && "Unknown JointType.");
+			return nullptr;
+		}
+
+		//lets code holding only the btTypedConstraint find its owner
+		constraint->setUserConstraintId(static_cast<int>(desc.entity.ID));
+		constraint->setUserConstraintType(static_cast<int>(desc.type));
+		m_dynamicsWorld->addConstraint(constraint, desc.disableCollisionsBetweenBodies);
+		m_jointLinks.link(desc.entity.ID, desc.type, desc.other.ID);
+		return constraint;
+	}
+
+	void PhysicsWorld::addJoints(const JointDesc* descs, size_t count)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			addJoint(descs[i]);
+		}
+	}
+
+	void PhysicsWorld::addJointChain(const Entity* entities, size_t count, const JointDesc& linkDesc)
+	{
+		JointDesc desc = linkDesc;
+		for (size_t i = 1; i < count; i++)
+		{
+			desc.entity = entities[i];
+			desc.other = entities[i - 1];
+			addJoint(desc);
+		}
+	}
+
+	void PhysicsWorld::instantiateJointPrefab(const JointPrefab& prefab, const Entity* boneEntities)
+	{
+		for (const JointPrefab::Joint& joint : prefab.joints)
+		{
+			JointDesc desc = joint.desc;
+			desc.entity = boneEntities[joint.bone];
+			desc.other = boneEntities[joint.parentBone];
+			addJoint(desc);
+		}
+	}
+
+	void PhysicsWorld::addBodies(const BodyDesc* descs, size_t count, Entity* entities)
+	{
+		BULLET_ECS_TRACE_SCOPE("PhysicsWorld::addBodies");
+		BulletAllocator::ScopedArena arenaScope(m_arena.get());
+		for (size_t i = 0; i < count; i++)
+		{
+			const BodyDesc& desc = descs[i];
+			const Entity entity = createEntity();
+			addMotionState(entity, desc.transform);
+			setCollider(entity, desc.collider);
+			if (desc.layer != DEFAULT_COLLISION_LAYER)
+			{
+				//set before the rigidBody so it enters the broadphase once, with its filter
+				m_collisionLayerPool.add(entity, desc.layer);
+			}
+			addRigidBody(entity, desc.mass, desc.restitution);
+			entities[i] = entity;
+		}
+	}
+
+	bool PhysicsWorld::getBodyDesc(Entity entity, BodyDesc& desc) const
+	{
+		const btRigidBody* rigidBody = getRigidBody(entity);
+		if (!rigidBody || !describeCollider(rigidBody->getCollisionShape(), desc.collider))
+		{
+			return false;
+		}
+		desc.transform = rigidBody->getWorldTransform();
+		desc.mass = rigidBody->getInvMass() != 0 ? 1.0f / rigidBody->getInvMass() : 0.0f;
+		desc.restitution = rigidBody->getRestitution();
+		desc.layer = getCollisionLayer(entity);
+		return true;
+	}
+
+	BodyPrefab PhysicsWorld::makeBodyPrefab(const ColliderDesc& collider, float mass, float restitution, collision_layer_t layer)
+	{
+		assert(layer < MAX_COLLISION_LAYERS && "Collision layer out of bounds.");
+		BulletAllocator::ScopedArena arenaScope(m_arena.get());
+		BodyPrefab prefab;
+		prefab.shape = m_collisionShapeContainer.acquire(collider);
+		if (mass != 0.0f)
+		{
+			prefab.shape->calculateLocalInertia(mass, prefab.localInertia);
+		}
+		prefab.mass = mass;
+		prefab.restitution = restitution;
+		prefab.layer = layer;
+		return prefab;
+	}
+
+	void PhysicsWorld::addPrefabInstances(Span<const BodyPrefab> prefabs, const uint32_t* prefabIndices, const float* positions, const float* rotations, size_t count, Entity* entities)
+	{
+		BULLET_ECS_TRACE_SCOPE("PhysicsWorld::addPrefabInstances");
+		BulletAllocator::ScopedArena arenaScope(m_arena.get());
+		for (size_t i = 0; i < count; i++)
+		{
+			const BodyPrefab& prefab = prefabs[prefabIndices[i]];
+			const float* position = positions + 3 * i;
+			const float* rotation = rotations + 4 * i;
+
+			const Entity entity = createEntity();
+			btDefaultMotionState* motionState = m_motionStatePool.add(entity, btTransform(btQuaternion(rotation[0], rotation[1], rotation[2], rotation[3]), btVector3(position[0], position[1], position[2])));
+			m_collisionShapeContainer.assign(entity, prefab.shape);
+			if (prefab.layer != DEFAULT_COLLISION_LAYER)
+			{
+				m_collisionLayerPool.add(entity, prefab.layer);
+			}
+
+			btRigidBody::btRigidBodyConstructionInfo rbData(prefab.mass, motionState, prefab.shape.get(), prefab.localInertia);
+			rbData.m_restitution = prefab.restitution;
+			btRigidBody* rigidBody = m_rigidBodyPool.add(entity, rbData);
+			setCollisionObjectEntity(rigidBody, entity);
+			addRigidBodyToWorld(rigidBody, prefab.layer);
+			m_activeRigidBodies.assign(entity.ID, rigidBody->isActive());
+			m_dynamicRigidBodies.assign(entity.ID, !rigidBody->isStaticOrKinematicObject());
+			if (entities)
+			{
+				entities[i] = entity;
+			}
+		}
+	}
+
+	void PhysicsWorld::addRigidBodyToWorld(btRigidBody* rigidBody, collision_layer_t layer)
+	{
+		//the layer is the body's only filter group and the matrix row is its mask
+		m_dynamicsWorld->addRigidBody(rigidBody, static_cast<int>(CollisionLayerMatrix::layerBit(layer)), static_cast<int>(m_collisionLayers.getMask(layer)));
+	}
+
+
+
+	void PhysicsWorld::addTriggerToWorld(TriggerGhostObject* trigger, collision_layer_t layer)
+	{
+		m_dynamicsWorld->addCollisionObject(trigger, static_cast<int>(CollisionLayerMatrix::layerBit(layer)), static_cast<int>(m_collisionLayers.getMask(layer)));
+	}
+
+
+
 	void PhysicsWorld::removeMotionState(Entity entity)
 	{
 		assert(!m_rigidBodyPool.has(entity) && "Cannot remove MotionState before RigidBody. Remove RigidBody first");
@@ -131,28 +1370,115 @@ namespace BulletECS
 	void PhysicsWorld::removeCollider(Entity entity)
 	{
 		assert(!m_rigidBodyPool.has(entity) && "Cannot remove Collider before RigidBody. Remove RigidBody first");
+		assert(!m_triggerPool.has(entity) && "Cannot remove Collider before Trigger. Remove Trigger first");
 		m_collisionShapeContainer.remove(entity);
 	}
 
 	void PhysicsWorld::removeRigidBody(Entity entity)
 	{
+		BULLET_ECS_TRACE_SCOPE("PhysicsWorld::removeRigidBody");
+		BulletAllocator::ScopedArena arenaScope(m_arena.get());
 		btRigidBody* rigidBody = getRigidBody(entity);
 		assert(rigidBody && "Cannot remove non existent RigidBody.");
+		removeAllJoints(entity); //Bullet constraints keep references to both bodies
+		if (m_simulationLodPool.has(entity))
+		{
+			removeSimulationLod(entity);
+		}
 		m_dynamicsWorld->removeRigidBody(rigidBody);
 		m_rigidBodyPool.remove(entity);
+		m_activeRigidBodies.reset(entity.ID);
+		m_dynamicRigidBodies.reset(entity.ID);
+	}
+
+	void PhysicsWorld::removeTrigger(Entity entity)
+	{
+		BulletAllocator::ScopedArena arenaScope(m_arena.get());
+		TriggerGhostObject* trigger = getTrigger(entity);
+		assert(trigger && "Cannot remove non existent Trigger.");
+		//removing the proxy removes its pairs, which pushes an exit event for every entity still inside
+		m_dynamicsWorld->removeCollisionObject(trigger);
+		m_triggerPool.remove(entity);
 	}
 
 	void PhysicsWorld::removeTag(Entity entity)
 	{
+		const TagComponent* tag = m_tagPool.get(entity);
+		assert(tag && "Cannot remove non existent tag.");
+		m_tagTable.remove(entity, tag->id);
 		m_tagPool.remove(entity);
 	}
 
+	void PhysicsWorld::removeJoint(Entity entity, JointType type)
+	{
+		BulletAllocator::ScopedArena arenaScope(m_arena.get());
+		btTypedConstraint* constraint = getJoint(entity, type);
+		assert(constraint && "Cannot remove non existent Joint.");
+		m_dynamicsWorld->removeConstraint(constraint);
+		m_jointLinks.unlink(entity.ID, type);
+
+		switch (type)
+		{
+		case JointType::PointToPoint: m_pointToPointJointPool.remove(entity); break;
+		case JointType::Hinge: m_hingeJointPool.remove(entity); break;
+		case JointType::Slider: m_sliderJointPool.remove(entity); break;
+		case JointType::Generic6Dof: m_generic6DofJointPool.remove(entity); break;
+		default: assert(false && "Unknown JointType."); break;
+		}
+	}
+
+	void PhysicsWorld::removeAllJoints(Entity entity)
+	{
+		for (uint8_t type = 0; type < static_cast<uint8_t>(JointType::Count); type++)
+		{
+			if (getJoint(entity, static_cast<JointType>(type)))
+			{
+				removeJoint(entity, static_cast<JointType>(type));
+			}
+		}
+
+		JointLinks::JointKey attached = m_jointLinks.firstJointOn(entity.ID);
+		while (attached.owner != NULL_ENTITY)
+		{
+			removeJoint(Entity{ attached.owner, 0 }, attached.type);
+			attached = m_jointLinks.firstJointOn(entity.ID);
+		}
+	}
+
+	void PhysicsWorld::removeCollisionLayer(Entity entity)
+	{
+		BulletAllocator::ScopedArena arenaScope(m_arena.get());
+		m_collisionLayerPool.remove(entity);
+		if (btRigidBody* rigidBody = getRigidBody(entity))
+		{
+			m_dynamicsWorld->removeRigidBody(rigidBody);
+			addRigidBodyToWorld(rigidBody, DEFAULT_COLLISION_LAYER);
+		}
+		if (TriggerGhostObject* trigger = getTrigger(entity))
+		{
+			m_dynamicsWorld->removeCollisionObject(trigger);
+			addTriggerToWorld(trigger, DEFAULT_COLLISION_LAYER);
+		}
+	}
+
 	void PhysicsWorld::destroyEntity(Entity entity)
 	{
+		BULLET_ECS_TRACE_SCOPE("PhysicsWorld::destroyEntity");
+		BulletAllocator::ScopedArena arenaScope(m_arena.get());
+		//pool iterators yield version 0 handles, they name the live entity with that ID
+		if (entity.version == 0)
+		{
+			entity = m_entityManager.getEntity(entity.ID);
+		}
+		onEntityDestroyed(entity);
 		if (m_rigidBodyPool.has(entity))
 		{
 			removeRigidBody(entity);
 		}
+		if (m_triggerPool.has(entity))
+		{
+			removeTrigger(entity);
+		}
 		if (m_collisionShapeContainer.has(entity))
 		{
 			removeCollider(entity);
@@ -165,7 +1491,12 @@ namespace BulletECS
 		{
 			removeTag(entity);
 		}
+		if (m_collisionLayerPool.has(entity))
+		{
+			removeCollisionLayer(entity);
+		}
 		m_entityManager.destroyEntity(entity);
+		m_currentStepStats.entitiesDestroyed++;
 	}
 
 	btDefaultMotionState* PhysicsWorld::getMotionState(Entity entity)
@@ -198,14 +1529,57 @@ namespace BulletECS
 		return m_rigidBodyPool.get(entity);
 	}
 
+	TriggerGhostObject* PhysicsWorld::getTrigger(Entity entity)
+	{
+		return m_triggerPool.get(entity);
+	}
+
+	const TriggerGhostObject* PhysicsWorld::getTrigger(const Entity entity) const
+	{
+		return m_triggerPool.get(entity);
+	}
+
+	btTypedConstraint* PhysicsWorld::getJoint(Entity entity, JointType type)
+	{
+		switch (type)
+		{
+		case JointType::PointToPoint: return m_pointToPointJointPool.get(entity);
+		case JointType::Hinge: return m_hingeJointPool.get(entity);
+		case JointType::Slider: return m_sliderJointPool.get(entity);
+		case JointType::Generic6Dof: return m_generic6DofJointPool.get(entity);
+		default: return nullptr;
+		}
+	}
+
+	const btTypedConstraint* PhysicsWorld::getJoint(Entity entity, JointType type) const
+	{
+		switch (type)
+		{
+		case JointType::PointToPoint: return m_pointToPointJointPool.get(entity);
+		case JointType::Hinge: return m_hingeJointPool.get(entity);
+		case JointType::Slider: return m_sliderJointPool.get(entity);
+		case JointType::Generic6Dof: return m_generic6DofJointPool.get(entity);
+		default: return nullptr;
+		}
+	}
+
 	const std::string& PhysicsWorld::getTag(Entity entity) const
 	{
 		if (auto* tag = m_tagPool.get(entity))
 		{
-			return tag->name;
+			return m_tagTable.getName(tag->id);
 		}
 		return NO_TAG;
 	}
 
+	tag_id_t PhysicsWorld::getTagId(Entity entity) const
+	{
+		if (auto* tag = m_tagPool.get(entity))
+		{
+			return tag->id;
+		}
+		return NO_TAG_ID;
+	}
+
 
 }
\ No newline at end of file
@@ -0,0 +1,575 @@
+#include "BulletECS/Replay.h"
+#include "BulletECS/PhysicsWorld.h"
+#include "BulletECS/TriggerComponent.h"
+#include "BulletECS/Trace.h"
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <cassert>
+
+namespace BulletECS
+{
+	using Clock = std::chrono::steady_clock;
+	using Milliseconds = std::chrono::duration<double, std::milli>;
+
+	// File layout, numbers in the machine's byte order:
+	//	FileHeader | frames
+	// A frame is a uint32 payload size then the payload: uint8 FrameType | uint64 step | body.
+	// Keyframe body: varint count, then per body in ID order: varint ID delta, varint version, zigzag varint position[3] and rotation[4].
+	// Delta body: uint32 removed count, varint ID deltas | uint32 record count, then per record in ID order: varint (ID delta << 1 | isNew),
+	// new records (added bodies and reused IDs) are a keyframe record without its ID, others are zigzag varint differences to the previous frame
+	namespace
+	{
+		constexpr char REPLAY_MAGIC[4] = { 'B', 'E', 'R', 'P' };
+		constexpr uint32_t REPLAY_VERSION = 1;
+		constexpr float ROTATION_SCALE = 32767.0f;
+
+		struct FileHeader
+		{
+			char magic[4];
+			uint32_t version;
+			float positionPrecision;
+			uint32_t keyframeInterval;
+			uint32_t idCount; //bodies have IDs below it
+			uint32_t padding;
+		};
+		static_assert(sizeof(FileHeader) == 24, "The replay header is read as raw bytes, it must not have hidden padding.");
+
+		enum class FrameType : uint8_t
+		{
+			Keyframe,
+			Delta
+		};
+
+		constexpr size_t FRAME_SIZE_BYTES = sizeof(uint32_t);
+		constexpr size_t FRAME_HEADER_BYTES = sizeof(uint8_t) + sizeof(uint64_t);
+
+		inline uint64_t zigzag(int64_t value) { return (uint64_t(value) << 1) ^ uint64_t(value >> 63); }
+		inline int64_t unzigzag(uint64_t value) { return int64_t(value >> 1) ^ -int64_t(value & 1); }
+
+		inline void writeVarint(std::vector<uint8_t>& buffer, uint64_t value)
+		{
+			while (value >= 0x80)
+			{
+				buffer.push_back(static_cast<uint8_t>(value | 0x80));
+				value >>= 7;
+			}
+			buffer.push_back(static_cast<uint8_t>(value));
+		}
+
+		template <class T>
+		inline void writeRaw(std::vector<uint8_t>& buffer, T value)
+		{
+			const size_t at = buffer.size();
+			buffer.resize(at + sizeof(T));
+			std::memcpy(buffer.data() + at, &value, sizeof(T));
+		}
+
+		template <class T>
+		inline void patchRaw(std::vector<uint8_t>& buffer, size_t at, T value)
+		{
+			std::memcpy(buffer.data() + at, &value, sizeof(T));
+		}
+
+		//bounds checked reads over a frame payload, a failed read leaves ok false and returns 0
+		struct Reader
+		{
+			const uint8_t* data;
+			const uint8_t* end;
+			bool ok = true;
+
+			uint64_t varint()
+			{
+				uint64_t value = 0;
+				for (unsigned shift = 0; shift < 64; shift += 7)
+				{
+					if (data == end)
+					{
+						break;
+					}
+					const uint8_t byte = *data++;
+					value |= uint64_t(byte & 0x7f) << shift;
+					if (!(byte & 0x80))
+					{
+						return value;
+					}
+				}
+				ok = false;
+				return 0;
+			}
+
+			template <class T>
+			T raw()
+			{
+				T value{};
+				if (size_t(end - data) < sizeof(T))
+				{
+					ok = false;
+					return value;
+				}
+				std::memcpy(&value, data, sizeof(T));
+				data += sizeof(T);
+				return value;
+			}
+		};
+
+		inline int32_t quantizePosition(btScalar value, float precision)
+		{
+			const double q = std::round(double(value) / precision);
+			return static_cast<int32_t>(std::max(-2147483647.0, std::min(2147483647.0, q)));
+		}
+
+		//q and -q are the same rotation, w >= 0 keeps consecutive frames close so their deltas stay small
+		inline void quantizeRotation(btQuaternion rotation, int16_t out[4])
+		{
+			rotation.normalize();
+			const btScalar sign = rotation.w() < 0 ? btScalar(-1) : btScalar(1);
+			for (int i = 0; i < 4; i++)
+			{
+				out[i] = static_cast<int16_t>(std::lround(rotation[i] * sign * ROTATION_SCALE));
+			}
+		}
+	}
+
+	ReplayRecorder::ReplayRecorder(PhysicsWorld& world, const std::string& path, const ReplaySettings& settings)
+		: m_world(world),
+		  m_settings(settings),
+		  m_recorded(world.iterateEntitiesWithRigidBodies().getEntitiesMask().size()),
+		  m_wasActive(world.getActiveRigidBodiesMask().size()),
+		  m_last(world.iterateEntitiesWithRigidBodies().getEntitiesMask().size()),
+		  m_file(path, std::ios::binary | std::ios::trunc)
+	{
+		assert(settings.positionPrecision > 0.0f && "The replay position precision must be positive.");
+		assert(settings.keyframeInterval > 0 && "The replay keyframe interval must be at least 1.");
+		if (!m_file)
+		{
+			return;
+		}
+		FileHeader header{};
+		std::memcpy(header.magic, REPLAY_MAGIC, sizeof(header.magic));
+		header.version = REPLAY_VERSION;
+		header.positionPrecision = settings.positionPrecision;
+		header.keyframeInterval = settings.keyframeInterval;
+		header.idCount = static_cast<uint32_t>(m_recorded.size());
+		m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		m_isOpen = static_cast<bool>(m_file);
+		if (!m_isOpen)
+		{
+			return;
+		}
+		m_listenerId = m_world.addStepListener([this](PhysicsWorld&, const StepStats& stats) { recordFrame(stats.frame); });
+		m_writer = std::thread(&ReplayRecorder::writerLoop, this);
+	}
+
+	ReplayRecorder::~ReplayRecorder()
+	{
+		if (!m_isOpen)
+		{
+			return;
+		}
+		m_world.removeStepListener(m_listenerId);
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stopping = true;
+		}
+		m_wakeWriter.notify_one();
+		m_writer.join();
+	}
+
+	void ReplayRecorder::encodeBody(std::vector<uint8_t>& buffer, uint32_t id, bool isNew)
+	{
+		const btRigidBody* rigidBody = m_world.iterateEntitiesWithRigidBodies().get(Entity{ id, 0 });
+		const btTransform& transform = rigidBody->getWorldTransform();
+		QuantizedTransform current;
+		current.version = getCollisionObjectEntity(rigidBody).version;
+		for (int i = 0; i < 3; i++)
+		{
+			current.position[i] = quantizePosition(transform.getOrigin()[i], m_settings.positionPrecision);
+		}
+		quantizeRotation(transform.getRotation(), current.rotation);
+
+		QuantizedTransform& last = m_last[id];
+		if (!isNew)
+		{
+			//a destroyed body whose ID was reused within one step
+			isNew = last.version != current.version;
+		}
+		if (!isNew && std::memcmp(last.position, current.position, sizeof(current.position)) == 0 &&
+			std::memcmp(last.rotation, current.rotation, sizeof(current.rotation)) == 0)
+		{
+			return;
+		}
+
+		writeVarint(buffer, (uint64_t(id - m_previousId) << 1) | (isNew ? 1 : 0));
+		m_previousId = id;
+		if (isNew)
+		{
+			writeVarint(buffer, current.version);
+			for (int i = 0; i < 3; i++)
+			{
+				writeVarint(buffer, zigzag(current.position[i]));
+			}
+			for (int i = 0; i < 4; i++)
+			{
+				writeVarint(buffer, zigzag(current.rotation[i]));
+			}
+		}
+		else
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				writeVarint(buffer, zigzag(int64_t(current.position[i]) - last.position[i]));
+			}
+			for (int i = 0; i < 4; i++)
+			{
+				writeVarint(buffer, zigzag(int64_t(current.rotation[i]) - last.rotation[i]));
+			}
+		}
+		last = current;
+		m_stats.bodyRecords++;
+		m_stats.rawBytes += sizeof(Entity) + 7 * sizeof(float);
+	}
+
+	void ReplayRecorder::recordFrame(uint64_t step)
+	{
+		if (!m_isOpen)
+		{
+			return;
+		}
+		BULLET_ECS_TRACE_SCOPE("ReplayRecorder::recordFrame");
+		const Clock::time_point start = Clock::now();
+
+		std::vector<uint8_t> buffer;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (!m_freeBuffers.empty())
+			{
+				buffer = std::move(m_freeBuffers.back());
+				m_freeBuffers.pop_back();
+			}
+			m_stats.writtenBytes = m_writtenBytes;
+		}
+
+		const EntityBitset& bodies = m_world.iterateEntitiesWithRigidBodies().getEntitiesMask();
+		const EntityBitset& active = m_world.getActiveRigidBodiesMask();
+		const bool keyframe = m_stats.frames % m_settings.keyframeInterval == 0;
+		writeRaw<uint32_t>(buffer, 0); //patched once the payload size is known
+		writeRaw(buffer, keyframe ? FrameType::Keyframe : FrameType::Delta);
+		writeRaw(buffer, step);
+		m_previousId = 0;
+
+		if (keyframe)
+		{
+			writeVarint(buffer, bodies.count());
+			for (size_t id = bodies.findNext(0, bodies.size() - 1); id < bodies.size(); id = bodies.findNext(id + 1, bodies.size() - 1))
+			{
+				encodeBody(buffer, static_cast<uint32_t>(id), true);
+			}
+			m_recorded = bodies;
+			m_stats.keyframes++;
+		}
+		else
+		{
+			const size_t removedCountAt = buffer.size();
+			uint32_t removedCount = 0;
+			writeRaw(buffer, removedCount);
+			for (size_t w = 0; w < bodies.wordCount(); w++)
+			{
+				for (EntityBitset::Word removed = m_recorded.word(w) & ~bodies.word(w); removed; removed &= removed - 1)
+				{
+					const uint32_t id = static_cast<uint32_t>(w * EntityBitset::BITS_PER_WORD + EntityBitset::countTrailingZeros(removed));
+					writeVarint(buffer, id - m_previousId);
+					m_previousId = id;
+					m_recorded.reset(id);
+					removedCount++;
+				}
+			}
+			patchRaw(buffer, removedCountAt, removedCount);
+
+			//bodies that fell asleep during this step moved before their last state, so they are visited once more
+			const size_t recordCountAt = buffer.size();
+			const uint64_t recordsBefore = m_stats.bodyRecords;
+			writeRaw<uint32_t>(buffer, 0);
+			m_previousId = 0;
+			for (size_t w = 0; w < bodies.wordCount(); w++)
+			{
+				const EntityBitset::Word current = bodies.word(w);
+				const EntityBitset::Word added = current & ~m_recorded.word(w);
+				for (EntityBitset::Word visit = added | (current & (active.word(w) | m_wasActive.word(w))); visit; visit &= visit - 1)
+				{
+					const unsigned bit = EntityBitset::countTrailingZeros(visit);
+					const uint32_t id = static_cast<uint32_t>(w * EntityBitset::BITS_PER_WORD + bit);
+					encodeBody(buffer, id, (added >> bit) & 1);
+					m_recorded.set(id);
+				}
+			}
+			patchRaw(buffer, recordCountAt, static_cast<uint32_t>(m_stats.bodyRecords - recordsBefore));
+		}
+		m_wasActive = active;
+		patchRaw(buffer, 0, static_cast<uint32_t>(buffer.size() - FRAME_SIZE_BYTES));
+
+		m_stats.frames++;
+		m_stats.encodedBytes += buffer.size();
+		m_stats.rawBytes += FRAME_SIZE_BYTES + FRAME_HEADER_BYTES;
+		m_stats.lastEncodeTime = Milliseconds(Clock::now() - start).count();
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_queue.push_back(std::move(buffer));
+		}
+		m_wakeWriter.notify_one();
+	}
+
+	void ReplayRecorder::flush()
+	{
+		if (!m_isOpen)
+		{
+			return;
+		}
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_bufferWritten.wait(lock, [this] { return m_queue.empty() && !m_writing; });
+		m_stats.writtenBytes = m_writtenBytes;
+	}
+
+	void ReplayRecorder::writerLoop()
+	{
+		BULLET_ECS_TRACE_THREAD_NAME("BulletECS replay writer");
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (true)
+		{
+			m_wakeWriter.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+			if (m_queue.empty())
+			{
+				break; //stopping, and every frame is written
+			}
+			std::vector<uint8_t> buffer = std::move(m_queue.front());
+			m_queue.pop_front();
+			m_writing = true;
+			const bool lastQueued = m_queue.empty(); //read under the lock, the stepping thread pushes while this one writes
+			lock.unlock();
+
+			{
+				BULLET_ECS_TRACE_SCOPE("ReplayRecorder::write");
+				m_file.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+				if (lastQueued)
+				{
+					m_file.flush();
+				}
+			}
+
+			lock.lock();
+			m_writing = false;
+			m_writtenBytes += buffer.size();
+			buffer.clear();
+			m_freeBuffers.push_back(std::move(buffer));
+			m_bufferWritten.notify_all();
+		}
+		m_file.flush();
+	}
+
+	bool ReplayPlayer::open(const std::string& path)
+	{
+		BULLET_ECS_TRACE_SCOPE("ReplayPlayer::open");
+		m_frames.clear();
+		m_keyframes.clear();
+		m_bodies.clear();
+		if (!m_file.open(path) || m_file.size() < sizeof(FileHeader))
+		{
+			return false;
+		}
+		FileHeader header;
+		std::memcpy(&header, m_file.data(), sizeof(header));
+		if (std::memcmp(header.magic, REPLAY_MAGIC, sizeof(header.magic)) != 0 || header.version != REPLAY_VERSION ||
+			!(header.positionPrecision > 0.0f) || header.idCount == 0)
+		{
+			m_file.close();
+			return false;
+		}
+		m_positionPrecision = header.positionPrecision;
+		m_present = EntityBitset(header.idCount);
+		m_positions.assign(size_t(header.idCount) * 3, 0);
+		m_rotations.assign(size_t(header.idCount) * 4, 0);
+		m_versions.assign(header.idCount, 0);
+
+		//a frame cut short by a crash ends the index, the frames before it still play
+		size_t offset = sizeof(FileHeader);
+		while (m_file.size() - offset >= FRAME_SIZE_BYTES + FRAME_HEADER_BYTES)
+		{
+			uint32_t size;
+			std::memcpy(&size, m_file.data() + offset, sizeof(size));
+			offset += FRAME_SIZE_BYTES;
+			if (size < FRAME_HEADER_BYTES || size > m_file.size() - offset)
+			{
+				break;
+			}
+			FrameIndex frame;
+			frame.offset = offset;
+			frame.size = size;
+			frame.keyframe = static_cast<FrameType>(m_file.data()[offset]) == FrameType::Keyframe;
+			std::memcpy(&frame.step, m_file.data() + offset + sizeof(uint8_t), sizeof(frame.step));
+			if (frame.keyframe)
+			{
+				m_keyframes.push_back(m_frames.size());
+			}
+			m_frames.push_back(frame);
+			offset += size;
+		}
+		m_currentFrame = m_frames.size();
+		return true;
+	}
+
+	bool ReplayPlayer::decodeFrame(size_t frame)
+	{
+		const FrameIndex& index = m_frames[frame];
+		Reader reader{ m_file.data() + index.offset + FRAME_HEADER_BYTES, m_file.data() + index.offset + index.size };
+		const size_t idCount = m_versions.size();
+		uint64_t id = 0;
+
+		auto readAbsolute = [&](size_t bodyId)
+		{
+			m_versions[bodyId] = static_cast<entity_version_t>(reader.varint());
+			for (int i = 0; i < 3; i++)
+			{
+				m_positions[bodyId * 3 + i] = static_cast<int32_t>(unzigzag(reader.varint()));
+			}
+			for (int i = 0; i < 4; i++)
+			{
+				m_rotations[bodyId * 4 + i] = static_cast<int16_t>(unzigzag(reader.varint()));
+			}
+			m_present.set(bodyId);
+		};
+
+		if (index.keyframe)
+		{
+			m_present.clear();
+			const uint64_t count = reader.varint();
+			for (uint64_t i = 0; i < count && reader.ok; i++)
+			{
+				id += reader.varint();
+				if (id >= idCount)
+				{
+					return false;
+				}
+				readAbsolute(static_cast<size_t>(id));
+			}
+			return reader.ok;
+		}
+
+		const uint32_t removedCount = reader.raw<uint32_t>();
+		for (uint32_t i = 0; i < removedCount && reader.ok; i++)
+		{
+			id += reader.varint();
+			if (id >= idCount)
+			{
+				return false;
+			}
+			m_present.reset(static_cast<size_t>(id));
+		}
+		id = 0;
+		const uint32_t recordCount = reader.raw<uint32_t>();
+		for (uint32_t i = 0; i < recordCount && reader.ok; i++)
+		{
+			const uint64_t key = reader.varint();
+			id += key >> 1;
+			if (id >= idCount)
+			{
+				return false;
+			}
+			const size_t bodyId = static_cast<size_t>(id);
+			if (key & 1)
+			{
+				readAbsolute(bodyId);
+				continue;
+			}
+			if (!m_present[bodyId])
+			{
+				return false;
+			}
+			for (int c = 0; c < 3; c++)
+			{
+				m_positions[bodyId * 3 + c] = static_cast<int32_t>(m_positions[bodyId * 3 + c] + unzigzag(reader.varint()));
+			}
+			for (int c = 0; c < 4; c++)
+			{
+				m_rotations[bodyId * 4 + c] = static_cast<int16_t>(m_rotations[bodyId * 4 + c] + unzigzag(reader.varint()));
+			}
+		}
+		return reader.ok;
+	}
+
+	void ReplayPlayer::rebuildBodies()
+	{
+		m_bodies.clear();
+		for (size_t id = m_present.findNext(0, m_present.size() - 1); id < m_present.size(); id = m_present.findNext(id + 1, m_present.size() - 1))
+		{
+			btTransform transform;
+			getTransform(static_cast<entity_id_t>(id), transform);
+			m_bodies.push_back(ReplayBody{ Entity{ static_cast<entity_id_t>(id), m_versions[id] }, transform.getOrigin(), transform.getRotation() });
+		}
+	}
+
+	bool ReplayPlayer::seek(size_t frame)
+	{
+		if (frame >= m_frames.size())
+		{
+			return false;
+		}
+		BULLET_ECS_TRACE_SCOPE("ReplayPlayer::seek");
+		auto keyframe = std::upper_bound(m_keyframes.begin(), m_keyframes.end(), frame);
+		if (keyframe == m_keyframes.begin())
+		{
+			return false; //frames before the first keyframe cannot be rebuilt
+		}
+		//decoding forward from the current frame is cheaper when no keyframe lies between
+		size_t first = *(keyframe - 1);
+		if (m_currentFrame < m_frames.size() && m_currentFrame >= first && m_currentFrame <= frame)
+		{
+			first = m_currentFrame + 1;
+		}
+		for (size_t i = first; i <= frame; i++)
+		{
+			if (!decodeFrame(i))
+			{
+				m_currentFrame = m_frames.size();
+				m_present.clear();
+				m_bodies.clear();
+				return false;
+			}
+		}
+		m_currentFrame = frame;
+		rebuildBodies();
+		return true;
+	}
+
+	bool ReplayPlayer::next()
+	{
+		return seek(m_currentFrame < m_frames.size() ? m_currentFrame + 1 : 0);
+	}
+
+	bool ReplayPlayer::seekToStep(uint64_t step)
+	{
+		auto it = std::upper_bound(m_frames.begin(), m_frames.end(), step, [](uint64_t s, const FrameIndex& frame) { return s < frame.step; });
+		if (it == m_frames.begin())
+		{
+			return false;
+		}
+		return seek(static_cast<size_t>(it - m_frames.begin()) - 1);
+	}
+
+	bool ReplayPlayer::getTransform(entity_id_t id, btTransform& transform) const
+	{
+		if (id >= m_present.size() || !m_present[id])
+		{
+			return false;
+		}
+		const int32_t* position = &m_positions[size_t(id) * 3];
+		const int16_t* rotation = &m_rotations[size_t(id) * 4];
+		btQuaternion q(rotation[0] / ROTATION_SCALE, rotation[1] / ROTATION_SCALE, rotation[2] / ROTATION_SCALE, rotation[3] / ROTATION_SCALE);
+		q.normalize();
+		transform.setRotation(q);
+		transform.setOrigin(btVector3(btScalar(double(position[0]) * m_positionPrecision),
+									  btScalar(double(position[1]) * m_positionPrecision),
+									  btScalar(double(position[2]) * m_positionPrecision)));
+		return true;
+	}
+}
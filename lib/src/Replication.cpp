@@ -0,0 +1,633 @@
+#include "BulletECS/Replication.h"
+#include "BulletECS/PhysicsWorld.h"
+#include "BulletECS/ThreadPool.h"
+#include "BulletECS/TriggerComponent.h"
+#include "BulletECS/Trace.h"
+#include "BulletECS/Containers/EntityBitset.h"
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <cassert>
+
+namespace BulletECS
+{
+	using Clock = std::chrono::steady_clock;
+	using Milliseconds = std::chrono::duration<double, std::milli>;
+
+	// Snapshot layout: a 16 byte header (uint32 sequence, baseline sequence or 0, removed count, record count, in the machine's byte order)
+	// then a bit stream, least significant bit first:
+	//	removed: unsigned ID delta per entity
+	//	records: unsigned ID delta | 1 bit isNew |
+	//		new: 16 bit version | position | 32 bit rotation
+	//		changed: position delta | 1 bit rotation changed | 32 bit rotation if set
+	// Unsigned values are a 6 bit width then that many bits, positions are one 6 bit width then three zigzag values of that width.
+	// ID deltas start from 0 in each list, entity IDs are never 0
+	namespace
+	{
+		constexpr size_t HEADER_BYTES = 4 * sizeof(uint32_t);
+		constexpr unsigned WIDTH_BITS = 6;
+		constexpr unsigned VERSION_BITS = 16;
+		constexpr unsigned ROTATION_BITS = 32;
+		constexpr float ROTATION_COMPONENT_SCALE = 1023.0f; //10 bits per smallest component
+		constexpr float SQRT_HALF = 0.70710678f; //bound of the three smallest components of a unit quaternion
+
+		inline uint64_t zigzag(int64_t value) { return (uint64_t(value) << 1) ^ uint64_t(value >> 63); }
+		inline int64_t unzigzag(uint64_t value) { return int64_t(value >> 1) ^ -int64_t(value & 1); }
+
+		inline unsigned bitWidth(uint64_t value)
+		{
+			return value ? static_cast<unsigned>(EntityBitset::BITS_PER_WORD - EntityBitset::countLeadingZeros(value)) : 0;
+		}
+
+		//writes into a caller buffer, a write that does not fit fails and leaves the stream as it was
+		struct BitWriter
+		{
+			uint8_t* data;
+			size_t capacityBits;
+			size_t bitPos = 0;
+
+			bool write(uint64_t value, unsigned bits)
+			{
+				if (bits > capacityBits - bitPos)
+				{
+					return false;
+				}
+				while (bits > 0)
+				{
+					const size_t byte = bitPos / 8;
+					const unsigned offset = static_cast<unsigned>(bitPos % 8);
+					if (offset == 0)
+					{
+						data[byte] = 0;
+					}
+					const unsigned count = std::min(bits, 8u - offset);
+					data[byte] |= static_cast<uint8_t>((value & ((1u << count) - 1)) << offset);
+					value >>= count;
+					bits -= count;
+					bitPos += count;
+				}
+				return true;
+			}
+
+			bool writeUnsigned(uint64_t value)
+			{
+				const unsigned width = bitWidth(value);
+				return write(width, WIDTH_BITS) && write(value, width);
+			}
+
+			bool writePosition(const int64_t values[3])
+			{
+				const uint64_t zigzags[3] = { zigzag(values[0]), zigzag(values[1]), zigzag(values[2]) };
+				const unsigned width = bitWidth(zigzags[0] | zigzags[1] | zigzags[2]);
+				return write(width, WIDTH_BITS) && write(zigzags[0], width) && write(zigzags[1], width) && write(zigzags[2], width);
+			}
+
+			//drops what was written after position
+			void rewind(size_t position)
+			{
+				bitPos = position;
+				if (bitPos % 8)
+				{
+					data[bitPos / 8] &= static_cast<uint8_t>((1u << (bitPos % 8)) - 1);
+				}
+			}
+
+			size_t bytes() const { return (bitPos + 7) / 8; }
+		};
+
+		//reads past the end leave ok false and return 0
+		struct BitReader
+		{
+			const uint8_t* data;
+			size_t sizeBits;
+			size_t bitPos = 0;
+			bool ok = true;
+
+			uint64_t read(unsigned bits)
+			{
+				if (bits > sizeBits - bitPos)
+				{
+					ok = false;
+					return 0;
+				}
+				uint64_t value = 0;
+				unsigned shift = 0;
+				while (bits > 0)
+				{
+					const unsigned offset = static_cast<unsigned>(bitPos % 8);
+					const unsigned count = std::min(bits, 8u - offset);
+					value |= uint64_t((data[bitPos / 8] >> offset) & ((1u << count) - 1)) << shift;
+					shift += count;
+					bits -= count;
+					bitPos += count;
+				}
+				return value;
+			}
+
+			uint64_t readUnsigned()
+			{
+				return read(static_cast<unsigned>(read(WIDTH_BITS)));
+			}
+
+			void readPosition(int64_t values[3])
+			{
+				const unsigned width = static_cast<unsigned>(read(WIDTH_BITS));
+				for (int i = 0; i < 3; i++)
+				{
+					values[i] = unzigzag(read(width));
+				}
+			}
+		};
+
+		inline int32_t quantizePosition(btScalar value, float precision)
+		{
+			const double q = std::round(double(value) / precision);
+			return static_cast<int32_t>(std::max(-2147483647.0, std::min(2147483647.0, q)));
+		}
+
+		//2 bits for the index of the largest component, which is rebuilt from the others, then 10 bits for each other component
+		uint32_t packRotation(btQuaternion rotation)
+		{
+			rotation.normalize();
+			int largest = 0;
+			for (int i = 1; i < 4; i++)
+			{
+				if (std::fabs(rotation[i]) > std::fabs(rotation[largest]))
+				{
+					largest = i;
+				}
+			}
+			//q and -q are the same rotation, the largest component is kept positive
+			const btScalar sign = rotation[largest] < 0 ? btScalar(-1) : btScalar(1);
+			uint32_t packed = static_cast<uint32_t>(largest);
+			unsigned shift = 2;
+			for (int i = 0; i < 4; i++)
+			{
+				if (i == largest)
+				{
+					continue;
+				}
+				const float normalized = float(rotation[i] * sign) / SQRT_HALF * 0.5f + 0.5f;
+				const long component = std::lround(normalized * ROTATION_COMPONENT_SCALE);
+				packed |= static_cast<uint32_t>(std::max(0L, std::min(1023L, component))) << shift;
+				shift += 10;
+			}
+			return packed;
+		}
+
+		btQuaternion unpackRotation(uint32_t packed)
+		{
+			const int largest = static_cast<int>(packed & 3);
+			btScalar components[4];
+			btScalar sumSquares = 0;
+			unsigned shift = 2;
+			for (int i = 0; i < 4; i++)
+			{
+				if (i == largest)
+				{
+					continue;
+				}
+				const float normalized = float((packed >> shift) & 0x3FF) / ROTATION_COMPONENT_SCALE;
+				components[i] = (normalized - 0.5f) * 2.0f * SQRT_HALF;
+				sumSquares += components[i] * components[i];
+				shift += 10;
+			}
+			components[largest] = btSqrt(std::max(btScalar(0), btScalar(1) - sumSquares));
+			btQuaternion rotation(components[0], components[1], components[2], components[3]);
+			rotation.normalize();
+			return rotation;
+		}
+
+		//collects the rigidBodies touching the query box, other collision objects of the entities (e.g. triggers) are skipped
+		struct InterestCallback : public btBroadphaseAabbCallback
+		{
+			const ComponentPool<btRigidBody>& rigidBodies;
+			std::vector<entity_id_t>& ids;
+
+			InterestCallback(const ComponentPool<btRigidBody>& rigidBodies, std::vector<entity_id_t>& ids) : rigidBodies(rigidBodies), ids(ids) {}
+
+			bool process(const btBroadphaseProxy* proxy) override
+			{
+				const btCollisionObject* object = static_cast<const btCollisionObject*>(proxy->m_clientObject);
+				const Entity entity = getCollisionObjectEntity(object);
+				if (entity.ID != NULL_ENTITY && rigidBodies.get(entity) == object)
+				{
+					ids.push_back(entity.ID);
+				}
+				return true;
+			}
+		};
+	}
+
+	ReplicationServer::ReplicationServer(PhysicsWorld& world, const ReplicationSettings& settings)
+		: m_world(world), m_settings(settings)
+	{
+		assert(settings.positionPrecision > 0.0f && "The replication position precision must be positive.");
+		assert(settings.historySize > 1 && "Replication needs at least two snapshots of history to send deltas.");
+	}
+
+	client_id_t ReplicationServer::addClient()
+	{
+		const client_id_t id = m_nextClientId++;
+		m_clients[id].history.resize(m_settings.historySize);
+		return id;
+	}
+
+	void ReplicationServer::removeClient(client_id_t client)
+	{
+		const size_t erased = m_clients.erase(client);
+		assert(erased == 1 && "Unknown replication client.");
+		(void)erased;
+	}
+
+	void ReplicationServer::setClientFocus(client_id_t client, const btVector3& focus)
+	{
+		auto it = m_clients.find(client);
+		assert(it != m_clients.end() && "Unknown replication client.");
+		it->second.focus = focus;
+	}
+
+	void ReplicationServer::acknowledge(client_id_t client, uint32_t sequence)
+	{
+		auto it = m_clients.find(client);
+		assert(it != m_clients.end() && "Unknown replication client.");
+		Client& state = it->second;
+		if (sequence > state.ackedSequence && sequence < state.nextSequence && state.history[sequence % m_settings.historySize].sequence == sequence)
+		{
+			state.ackedSequence = sequence;
+		}
+	}
+
+	void ReplicationServer::queryInterest(Client& client)
+	{
+		client.interest.clear();
+		const btVector3 extent(m_settings.interestRadius, m_settings.interestRadius, m_settings.interestRadius);
+		InterestCallback callback(m_world.iterateEntitiesWithRigidBodies(), client.interest);
+		m_world.getDynamicsWorld()->getBroadphase()->aabbTest(client.focus - extent, client.focus + extent, callback);
+		std::sort(client.interest.begin(), client.interest.end());
+	}
+
+	void ReplicationServer::encodeSnapshot(Client& client, SnapshotBuffer& buffer, ReplicationStats& stats)
+	{
+		buffer.size = 0;
+		buffer.sequence = 0;
+		buffer.truncated = false;
+		if (buffer.capacity < HEADER_BYTES)
+		{
+			return;
+		}
+		const uint32_t historySize = m_settings.historySize;
+		const uint32_t sequence = client.nextSequence++;
+		const Snapshot* baseline = nullptr;
+		if (client.ackedSequence != 0 && sequence - client.ackedSequence < historySize)
+		{
+			baseline = &client.history[client.ackedSequence % historySize];
+		}
+		static const std::vector<ReplicatedState> NO_STATES;
+		const std::vector<ReplicatedState>& base = baseline ? baseline->states : NO_STATES;
+
+		//what the client holds once it receives this snapshot, changes that do not fit keep their baseline state
+		Snapshot& snapshot = client.history[sequence % historySize];
+		snapshot.sequence = sequence;
+		snapshot.states.clear();
+
+		BitWriter writer{ buffer.data + HEADER_BYTES, (buffer.capacity - HEADER_BYTES) * 8 };
+		bool full = false;
+		uint32_t removedCount = 0;
+		uint32_t recordCount = 0;
+
+		//bodies of the baseline that left the interest area or were destroyed
+		entity_id_t previousId = 0;
+		size_t interestIdx = 0;
+		bool keptRemoved = false;
+		for (const ReplicatedState& state : base)
+		{
+			while (interestIdx < client.interest.size() && client.interest[interestIdx] < state.id)
+			{
+				interestIdx++;
+			}
+			if (interestIdx < client.interest.size() && client.interest[interestIdx] == state.id)
+			{
+				continue;
+			}
+			if (!full && writer.writeUnsigned(state.id - previousId))
+			{
+				previousId = state.id;
+				removedCount++;
+				continue;
+			}
+			full = true;
+			keptRemoved = true;
+			snapshot.states.push_back(state);
+		}
+
+		previousId = 0;
+		size_t baseIdx = 0;
+		for (entity_id_t id : client.interest)
+		{
+			const ReplicatedState& current = m_current[id];
+			while (baseIdx < base.size() && base[baseIdx].id < id)
+			{
+				baseIdx++;
+			}
+			const ReplicatedState* previous = baseIdx < base.size() && base[baseIdx].id == id ? &base[baseIdx] : nullptr;
+			const bool isNew = !previous || previous->version != current.version;
+			int64_t position[3];
+			for (int i = 0; i < 3; i++)
+			{
+				position[i] = isNew ? int64_t(current.position[i]) : int64_t(current.position[i]) - previous->position[i];
+			}
+			const bool rotationChanged = isNew || previous->rotation != current.rotation;
+			if (!isNew && !rotationChanged && position[0] == 0 && position[1] == 0 && position[2] == 0)
+			{
+				snapshot.states.push_back(current);
+				continue;
+			}
+
+			const size_t checkpoint = writer.bitPos;
+			bool written = !full && writer.writeUnsigned(id - previousId) && writer.write(isNew ? 1 : 0, 1);
+			if (isNew)
+			{
+				written = written && writer.write(current.version, VERSION_BITS) && writer.writePosition(position) && writer.write(current.rotation, ROTATION_BITS);
+			}
+			else
+			{
+				written = written && writer.writePosition(position) && writer.write(rotationChanged ? 1 : 0, 1) &&
+					(!rotationChanged || writer.write(current.rotation, ROTATION_BITS));
+			}
+			if (written)
+			{
+				previousId = id;
+				recordCount++;
+				snapshot.states.push_back(current);
+				continue;
+			}
+			if (!full)
+			{
+				writer.rewind(checkpoint);
+				full = true;
+			}
+			if (previous)
+			{
+				snapshot.states.push_back(*previous);
+			}
+		}
+		if (keptRemoved)
+		{
+			std::sort(snapshot.states.begin(), snapshot.states.end(), [](const ReplicatedState& a, const ReplicatedState& b) { return a.id < b.id; });
+		}
+
+		const uint32_t header[4] = { sequence, baseline ? baseline->sequence : 0, removedCount, recordCount };
+		std::memcpy(buffer.data, header, HEADER_BYTES);
+		buffer.size = HEADER_BYTES + writer.bytes();
+		buffer.sequence = sequence;
+		buffer.truncated = full;
+
+		stats.snapshots++;
+		stats.fullSnapshots += baseline ? 0 : 1;
+		stats.truncatedSnapshots += full ? 1 : 0;
+		stats.interestBodies += static_cast<uint32_t>(client.interest.size());
+		stats.records += recordCount;
+		stats.encodedBytes += buffer.size;
+	}
+
+	void ReplicationServer::encodeSnapshots(Span<SnapshotBuffer> buffers)
+	{
+		BULLET_ECS_TRACE_SCOPE("ReplicationServer::encodeSnapshots");
+		m_stats = ReplicationStats{};
+		const Clock::time_point start = Clock::now();
+		ThreadPool* threadPool = m_world.getThreadPool();
+
+		//every body is quantized once, whatever the number of clients that see it
+		const ComponentPool<btRigidBody>& rigidBodies = m_world.iterateEntitiesWithRigidBodies();
+		const EntityBitset& bodyMask = rigidBodies.getEntitiesMask();
+		const size_t idCount = size_t(rigidBodies.getHighestEntity()) + 1;
+		m_current.resize(std::max(m_current.size(), idCount));
+		auto quantize = [&](size_t begin, size_t end)
+		{
+			for (size_t id = bodyMask.findNext(begin, end - 1); id < end; id = bodyMask.findNext(id + 1, end - 1))
+			{
+				const btRigidBody* rigidBody = rigidBodies.get(Entity{ static_cast<entity_id_t>(id), 0 });
+				const btTransform& transform = rigidBody->getWorldTransform();
+				ReplicatedState& state = m_current[id];
+				state.id = static_cast<entity_id_t>(id);
+				state.version = getCollisionObjectEntity(rigidBody).version;
+				for (int i = 0; i < 3; i++)
+				{
+					state.position[i] = quantizePosition(transform.getOrigin()[i], m_settings.positionPrecision);
+				}
+				state.rotation = packRotation(transform.getRotation());
+			}
+		};
+		if (threadPool)
+		{
+			threadPool->parallelFor(idCount, quantize, 1024);
+		}
+		else
+		{
+			quantize(0, idCount);
+		}
+		const Clock::time_point quantized = Clock::now();
+
+		//Bullet's broadphases are not made for concurrent queries, so the interest sets are gathered here and only the encoding is parallel
+		m_encodingClients.resize(buffers.size());
+		for (size_t i = 0; i < buffers.size(); i++)
+		{
+			auto it = m_clients.find(buffers[i].client);
+			assert(it != m_clients.end() && "Unknown replication client.");
+			assert(std::find(m_encodingClients.begin(), m_encodingClients.begin() + i, &it->second) == m_encodingClients.begin() + i
+				&& "A replication client can only receive one snapshot per encodeSnapshots.");
+			m_encodingClients[i] = &it->second;
+			queryInterest(it->second);
+		}
+		const Clock::time_point queried = Clock::now();
+
+		m_bufferStats.assign(buffers.size(), ReplicationStats{});
+		auto encode = [&](size_t begin, size_t end)
+		{
+			BULLET_ECS_TRACE_SCOPE("ReplicationServer::encodeSnapshot");
+			for (size_t i = begin; i < end; i++)
+			{
+				encodeSnapshot(*m_encodingClients[i], buffers[i], m_bufferStats[i]);
+			}
+		};
+		if (threadPool)
+		{
+			threadPool->parallelFor(buffers.size(), encode, 1);
+		}
+		else
+		{
+			encode(0, buffers.size());
+		}
+
+		for (const ReplicationStats& stats : m_bufferStats)
+		{
+			m_stats.snapshots += stats.snapshots;
+			m_stats.fullSnapshots += stats.fullSnapshots;
+			m_stats.truncatedSnapshots += stats.truncatedSnapshots;
+			m_stats.interestBodies += stats.interestBodies;
+			m_stats.records += stats.records;
+			m_stats.encodedBytes += stats.encodedBytes;
+		}
+		m_stats.fullStateBytes = uint64_t(buffers.size()) * rigidBodies.size() * (sizeof(Entity) + 7 * sizeof(float));
+		const Clock::time_point end = Clock::now();
+		m_stats.quantizeTime = Milliseconds(quantized - start).count();
+		m_stats.interestTime = Milliseconds(queried - quantized).count();
+		m_stats.encodeTime = Milliseconds(end - queried).count();
+	}
+
+	ReplicationClient::ReplicationClient(const ReplicationSettings& settings)
+		: m_settings(settings), m_history(settings.historySize)
+	{
+	}
+
+	bool ReplicationClient::receive(const uint8_t* data, size_t size)
+	{
+		BULLET_ECS_TRACE_SCOPE("ReplicationClient::receive");
+		if (size < HEADER_BYTES)
+		{
+			return false;
+		}
+		uint32_t header[4];
+		std::memcpy(header, data, HEADER_BYTES);
+		const uint32_t sequence = header[0];
+		const uint32_t baselineSequence = header[1];
+		const uint32_t historySize = m_settings.historySize;
+		//late packets are dropped, the server's next snapshot supersedes them
+		if (sequence <= m_lastSequence || (baselineSequence != 0 && (baselineSequence >= sequence || sequence - baselineSequence >= historySize)))
+		{
+			return false;
+		}
+		static const std::vector<ReplicatedState> NO_STATES;
+		const Snapshot* baseline = baselineSequence ? &m_history[baselineSequence % historySize] : nullptr;
+		if (baseline && baseline->sequence != baselineSequence)
+		{
+			return false;
+		}
+		const std::vector<ReplicatedState>& base = baseline ? baseline->states : NO_STATES;
+
+		BitReader reader{ data + HEADER_BYTES, (size - HEADER_BYTES) * 8 };
+		//removed IDs are read first, they are a sorted subset of the baseline
+		std::vector<bool> removed(base.size(), false);
+		entity_id_t id = 0;
+		size_t baseIdx = 0;
+		for (uint32_t i = 0; i < header[2] && reader.ok; i++)
+		{
+			const uint64_t delta = reader.readUnsigned();
+			if (delta == 0 || id + delta > UINT32_MAX)
+			{
+				return false;
+			}
+			id += static_cast<entity_id_t>(delta);
+			while (baseIdx < base.size() && base[baseIdx].id < id)
+			{
+				baseIdx++;
+			}
+			if (baseIdx == base.size() || base[baseIdx].id != id)
+			{
+				return false;
+			}
+			removed[baseIdx] = true;
+		}
+
+		//records and the kept baseline states are merged in ID order
+		std::vector<ReplicatedState> states;
+		states.reserve(base.size() + header[3]);
+		id = 0;
+		baseIdx = 0;
+		for (uint32_t i = 0; i < header[3] && reader.ok; i++)
+		{
+			const uint64_t delta = reader.readUnsigned();
+			if (delta == 0 || id + delta > UINT32_MAX)
+			{
+				return false;
+			}
+			id += static_cast<entity_id_t>(delta);
+			for (; baseIdx < base.size() && base[baseIdx].id < id; baseIdx++)
+			{
+				if (!removed[baseIdx])
+				{
+					states.push_back(base[baseIdx]);
+				}
+			}
+			const ReplicatedState* previous = baseIdx < base.size() && base[baseIdx].id == id && !removed[baseIdx] ? &base[baseIdx] : nullptr;
+			if (previous)
+			{
+				baseIdx++;
+			}
+
+			ReplicatedState state;
+			state.id = id;
+			int64_t position[3];
+			if (reader.read(1))
+			{
+				state.version = static_cast<entity_version_t>(reader.read(VERSION_BITS));
+				reader.readPosition(position);
+				for (int c = 0; c < 3; c++)
+				{
+					state.position[c] = static_cast<int32_t>(position[c]);
+				}
+				state.rotation = static_cast<uint32_t>(reader.read(ROTATION_BITS));
+			}
+			else
+			{
+				if (!previous)
+				{
+					return false;
+				}
+				state = *previous;
+				reader.readPosition(position);
+				for (int c = 0; c < 3; c++)
+				{
+					state.position[c] = static_cast<int32_t>(state.position[c] + position[c]);
+				}
+				if (reader.read(1))
+				{
+					state.rotation = static_cast<uint32_t>(reader.read(ROTATION_BITS));
+				}
+			}
+			states.push_back(state);
+		}
+		if (!reader.ok)
+		{
+			return false;
+		}
+		for (; baseIdx < base.size(); baseIdx++)
+		{
+			if (!removed[baseIdx])
+			{
+				states.push_back(base[baseIdx]);
+			}
+		}
+
+		Snapshot& snapshot = m_history[sequence % historySize];
+		snapshot.sequence = sequence;
+		snapshot.states.swap(states);
+		m_lastSequence = sequence;
+
+		m_bodies.clear();
+		m_bodies.reserve(snapshot.states.size());
+		for (const ReplicatedState& state : snapshot.states)
+		{
+			m_bodies.push_back(ReplicatedBody{ Entity{ state.id, state.version },
+				btVector3(btScalar(double(state.position[0]) * m_settings.positionPrecision),
+						  btScalar(double(state.position[1]) * m_settings.positionPrecision),
+						  btScalar(double(state.position[2]) * m_settings.positionPrecision)),
+				unpackRotation(state.rotation) });
+		}
+		return true;
+	}
+
+	bool ReplicationClient::getTransform(Entity entity, btTransform& transform) const
+	{
+		auto it = std::lower_bound(m_bodies.begin(), m_bodies.end(), entity.ID, [](const ReplicatedBody& body, entity_id_t id) { return body.entity.ID < id; });
+		if (it == m_bodies.end() || it->entity.ID != entity.ID || it->entity.version != entity.version)
+		{
+			return false;
+		}
+		transform.setOrigin(it->position);
+		transform.setRotation(it->rotation);
+		return true;
+	}
+}
@@ -0,0 +1,211 @@
+#include "BulletECS/Scene.h"
+#include "BulletECS/PhysicsWorld.h"
+#include "BulletECS/MappedFile.h"
+#include "BulletECS/Trace.h"
+#include <fstream>
+#include <map>
+#include <array>
+#include <chrono>
+#include <cstring>
+
+namespace BulletECS
+{
+	using Clock = std::chrono::steady_clock;
+	using Milliseconds = std::chrono::duration<double, std::milli>;
+
+	static inline uint64_t alignSection(uint64_t offset)
+	{
+		return (offset + Scene::SECTION_ALIGNMENT - 1) / Scene::SECTION_ALIGNMENT * Scene::SECTION_ALIGNMENT;
+	}
+
+	//index of the record in records, added the first time. Records are zero initialized, so equal ones are bytewise equal
+	template <class Record>
+	static uint32_t internRecord(const Record& record, std::vector<Record>& records, std::map<std::array<uint8_t, sizeof(Record)>, uint32_t>& indices)
+	{
+		std::array<uint8_t, sizeof(Record)> key;
+		std::memcpy(key.data(), &record, sizeof(Record));
+		auto it = indices.emplace(key, static_cast<uint32_t>(records.size())).first;
+		if (it->second == records.size())
+		{
+			records.push_back(record);
+		}
+		return it->second;
+	}
+
+	//the section is inside the file, aligned, and count elements fit in it
+	static bool isValidSection(const MappedFile& file, uint64_t offset, uint64_t count, size_t elementSize)
+	{
+		return offset % Scene::SECTION_ALIGNMENT == 0 && offset <= file.size() && count <= (file.size() - offset) / elementSize;
+	}
+
+	bool Scene::save(const PhysicsWorld& world, const std::string& path)
+	{
+		BULLET_ECS_TRACE_SCOPE("Scene::save");
+		std::vector<ShapeRecord> shapes;
+		std::vector<PrefabRecord> prefabs;
+		std::map<std::array<uint8_t, sizeof(ShapeRecord)>, uint32_t> shapeIndices;
+		std::map<std::array<uint8_t, sizeof(PrefabRecord)>, uint32_t> prefabIndicesByRecord;
+		std::vector<uint32_t> prefabIndices;
+		std::vector<float> positions;
+		std::vector<float> rotations;
+
+		const ComponentPool<btRigidBody>& rigidBodies = world.iterateEntitiesWithRigidBodies();
+		prefabIndices.reserve(rigidBodies.size());
+		positions.reserve(rigidBodies.size() * 3);
+		rotations.reserve(rigidBodies.size() * 4);
+		for (Entity entity : rigidBodies)
+		{
+			BodyDesc desc;
+			if (!world.getBodyDesc(entity, desc))
+			{
+				continue;
+			}
+			ShapeRecord shape{};
+			shape.type = static_cast<uint8_t>(desc.collider.type);
+			shape.size[0] = desc.collider.size.x();
+			shape.size[1] = desc.collider.size.y();
+			shape.size[2] = desc.collider.size.z();
+
+			PrefabRecord prefab{};
+			prefab.shape = internRecord(shape, shapes, shapeIndices);
+			prefab.mass = desc.mass;
+			prefab.restitution = desc.restitution;
+			prefab.layer = desc.layer;
+			prefabIndices.push_back(internRecord(prefab, prefabs, prefabIndicesByRecord));
+
+			const btVector3& position = desc.transform.getOrigin();
+			const btQuaternion rotation = desc.transform.getRotation();
+			positions.insert(positions.end(), { float(position.x()), float(position.y()), float(position.z()) });
+			rotations.insert(rotations.end(), { float(rotation.x()), float(rotation.y()), float(rotation.z()), float(rotation.w()) });
+		}
+
+		Header header{};
+		std::memcpy(header.magic, MAGIC, sizeof(header.magic));
+		header.version = VERSION;
+		header.shapeCount = static_cast<uint32_t>(shapes.size());
+		header.prefabCount = static_cast<uint32_t>(prefabs.size());
+		header.instanceCount = prefabIndices.size();
+		uint64_t end = sizeof(Header);
+		auto place = [&end](size_t bytes)
+		{
+			const uint64_t offset = alignSection(end);
+			end = offset + bytes;
+			return offset;
+		};
+		header.shapesOffset = place(shapes.size() * sizeof(ShapeRecord));
+		header.prefabsOffset = place(prefabs.size() * sizeof(PrefabRecord));
+		header.prefabIndicesOffset = place(prefabIndices.size() * sizeof(uint32_t));
+		header.positionsOffset = place(positions.size() * sizeof(float));
+		header.rotationsOffset = place(rotations.size() * sizeof(float));
+
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		if (!file)
+		{
+			return false;
+		}
+		uint64_t written = 0;
+		auto writeAt = [&](uint64_t offset, const void* data, size_t bytes)
+		{
+			static const char zeros[SECTION_ALIGNMENT] = {};
+			file.write(zeros, static_cast<std::streamsize>(offset - written));
+			file.write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+			written = offset + bytes;
+		};
+		writeAt(0, &header, sizeof(Header));
+		writeAt(header.shapesOffset, shapes.data(), shapes.size() * sizeof(ShapeRecord));
+		writeAt(header.prefabsOffset, prefabs.data(), prefabs.size() * sizeof(PrefabRecord));
+		writeAt(header.prefabIndicesOffset, prefabIndices.data(), prefabIndices.size() * sizeof(uint32_t));
+		writeAt(header.positionsOffset, positions.data(), positions.size() * sizeof(float));
+		writeAt(header.rotationsOffset, rotations.data(), rotations.size() * sizeof(float));
+		return static_cast<bool>(file);
+	}
+
+	bool Scene::load(PhysicsWorld& world, const std::string& path, std::vector<Entity>* entities, SceneLoadStats* stats)
+	{
+		BULLET_ECS_TRACE_SCOPE("Scene::load");
+		const Clock::time_point start = Clock::now();
+		MappedFile file;
+		if (!file.open(path) || file.size() < sizeof(Header))
+		{
+			return false;
+		}
+		const Header& header = *reinterpret_cast<const Header*>(file.data());
+		if (std::memcmp(header.magic, MAGIC, sizeof(header.magic)) != 0 || header.version != VERSION ||
+			!isValidSection(file, header.shapesOffset, header.shapeCount, sizeof(ShapeRecord)) ||
+			!isValidSection(file, header.prefabsOffset, header.prefabCount, sizeof(PrefabRecord)) ||
+			!isValidSection(file, header.prefabIndicesOffset, header.instanceCount, sizeof(uint32_t)) ||
+			!isValidSection(file, header.positionsOffset, header.instanceCount, 3 * sizeof(float)) ||
+			!isValidSection(file, header.rotationsOffset, header.instanceCount, 4 * sizeof(float)))
+		{
+			return false;
+		}
+		const ShapeRecord* shapes = reinterpret_cast<const ShapeRecord*>(file.data() + header.shapesOffset);
+		const PrefabRecord* prefabs = reinterpret_cast<const PrefabRecord*>(file.data() + header.prefabsOffset);
+		const uint32_t* prefabIndices = reinterpret_cast<const uint32_t*>(file.data() + header.prefabIndicesOffset);
+		const float* positions = reinterpret_cast<const float*>(file.data() + header.positionsOffset);
+		const float* rotations = reinterpret_cast<const float*>(file.data() + header.rotationsOffset);
+
+		//everything is checked before the first entity is created, so a bad file leaves the world as it was
+		if (header.instanceCount > world.getMaxEntities() - world.getLiveEntityCount())
+		{
+			return false; //more bodies than the world has free entities
+		}
+		for (uint32_t i = 0; i < header.shapeCount; i++)
+		{
+			if (shapes[i].type >= static_cast<uint8_t>(ColliderType::Count))
+			{
+				return false;
+			}
+		}
+		for (uint32_t i = 0; i < header.prefabCount; i++)
+		{
+			if (prefabs[i].shape >= header.shapeCount || prefabs[i].layer >= MAX_COLLISION_LAYERS)
+			{
+				return false;
+			}
+		}
+		for (uint64_t i = 0; i < header.instanceCount; i++)
+		{
+			if (prefabIndices[i] >= header.prefabCount)
+			{
+				return false;
+			}
+		}
+		const Clock::time_point mapped = Clock::now();
+
+		//one shape lookup per prefab instead of one per body
+		std::vector<BodyPrefab> resolvedPrefabs;
+		resolvedPrefabs.reserve(header.prefabCount);
+		for (uint32_t i = 0; i < header.prefabCount; i++)
+		{
+			const ShapeRecord& shape = shapes[prefabs[i].shape];
+			ColliderDesc collider;
+			collider.type = static_cast<ColliderType>(shape.type);
+			collider.size = btVector3(shape.size[0], shape.size[1], shape.size[2]);
+			resolvedPrefabs.push_back(world.makeBodyPrefab(collider, prefabs[i].mass, prefabs[i].restitution, prefabs[i].layer));
+		}
+		const Clock::time_point resolved = Clock::now();
+
+		const size_t instanceCount = static_cast<size_t>(header.instanceCount);
+		Entity* created = nullptr;
+		if (entities)
+		{
+			entities->resize(entities->size() + instanceCount);
+			created = entities->data() + entities->size() - instanceCount;
+		}
+		world.addPrefabInstances(resolvedPrefabs, prefabIndices, positions, rotations, instanceCount, created);
+
+		if (stats)
+		{
+			const Clock::time_point end = Clock::now();
+			stats->shapes = header.shapeCount;
+			stats->prefabs = header.prefabCount;
+			stats->instances = header.instanceCount;
+			stats->mapTime = Milliseconds(mapped - start).count();
+			stats->prefabTime = Milliseconds(resolved - mapped).count();
+			stats->instanceTime = Milliseconds(end - resolved).count();
+			stats->totalTime = Milliseconds(end - start).count();
+		}
+		return true;
+	}
+}
@@ -0,0 +1,167 @@
+#include "BulletECS/StepStats.h"
+#include "BulletECS/Trace.h"
+#include <LinearMath/btQuickprof.h>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+
+namespace BulletECS
+{
+	namespace
+	{
+		using Clock = std::chrono::steady_clock;
+
+		struct PhaseZone
+		{
+			const char* name;
+			StepPhase phase;
+		};
+
+		constexpr PhaseZone PHASE_ZONES[] =
+		{
+			{ "predictUnconstraintMotion", StepPhase::PredictMotion },
+			{ "updateAabbs", StepPhase::UpdateAabbs },
+			{ "calculateOverlappingPairs", StepPhase::Broadphase },
+			{ "dispatchAllCollisionPairs", StepPhase::Narrowphase },
+			{ "calculateSimulationIslands", StepPhase::Islands },
+			{ "solveConstraints", StepPhase::Solver },
+			{ "integrateTransforms", StepPhase::Integration },
+			{ "createPredictiveContacts", StepPhase::Integration },
+			{ "updateActivationState", StepPhase::Deactivation },
+			{ "synchronizeMotionStates", StepPhase::MotionStates },
+		};
+
+		// Only the outermost phase zone is timed, so the phases never overlap
+		struct CaptureState
+		{
+			StepStats* stats = nullptr;
+			int depth = 0;
+			int phaseDepth = -1;
+			StepPhase phase = StepPhase::Count;
+			Clock::time_point phaseStart;
+		};
+
+		thread_local CaptureState t_capture;
+
+#ifdef BULLET_ECS_ENABLE_TRACING
+		// Bullet's zones are also forwarded to the trace, so its phases show up inside the library's spans
+		struct TraceZone
+		{
+			const char* name;
+			uint64_t start;
+		};
+		constexpr int MAX_TRACE_ZONE_DEPTH = 64;
+		thread_local TraceZone t_traceZones[MAX_TRACE_ZONE_DEPTH];
+		thread_local int t_traceZoneDepth = 0;
+#endif
+
+		btEnterProfileZoneFunc* s_previousEnter = nullptr;
+		btLeaveProfileZoneFunc* s_previousLeave = nullptr;
+
+		void hookEnter(const char* name)
+		{
+			if (s_previousEnter)
+			{
+				s_previousEnter(name);
+			}
+#ifdef BULLET_ECS_ENABLE_TRACING
+			if (t_traceZoneDepth < MAX_TRACE_ZONE_DEPTH)
+			{
+				t_traceZones[t_traceZoneDepth] = TraceZone{ name, Trace::now() };
+			}
+			t_traceZoneDepth++;
+#endif
+			CaptureState& capture = t_capture;
+			if (!capture.stats)
+			{
+				return;
+			}
+			capture.depth++;
+			if (capture.phaseDepth >= 0)
+			{
+				return;
+			}
+			for (const PhaseZone& zone : PHASE_ZONES)
+			{
+				if (std::strcmp(zone.name, name) == 0)
+				{
+					capture.phaseDepth = capture.depth;
+					capture.phase = zone.phase;
+					capture.phaseStart = Clock::now();
+					return;
+				}
+			}
+		}
+
+		void hookLeave()
+		{
+#ifdef BULLET_ECS_ENABLE_TRACING
+			if (t_traceZoneDepth > 0 && --t_traceZoneDepth < MAX_TRACE_ZONE_DEPTH)
+			{
+				const TraceZone& zone = t_traceZones[t_traceZoneDepth];
+				Trace::record(zone.name, zone.start, Trace::now());
+			}
+#endif
+			CaptureState& capture = t_capture;
+			if (capture.stats && capture.depth > 0)
+			{
+				if (capture.depth == capture.phaseDepth)
+				{
+					std::chrono::duration<double, std::milli> elapsed = Clock::now() - capture.phaseStart;
+					capture.stats->phaseTimes[static_cast<size_t>(capture.phase)] += elapsed.count();
+					capture.phaseDepth = -1;
+				}
+				capture.depth--;
+			}
+			if (s_previousLeave)
+			{
+				s_previousLeave();
+			}
+		}
+	}
+
+	const char* getStepPhaseName(StepPhase phase)
+	{
+		switch (phase)
+		{
+		case StepPhase::PredictMotion: return "PredictMotion";
+		case StepPhase::UpdateAabbs: return "UpdateAabbs";
+		case StepPhase::Broadphase: return "Broadphase";
+		case StepPhase::Narrowphase: return "Narrowphase";
+		case StepPhase::Islands: return "Islands";
+		case StepPhase::Solver: return "Solver";
+		case StepPhase::Integration: return "Integration";
+		case StepPhase::Deactivation: return "Deactivation";
+		case StepPhase::MotionStates: return "MotionStates";
+		default: return "Unknown";
+		}
+	}
+
+	namespace StepProfiler
+	{
+		void install()
+		{
+			static std::once_flag installed;
+			std::call_once(installed, []()
+			{
+				s_previousEnter = btGetCurrentEnterProfileZoneFunc();
+				s_previousLeave = btGetCurrentLeaveProfileZoneFunc();
+				btSetCustomEnterProfileZoneFunc(&hookEnter);
+				btSetCustomLeaveProfileZoneFunc(&hookLeave);
+			});
+		}
+
+		ScopedCapture::ScopedCapture(StepStats* stats)
+			: m_previous(t_capture.stats)
+		{
+			t_capture = CaptureState{};
+			t_capture.stats = stats;
+		}
+
+		ScopedCapture::~ScopedCapture()
+		{
+			t_capture = CaptureState{};
+			t_capture.stats = m_previous;
+		}
+	}
+}
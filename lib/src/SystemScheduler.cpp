@@ -0,0 +1,230 @@
+#include "BulletECS/SystemScheduler.h"
+#include "BulletECS/PhysicsWorld.h"
+#include "BulletECS/ThreadPool.h"
+#include "BulletECS/Trace.h"
+#include <unordered_map>
+#include <algorithm>
+#include <chrono>
+
+namespace BulletECS
+{
+	using Clock = std::chrono::steady_clock;
+	using Milliseconds = std::chrono::duration<double, std::milli>;
+
+	SystemScheduler::SystemBuilder SystemScheduler::addSystem(std::string name, SystemPhase phase, SystemFunction function)
+	{
+		assert(phase < SystemPhase::Count && "Unknown SystemPhase.");
+		assert(std::none_of(m_systems.begin(), m_systems.end(), [&](const System& s) { return s.name == name; }) && "System names must be unique.");
+		System system;
+		system.name = std::move(name);
+		system.phase = phase;
+		system.function = std::move(function);
+		m_systems.push_back(std::move(system));
+		m_graphsDirty = true;
+		return SystemBuilder(*this, m_systems.size() - 1);
+	}
+
+	void SystemScheduler::addAccess(size_t system, component_type_id component, bool write)
+	{
+		std::vector<component_type_id>& access = write ? m_systems[system].writes : m_systems[system].reads;
+		if (std::find(access.begin(), access.end(), component) == access.end())
+		{
+			access.push_back(component);
+		}
+		m_graphsDirty = true;
+	}
+
+	void SystemScheduler::addOrder(size_t system, std::string_view other, bool after)
+	{
+		m_systems[system].order.push_back(OrderConstraint{ std::string(other), after });
+		m_graphsDirty = true;
+	}
+
+	bool SystemScheduler::conflict(const System& a, const System& b)
+	{
+		auto intersects = [](const std::vector<component_type_id>& x, const std::vector<component_type_id>& y)
+		{
+			return std::any_of(x.begin(), x.end(), [&](component_type_id id) { return std::find(y.begin(), y.end(), id) != y.end(); });
+		};
+		return intersects(a.writes, b.writes) || intersects(a.writes, b.reads) || intersects(b.writes, a.reads);
+	}
+
+	void SystemScheduler::buildGraphs()
+	{
+		std::unordered_map<std::string_view, size_t> systemByName;
+		for (size_t i = 0; i < m_systems.size(); i++)
+		{
+			m_systems[i].dependents.clear();
+			m_systems[i].dependencyCount = 0;
+			systemByName[m_systems[i].name] = i;
+		}
+
+		for (size_t phase = 0; phase < static_cast<size_t>(SystemPhase::Count); phase++)
+		{
+			PhaseGraph& graph = m_graphs[phase];
+			graph.systems.clear();
+			graph.roots.clear();
+			std::vector<size_t> localIndex(m_systems.size(), 0);
+			for (size_t i = 0; i < m_systems.size(); i++)
+			{
+				if (static_cast<size_t>(m_systems[i].phase) == phase)
+				{
+					localIndex[i] = graph.systems.size();
+					graph.systems.push_back(i);
+				}
+			}
+
+			//reachable[a][b]: b runs after a through some path, keeps the graph acyclic and skips redundant conflict edges
+			const size_t count = graph.systems.size();
+			std::vector<std::vector<char>> reachable(count, std::vector<char>(count, 0));
+			auto addEdge = [&](size_t from, size_t to)
+			{
+				if (reachable[from][to])
+				{
+					return;
+				}
+				assert(!reachable[to][from] && from != to && "System order constraints form a cycle.");
+				m_systems[graph.systems[from]].dependents.push_back(graph.systems[to]);
+				m_systems[graph.systems[to]].dependencyCount++;
+				for (size_t x = 0; x < count; x++)
+				{
+					if (x == from || reachable[x][from])
+					{
+						reachable[x][to] = 1;
+						for (size_t y = 0; y < count; y++)
+						{
+							reachable[x][y] |= reachable[to][y];
+						}
+					}
+				}
+			};
+
+			//explicit constraints first, then conflicts follow registration order unless already ordered
+			for (size_t local = 0; local < count; local++)
+			{
+				for (const OrderConstraint& constraint : m_systems[graph.systems[local]].order)
+				{
+					auto other = systemByName.find(constraint.other);
+					assert(other != systemByName.end() && "Unknown system in after/before.");
+					assert(static_cast<size_t>(m_systems[other->second].phase) == phase && "after/before only order systems of the same phase.");
+					const size_t otherLocal = localIndex[other->second];
+					constraint.after ? addEdge(otherLocal, local) : addEdge(local, otherLocal);
+				}
+			}
+			for (size_t i = 0; i < count; i++)
+			{
+				for (size_t j = i + 1; j < count; j++)
+				{
+					if (!reachable[i][j] && !reachable[j][i] && conflict(m_systems[graph.systems[i]], m_systems[graph.systems[j]]))
+					{
+						addEdge(i, j);
+					}
+				}
+			}
+
+			for (size_t system : graph.systems)
+			{
+				if (m_systems[system].dependencyCount == 0)
+				{
+					graph.roots.push_back(system);
+				}
+			}
+		}
+
+		m_timings.resize(m_systems.size());
+		for (size_t i = 0; i < m_systems.size(); i++)
+		{
+			m_timings[i].name = m_systems[i].name;
+			m_timings[i].phase = m_systems[i].phase;
+		}
+		m_ready.reserve(m_systems.size());
+		m_remainingDependencies.resize(m_systems.size());
+		m_graphsDirty = false;
+	}
+
+	void SystemScheduler::run(PhysicsWorld& world, float timeStep, int maxSubSteps, float fixedTimeStep)
+	{
+		BULLET_ECS_TRACE_SCOPE("SystemScheduler::run");
+		runPhase(SystemPhase::PreStep, timeStep, world.getThreadPool());
+		const Clock::time_point stepStart = Clock::now();
+		world.stepSimulation(timeStep, maxSubSteps, fixedTimeStep);
+		m_stepTime = Milliseconds(Clock::now() - stepStart).count();
+		runPhase(SystemPhase::PostStep, timeStep, world.getThreadPool());
+	}
+
+	void SystemScheduler::runPhase(SystemPhase phase, float timeStep, ThreadPool* threadPool)
+	{
+		if (m_graphsDirty)
+		{
+			buildGraphs();
+		}
+		const Clock::time_point start = Clock::now();
+		const PhaseGraph& graph = m_graphs[static_cast<size_t>(phase)];
+		const size_t total = graph.systems.size();
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			//kept sorted from last to first registered, so back() is the earliest ready system and one thread runs them in registration order
+			m_ready.assign(graph.roots.rbegin(), graph.roots.rend());
+			for (size_t system : graph.systems)
+			{
+				m_remainingDependencies[system] = m_systems[system].dependencyCount;
+			}
+			m_finishedSystems = 0;
+		}
+
+		//every chunk is a worker that takes ready systems until the phase is done, so the graph is not run in waves
+		auto worker = [&](size_t, size_t)
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			while (true)
+			{
+				m_systemFinished.wait(lock, [&]() { return !m_ready.empty() || m_finishedSystems == total; });
+				if (m_finishedSystems == total)
+				{
+					return;
+				}
+				const size_t system = m_ready.back();
+				m_ready.pop_back();
+				lock.unlock();
+				runSystem(system, timeStep);
+				lock.lock();
+
+				m_finishedSystems++;
+				for (size_t dependent : m_systems[system].dependents)
+				{
+					if (--m_remainingDependencies[dependent] == 0)
+					{
+						m_ready.insert(std::upper_bound(m_ready.begin(), m_ready.end(), dependent, std::greater<size_t>()), dependent);
+					}
+				}
+				m_systemFinished.notify_all();
+			}
+		};
+
+		const size_t threads = threadPool ? std::min(threadPool->getThreadCount(), total) : 1;
+		if (threads > 1)
+		{
+			threadPool->parallelFor(threads, worker, 1);
+		}
+		else if (total > 0)
+		{
+			worker(0, 1);
+		}
+		m_phaseTimes[static_cast<size_t>(phase)] = Milliseconds(Clock::now() - start).count();
+	}
+
+	void SystemScheduler::runSystem(size_t system, float timeStep)
+	{
+		const Clock::time_point start = Clock::now();
+#ifdef BULLET_ECS_ENABLE_TRACING
+		const uint64_t traceStart = Trace::now();
+#endif
+		m_systems[system].function(timeStep);
+#ifdef BULLET_ECS_ENABLE_TRACING
+		//the name lives in the scheduler, so export the trace before destroying it
+		Trace::record(m_systems[system].name.c_str(), traceStart, Trace::now());
+#endif
+		m_timings[system].time = Milliseconds(Clock::now() - start).count();
+	}
+}
@@ -0,0 +1,116 @@
+#include "BulletECS/ThreadPool.h"
+#include "BulletECS/Trace.h"
+
+namespace BulletECS
+{
+	namespace
+	{
+		thread_local bool t_insideTask = false;
+	}
+
+	ThreadPool::ThreadPool(size_t threadCount)
+	{
+		if (threadCount == 0)
+		{
+			unsigned hardwareThreads = std::thread::hardware_concurrency();
+			threadCount = hardwareThreads > 0 ? hardwareThreads : 1;
+		}
+		m_workers.reserve(threadCount - 1);
+		for (size_t i = 0; i + 1 < threadCount; i++)
+		{
+			m_workers.emplace_back([this]() { workerLoop(); });
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stopping = true;
+		}
+		m_wakeWorkers.notify_all();
+		for (std::thread& worker : m_workers)
+		{
+			worker.join();
+		}
+	}
+
+	void ThreadPool::parallelFor(size_t count, const std::function<void(size_t begin, size_t end)>& function, size_t grainSize)
+	{
+		if (count == 0)
+		{
+			return;
+		}
+		grainSize = grainSize > 0 ? grainSize : 1;
+		if (m_workers.empty() || t_insideTask || count <= grainSize)
+		{
+			function(0, count);
+			return;
+		}
+
+		std::lock_guard<std::mutex> submitLock(m_submitMutex);
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_job.function = &function;
+			m_job.count = count;
+			m_job.grainSize = grainSize;
+			m_job.nextIndex.store(0, std::memory_order_relaxed);
+			m_job.pendingChunks.store((count + grainSize - 1) / grainSize, std::memory_order_relaxed);
+			m_jobGeneration++;
+		}
+		m_wakeWorkers.notify_all();
+
+		runChunks(m_job);
+
+		//the job lives in the pool, so it can only be reused once no worker is still looking at it
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_jobDone.wait(lock, [this]() { return m_job.pendingChunks.load(std::memory_order_acquire) == 0 && m_activeWorkers == 0; });
+		m_job.function = nullptr;
+	}
+
+	void ThreadPool::runChunks(Job& job)
+	{
+		bool wasInsideTask = t_insideTask;
+		t_insideTask = true;
+		while (true)
+		{
+			size_t begin = job.nextIndex.fetch_add(job.grainSize, std::memory_order_relaxed);
+			if (begin >= job.count)
+			{
+				break;
+			}
+			size_t end = begin + job.grainSize < job.count ? begin + job.grainSize : job.count;
+			BULLET_ECS_TRACE_SCOPE("ThreadPool::chunk");
+			(*job.function)(begin, end);
+			job.pendingChunks.fetch_sub(1, std::memory_order_acq_rel);
+		}
+		t_insideTask = wasInsideTask;
+	}
+
+	void ThreadPool::workerLoop()
+	{
+		BULLET_ECS_TRACE_THREAD_NAME("BulletECS worker");
+		uint64_t seenGeneration = 0;
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_wakeWorkers.wait(lock, [&]() { return m_stopping || (m_jobGeneration != seenGeneration && m_job.function); });
+				if (m_stopping)
+				{
+					return;
+				}
+				seenGeneration = m_jobGeneration;
+				m_activeWorkers++;
+			}
+
+			runChunks(m_job);
+
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_activeWorkers--;
+			}
+			m_jobDone.notify_all();
+		}
+	}
+}
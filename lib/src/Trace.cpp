@@ -0,0 +1,172 @@
+#include "BulletECS/Trace.h"
+
+#ifdef BULLET_ECS_ENABLE_TRACING
+
+#include <atomic>
+#include <array>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <fstream>
+#include <algorithm>
+
+namespace BulletECS
+{
+	namespace Trace
+	{
+		namespace
+		{
+			struct Event
+			{
+				const char* name;
+				uint64_t start;
+				uint64_t end;
+			};
+
+			//the fields are atomics so a reader copying a slot the owner is overwriting reads stale or new values, never a torn pointer
+			struct EventSlot
+			{
+				std::atomic<const char*> name{ nullptr };
+				std::atomic<uint64_t> start{ 0 };
+				std::atomic<uint64_t> end{ 0 };
+			};
+
+			// Written only by its thread. The write index is published after the event, so a reader knows
+			// which slots are complete, and re-reads it after copying to skip the ones overwritten meanwhile
+			struct ThreadBuffer
+			{
+				std::array<EventSlot, BULLET_ECS_TRACE_BUFFER_EVENTS> events;
+				std::atomic<uint64_t> writeIndex{ 0 };
+				std::atomic<uint64_t> clearedIndex{ 0 }; //set by clear(), the events below it are not exported
+				std::atomic<const char*> threadName{ nullptr };
+				uint32_t threadId = 0;
+			};
+
+			std::mutex s_buffersMutex;
+			std::vector<std::unique_ptr<ThreadBuffer>> s_buffers; //never shrinks, threads may exit before the flush
+
+			thread_local ThreadBuffer* t_buffer = nullptr;
+
+			const std::chrono::steady_clock::time_point s_epoch = std::chrono::steady_clock::now();
+
+			ThreadBuffer& threadBuffer()
+			{
+				if (!t_buffer)
+				{
+					std::lock_guard<std::mutex> lock(s_buffersMutex);
+					s_buffers.push_back(std::make_unique<ThreadBuffer>());
+					t_buffer = s_buffers.back().get();
+					t_buffer->threadId = static_cast<uint32_t>(s_buffers.size());
+				}
+				return *t_buffer;
+			}
+
+			void writeEscaped(std::ostream& out, const char* text)
+			{
+				for (; *text; text++)
+				{
+					if (*text == '"' || *text == '\\')
+					{
+						out << '\\';
+					}
+					out << *text;
+				}
+			}
+		}
+
+		uint64_t now()
+		{
+			return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - s_epoch).count());
+		}
+
+		void record(const char* name, uint64_t start, uint64_t end)
+		{
+			ThreadBuffer& buffer = threadBuffer();
+			uint64_t index = buffer.writeIndex.load(std::memory_order_relaxed);
+			EventSlot& slot = buffer.events[index % BULLET_ECS_TRACE_BUFFER_EVENTS];
+			//a reader that sees any of the stores below also sees the index published before them, so it knows the slot is in flight
+			std::atomic_thread_fence(std::memory_order_release);
+			slot.name.store(name, std::memory_order_relaxed);
+			slot.start.store(start, std::memory_order_relaxed);
+			slot.end.store(end, std::memory_order_relaxed);
+			buffer.writeIndex.store(index + 1, std::memory_order_release);
+		}
+
+		void setThreadName(const char* name)
+		{
+			threadBuffer().threadName.store(name, std::memory_order_relaxed);
+		}
+
+		void writeChromeTrace(std::ostream& out)
+		{
+			std::lock_guard<std::mutex> lock(s_buffersMutex);
+			const std::ios::fmtflags flags = out.flags();
+			const std::streamsize precision = out.precision();
+			out << std::fixed;
+			out.precision(3); //microseconds with nanosecond resolution
+			std::vector<Event> events;
+			bool first = true;
+			out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+			for (const std::unique_ptr<ThreadBuffer>& buffer : s_buffers)
+			{
+				const uint64_t capacity = BULLET_ECS_TRACE_BUFFER_EVENTS;
+				const uint64_t end = buffer->writeIndex.load(std::memory_order_acquire);
+				const uint64_t begin = std::max(end > capacity ? end - capacity : 0, std::min(buffer->clearedIndex.load(std::memory_order_relaxed), end));
+				events.clear();
+				for (uint64_t i = begin; i < end; i++)
+				{
+					const EventSlot& slot = buffer->events[i % capacity];
+					events.push_back(Event{ slot.name.load(std::memory_order_relaxed), slot.start.load(std::memory_order_relaxed), slot.end.load(std::memory_order_relaxed) });
+				}
+				//slots below newEnd - capacity were overwritten while copying, and the slot of newEnd itself may be half written
+				std::atomic_thread_fence(std::memory_order_acquire);
+				const uint64_t newEnd = buffer->writeIndex.load(std::memory_order_relaxed);
+				const size_t skip = static_cast<size_t>(std::min<uint64_t>(newEnd + 1 > begin + capacity ? newEnd + 1 - capacity - begin : 0, events.size()));
+
+				if (const char* threadName = buffer->threadName.load(std::memory_order_relaxed))
+				{
+					out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadId << ",\"args\":{\"name\":\"";
+					writeEscaped(out, threadName);
+					out << "\"}}";
+					first = false;
+				}
+				for (size_t i = skip; i < events.size(); i++)
+				{
+					const Event& event = events[i];
+					out << (first ? "" : ",") << "\n{\"name\":\"";
+					writeEscaped(out, event.name);
+					out << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadId
+						<< ",\"ts\":" << event.start / 1000.0 << ",\"dur\":" << (event.end - event.start) / 1000.0 << "}";
+					first = false;
+				}
+			}
+			out << "\n]}\n";
+			out.flags(flags);
+			out.precision(precision);
+		}
+
+		bool writeChromeTrace(const std::string& path)
+		{
+			std::ofstream file(path);
+			if (!file)
+			{
+				return false;
+			}
+			writeChromeTrace(file);
+			return static_cast<bool>(file);
+		}
+
+		void clear()
+		{
+			std::lock_guard<std::mutex> lock(s_buffersMutex);
+			//the write index belongs to the owner thread, clearing only moves the start of the exported range
+			for (const std::unique_ptr<ThreadBuffer>& buffer : s_buffers)
+			{
+				buffer->clearedIndex.store(buffer->writeIndex.load(std::memory_order_acquire), std::memory_order_relaxed);
+			}
+		}
+	}
+}
+
+#endif
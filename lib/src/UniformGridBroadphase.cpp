@@ -0,0 +1,249 @@
+#include "BulletECS/UniformGridBroadphase.h"
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+
+namespace BulletECS
+{
+	namespace
+	{
+		//removes the pairs whose proxies stopped overlapping, the pair cache frees their collision algorithms
+		struct RemoveSeparatedPairs : public btOverlapCallback
+		{
+			bool processOverlap(btBroadphasePair& pair) override
+			{
+				const btBroadphaseProxy* a = pair.m_pProxy0;
+				const btBroadphaseProxy* b = pair.m_pProxy1;
+				return !(a->m_aabbMin.x() <= b->m_aabbMax.x() && b->m_aabbMin.x() <= a->m_aabbMax.x() &&
+					a->m_aabbMin.y() <= b->m_aabbMax.y() && b->m_aabbMin.y() <= a->m_aabbMax.y() &&
+					a->m_aabbMin.z() <= b->m_aabbMax.z() && b->m_aabbMin.z() <= a->m_aabbMax.z());
+			}
+		};
+
+		inline uint32_t hashCell(int x, int y, int z)
+		{
+			return (static_cast<uint32_t>(x) * 73856093u) ^ (static_cast<uint32_t>(y) * 19349663u) ^ (static_cast<uint32_t>(z) * 83492791u);
+		}
+	}
+
+	UniformGridBroadphase::UniformGridBroadphase(const btVector3& worldAabbMin, const btVector3& worldAabbMax, btScalar cellSize, int maxProxies, btOverlappingPairCache* pairCache)
+		: m_worldAabbMin(worldAabbMin),
+		  m_worldAabbMax(worldAabbMax),
+		  m_inverseCellSize(btScalar(1) / cellSize),
+		  m_proxies(static_cast<size_t>(maxProxies)),
+		  m_livePosition(static_cast<size_t>(maxProxies), -1),
+		  m_pairCache(pairCache)
+	{
+		assert(cellSize > 0 && "UniformGridBroadphase cell size must be positive.");
+		if (!m_pairCache)
+		{
+			m_ownedPairCache = std::make_unique<btHashedOverlappingPairCache>();
+			m_pairCache = m_ownedPairCache.get();
+		}
+		m_freeProxies.reserve(static_cast<size_t>(maxProxies));
+		for (int i = maxProxies - 1; i >= 0; i--)
+		{
+			m_freeProxies.push_back(i);
+		}
+		m_liveProxies.reserve(static_cast<size_t>(maxProxies));
+	}
+
+	UniformGridBroadphase::~UniformGridBroadphase()
+	{
+	}
+
+	btBroadphaseProxy* UniformGridBroadphase::createProxy(const btVector3& aabbMin, const btVector3& aabbMax, int shapeType, void* userPtr, int collisionFilterGroup, int collisionFilterMask, btDispatcher* dispatcher)
+	{
+		assert(!m_freeProxies.empty() && "UniformGridBroadphase ran out of proxies, increase maxProxies.");
+		if (m_freeProxies.empty())
+		{
+			return nullptr;
+		}
+		int index = m_freeProxies.back();
+		m_freeProxies.pop_back();
+
+		btBroadphaseProxy* proxy = &m_proxies[index];
+		*proxy = btBroadphaseProxy(aabbMin, aabbMax, userPtr, collisionFilterGroup, collisionFilterMask);
+		proxy->m_uniqueId = index + 2; //same convention as btSimpleBroadphase, 0 and 1 are reserved
+
+		m_livePosition[index] = static_cast<int>(m_liveProxies.size());
+		m_liveProxies.push_back(index);
+		return proxy;
+	}
+
+	void UniformGridBroadphase::destroyProxy(btBroadphaseProxy* proxy, btDispatcher* dispatcher)
+	{
+		m_pairCache->removeOverlappingPairsContainingProxy(proxy, dispatcher);
+
+		int index = proxyIndex(proxy);
+		int position = m_livePosition[index];
+		m_liveProxies[position] = m_liveProxies.back();
+		m_livePosition[m_liveProxies[position]] = position;
+		m_liveProxies.pop_back();
+		m_livePosition[index] = -1;
+		m_freeProxies.push_back(index);
+	}
+
+	void UniformGridBroadphase::setAabb(btBroadphaseProxy* proxy, const btVector3& aabbMin, const btVector3& aabbMax, btDispatcher* dispatcher)
+	{
+		//pairs are recomputed from scratch in calculateOverlappingPairs
+		proxy->m_aabbMin = aabbMin;
+		proxy->m_aabbMax = aabbMax;
+	}
+
+	void UniformGridBroadphase::getAabb(btBroadphaseProxy* proxy, btVector3& aabbMin, btVector3& aabbMax) const
+	{
+		aabbMin = proxy->m_aabbMin;
+		aabbMax = proxy->m_aabbMax;
+	}
+
+	void UniformGridBroadphase::rayTest(const btVector3& rayFrom, const btVector3& rayTo, btBroadphaseRayCallback& rayCallback, const btVector3& aabbMin, const btVector3& aabbMax)
+	{
+		//like btSimpleBroadphase, the callback does the precise test
+		for (int index : m_liveProxies)
+		{
+			rayCallback.process(&m_proxies[index]);
+		}
+	}
+
+	void UniformGridBroadphase::aabbTest(const btVector3& aabbMin, const btVector3& aabbMax, btBroadphaseAabbCallback& callback)
+	{
+		btBroadphaseProxy query(aabbMin, aabbMax, nullptr, 0, 0);
+		for (int index : m_liveProxies)
+		{
+			if (aabbOverlap(&query, &m_proxies[index]))
+			{
+				callback.process(&m_proxies[index]);
+			}
+		}
+	}
+
+	void UniformGridBroadphase::getBroadphaseAabb(btVector3& aabbMin, btVector3& aabbMax) const
+	{
+		aabbMin = m_worldAabbMin;
+		aabbMax = m_worldAabbMax;
+	}
+
+	void UniformGridBroadphase::cellOf(const btVector3& point, int& x, int& y, int& z) const
+	{
+		//points outside the world bounds are clamped to the border cells
+		btVector3 clamped = point;
+		clamped.setMax(m_worldAabbMin);
+		clamped.setMin(m_worldAabbMax);
+		btVector3 local = (clamped - m_worldAabbMin) * m_inverseCellSize;
+		x = static_cast<int>(std::floor(local.x()));
+		y = static_cast<int>(std::floor(local.y()));
+		z = static_cast<int>(std::floor(local.z()));
+	}
+
+	void UniformGridBroadphase::addPairIfOverlapping(btBroadphaseProxy* a, btBroadphaseProxy* b)
+	{
+		if (aabbOverlap(a, b) && !m_pairCache->findPair(a, b))
+		{
+			//the pair cache runs the overlap filter callback before storing the pair
+			m_pairCache->addOverlappingPair(a, b);
+		}
+	}
+
+	void UniformGridBroadphase::calculateOverlappingPairs(btDispatcher* dispatcher)
+	{
+		//1. drop the pairs that stopped overlapping
+		RemoveSeparatedPairs removeSeparated;
+		m_pairCache->processAllOverlappingPairs(&removeSeparated, dispatcher);
+
+		//2. bin every proxy into the cells its aabb touches
+		m_entries.clear();
+		m_oversizedProxies.clear();
+		for (int index : m_liveProxies)
+		{
+			const btBroadphaseProxy& proxy = m_proxies[index];
+			int minX, minY, minZ, maxX, maxY, maxZ;
+			cellOf(proxy.m_aabbMin, minX, minY, minZ);
+			cellOf(proxy.m_aabbMax, maxX, maxY, maxZ);
+			long long cellCount = static_cast<long long>(maxX - minX + 1) * (maxY - minY + 1) * (maxZ - minZ + 1);
+			if (cellCount > m_maxCellsPerProxy)
+			{
+				m_oversizedProxies.push_back(index);
+				continue;
+			}
+			for (int x = minX; x <= maxX; x++)
+			{
+				for (int y = minY; y <= maxY; y++)
+				{
+					for (int z = minZ; z <= maxZ; z++)
+					{
+						m_entries.push_back(CellEntry{ hashCell(x, y, z), index, x, y, z });
+					}
+				}
+			}
+		}
+
+		//3. counting sort of the entries by hash bucket
+		size_t bucketCount = 1;
+		while (bucketCount < m_entries.size() * 2)
+		{
+			bucketCount <<= 1;
+		}
+		m_bucketStart.assign(bucketCount + 1, 0);
+		for (CellEntry& entry : m_entries)
+		{
+			entry.bucket &= static_cast<uint32_t>(bucketCount - 1);
+			m_bucketStart[entry.bucket + 1]++;
+		}
+		for (size_t i = 1; i <= bucketCount; i++)
+		{
+			m_bucketStart[i] += m_bucketStart[i - 1];
+		}
+		m_sortedEntries.resize(m_entries.size());
+		for (const CellEntry& entry : m_entries)
+		{
+			m_sortedEntries[m_bucketStart[entry.bucket]++] = entry;
+		}
+		//m_bucketStart[b] now holds the end of bucket b, so bucket b starts at m_bucketStart[b - 1]
+
+		//4. test the proxies sharing a cell. A pair sharing several cells is only tested in the first one, the cell holding the max of both aabb mins
+		for (size_t bucket = 0; bucket < bucketCount; bucket++)
+		{
+			uint32_t begin = bucket == 0 ? 0 : m_bucketStart[bucket - 1];
+			uint32_t end = m_bucketStart[bucket];
+			for (uint32_t i = begin; i < end; i++)
+			{
+				const CellEntry& a = m_sortedEntries[i];
+				btBroadphaseProxy* proxyA = &m_proxies[a.proxy];
+				for (uint32_t j = i + 1; j < end; j++)
+				{
+					const CellEntry& b = m_sortedEntries[j];
+					if (a.x != b.x || a.y != b.y || a.z != b.z || a.proxy == b.proxy)
+					{
+						continue; //hash collision between different cells
+					}
+					btBroadphaseProxy* proxyB = &m_proxies[b.proxy];
+					btVector3 sharedMin = proxyA->m_aabbMin;
+					sharedMin.setMax(proxyB->m_aabbMin);
+					int firstX, firstY, firstZ;
+					cellOf(sharedMin, firstX, firstY, firstZ);
+					if (firstX == a.x && firstY == a.y && firstZ == a.z)
+					{
+						addPairIfOverlapping(proxyA, proxyB);
+					}
+				}
+			}
+		}
+
+		//5. oversized proxies against everything
+		for (size_t i = 0; i < m_oversizedProxies.size(); i++)
+		{
+			btBroadphaseProxy* oversized = &m_proxies[m_oversizedProxies[i]];
+			for (int index : m_liveProxies)
+			{
+				btBroadphaseProxy* other = &m_proxies[index];
+				if (other == oversized)
+				{
+					continue;
+				}
+				//pairs of two oversized proxies are found twice, findPair keeps them unique
+				addPairIfOverlapping(oversized, other);
+			}
+		}
+	}
+}
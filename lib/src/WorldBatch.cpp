@@ -0,0 +1,91 @@
+#include "BulletECS/WorldBatch.h"
+#include "BulletECS/Trace.h"
+#include <algorithm>
+
+namespace BulletECS
+{
+	WorldBatch::WorldBatch(size_t worldCount, const PhysicsWorldConfig& worldConfig, size_t threadCount)
+		: m_entitySlots(static_cast<size_t>(worldConfig.maxEntities) + 1),
+		  m_observations(worldCount * (static_cast<size_t>(worldConfig.maxEntities) + 1) * OBSERVATION_SIZE, 0.0f),
+		  m_threadPool(threadCount)
+	{
+		//worlds are created in parallel too, each one builds its Bullet managers and pools
+		m_worlds.resize(worldCount);
+		m_threadPool.parallelFor(worldCount, [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				m_worlds[i] = std::make_unique<PhysicsWorld>(worldConfig);
+			}
+		});
+	}
+
+	void WorldBatch::forEachWorld(const std::function<void(size_t, PhysicsWorld&)>& function)
+	{
+		m_threadPool.parallelFor(m_worlds.size(), [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				function(i, *m_worlds[i]);
+			}
+		});
+	}
+
+	void WorldBatch::stepSimulation(float timeStep, int maxSubSteps, float fixedTimeStep)
+	{
+		BULLET_ECS_TRACE_SCOPE("WorldBatch::stepSimulation");
+		//stepping and gathering in the same task keeps each world's data in the cache of the thread that stepped it
+		m_threadPool.parallelFor(m_worlds.size(), [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				m_worlds[i]->stepSimulation(timeStep, maxSubSteps, fixedTimeStep);
+				gatherObservations(i);
+			}
+		});
+	}
+
+	void WorldBatch::gatherObservations()
+	{
+		BULLET_ECS_TRACE_SCOPE("WorldBatch::gatherObservations");
+		m_threadPool.parallelFor(m_worlds.size(), [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				gatherObservations(i);
+			}
+		});
+	}
+
+	void WorldBatch::gatherObservations(size_t worldIndex)
+	{
+		float* worldObservations = m_observations.data() + worldIndex * getObservationStride();
+		std::fill(worldObservations, worldObservations + getObservationStride(), 0.0f);
+
+		const PhysicsWorld& world = *m_worlds[worldIndex];
+		for (Entity e : world.iterateEntitiesWithRigidBodies())
+		{
+			const btRigidBody* rigidBody = world.getRigidBody(e);
+			const btTransform& transform = rigidBody->getWorldTransform();
+			const btVector3& position = transform.getOrigin();
+			const btQuaternion rotation = transform.getRotation();
+			const btVector3& linearVelocity = rigidBody->getLinearVelocity();
+			const btVector3& angularVelocity = rigidBody->getAngularVelocity();
+
+			float* observation = worldObservations + static_cast<size_t>(e.ID) * OBSERVATION_SIZE;
+			observation[0] = static_cast<float>(position.x());
+			observation[1] = static_cast<float>(position.y());
+			observation[2] = static_cast<float>(position.z());
+			observation[3] = static_cast<float>(rotation.x());
+			observation[4] = static_cast<float>(rotation.y());
+			observation[5] = static_cast<float>(rotation.z());
+			observation[6] = static_cast<float>(rotation.w());
+			observation[7] = static_cast<float>(linearVelocity.x());
+			observation[8] = static_cast<float>(linearVelocity.y());
+			observation[9] = static_cast<float>(linearVelocity.z());
+			observation[10] = static_cast<float>(angularVelocity.x());
+			observation[11] = static_cast<float>(angularVelocity.y());
+			observation[12] = static_cast<float>(angularVelocity.z());
+		}
+	}
+}
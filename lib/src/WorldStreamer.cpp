@@ -0,0 +1,483 @@
+#include "BulletECS/WorldStreamer.h"
+#include "BulletECS/PhysicsWorld.h"
+#include "BulletECS/Trace.h"
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cassert>
+
+namespace BulletECS
+{
+	using Milliseconds = std::chrono::duration<double, std::milli>;
+
+	static constexpr char CELL_FILE_MAGIC[4] = { 'B', 'E', 'C', 'L' };
+	static constexpr uint32_t CELL_FILE_VERSION = 1;
+
+	struct CellFileHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t recordSize; //rejects files written by a build with another record layout
+		uint32_t bodyCount;
+	};
+
+	struct CellRecord
+	{
+		float position[3];
+		float rotation[4]; //xyzw
+		float size[3];
+		float mass;
+		float restitution;
+		uint8_t colliderType;
+		uint8_t layer;
+		uint8_t padding[2];
+	};
+	static_assert(sizeof(CellRecord) == 52, "Cell records are written as raw bytes, they must not have hidden padding.");
+
+	//distance on the XZ plane from the point to the cell's square, 0 inside it
+	static float distanceToCell(const btVector3& point, CellCoord cell, float cellSize)
+	{
+		const float minX = cell.x * cellSize;
+		const float minZ = cell.z * cellSize;
+		const float dx = std::max(std::max(minX - float(point.x()), 0.0f), float(point.x()) - (minX + cellSize));
+		const float dz = std::max(std::max(minZ - float(point.z()), 0.0f), float(point.z()) - (minZ + cellSize));
+		return std::sqrt(dx * dx + dz * dz);
+	}
+
+	WorldStreamer::WorldStreamer(PhysicsWorld& world, std::string directory, const StreamingSettings& settings)
+		: m_world(world), m_directory(std::move(directory)), m_settings(settings), m_loader(&WorldStreamer::loaderLoop, this)
+	{
+		assert(m_settings.cellSize > 0.0f && "Streaming cells need a positive size.");
+		assert(m_settings.commitBatchSize > 0 && "Streaming needs a commit batch of at least one body.");
+	}
+
+	WorldStreamer::~WorldStreamer()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stopping = true;
+		}
+		m_wakeLoader.notify_all();
+		m_loader.join();
+	}
+
+	CellCoord WorldStreamer::getCell(const btVector3& position) const
+	{
+		return CellCoord{ static_cast<int32_t>(std::floor(position.x() / m_settings.cellSize)), static_cast<int32_t>(std::floor(position.z() / m_settings.cellSize)) };
+	}
+
+	std::string WorldStreamer::getCellPath(CellCoord cell) const
+	{
+		std::string name = "cell_" + std::to_string(cell.x) + "_" + std::to_string(cell.z) + ".bin";
+		return m_directory.empty() ? name : m_directory + "/" + name;
+	}
+
+	bool WorldStreamer::saveCell(CellCoord cell) const
+	{
+		std::vector<BodyDesc> bodies;
+		for (Entity entity : m_world.iterateEntitiesWithRigidBodies())
+		{
+			BodyDesc desc;
+			if (m_world.getBodyDesc(entity, desc) && getCell(desc.transform.getOrigin()) == cell)
+			{
+				bodies.push_back(desc);
+			}
+		}
+		return writeCellFile(getCellPath(cell), bodies);
+	}
+
+	bool WorldStreamer::writeCellFile(const std::string& path, Span<const BodyDesc> bodies)
+	{
+		std::vector<CellRecord> records(bodies.size());
+		for (size_t i = 0; i < bodies.size(); i++)
+		{
+			const BodyDesc& desc = bodies[i];
+			const btVector3& position = desc.transform.getOrigin();
+			const btQuaternion rotation = desc.transform.getRotation();
+			CellRecord& record = records[i];
+			record = CellRecord{};
+			record.position[0] = position.x(); record.position[1] = position.y(); record.position[2] = position.z();
+			record.rotation[0] = rotation.x(); record.rotation[1] = rotation.y(); record.rotation[2] = rotation.z(); record.rotation[3] = rotation.w();
+			record.size[0] = desc.collider.size.x(); record.size[1] = desc.collider.size.y(); record.size[2] = desc.collider.size.z();
+			record.mass = desc.mass;
+			record.restitution = desc.restitution;
+			record.colliderType = static_cast<uint8_t>(desc.collider.type);
+			record.layer = desc.layer;
+		}
+
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		if (!file)
+		{
+			return false;
+		}
+		CellFileHeader header{};
+		std::memcpy(header.magic, CELL_FILE_MAGIC, sizeof(header.magic));
+		header.version = CELL_FILE_VERSION;
+		header.recordSize = sizeof(CellRecord);
+		header.bodyCount = static_cast<uint32_t>(records.size());
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(CellRecord));
+		return static_cast<bool>(file);
+	}
+
+	bool WorldStreamer::readCellFile(const std::string& path, std::vector<BodyDesc>& bodies)
+	{
+		BULLET_ECS_TRACE_SCOPE("WorldStreamer::readCellFile");
+		std::ifstream file(path, std::ios::binary);
+		CellFileHeader header{};
+		if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || std::memcmp(header.magic, CELL_FILE_MAGIC, sizeof(header.magic)) != 0 ||
+			header.version != CELL_FILE_VERSION || header.recordSize != sizeof(CellRecord))
+		{
+			return false;
+		}
+
+		//the count is checked against the file length before allocating, a corrupted header must not ask for gigabytes
+		const std::streamoff recordsStart = file.tellg();
+		file.seekg(0, std::ios::end);
+		const std::streamoff fileEnd = file.tellg();
+		if (recordsStart < 0 || fileEnd < recordsStart || uint64_t(header.bodyCount) > uint64_t(fileEnd - recordsStart) / sizeof(CellRecord))
+		{
+			return false;
+		}
+		file.seekg(recordsStart);
+
+		//one read for the whole cell, the records are converted after it
+		std::vector<CellRecord> records(header.bodyCount);
+		if (!file.read(reinterpret_cast<char*>(records.data()), records.size() * sizeof(CellRecord)))
+		{
+			return false;
+		}
+		bodies.clear();
+		bodies.reserve(records.size());
+		for (const CellRecord& record : records)
+		{
+			if (record.colliderType >= static_cast<uint8_t>(ColliderType::Count) || record.layer >= MAX_COLLISION_LAYERS)
+			{
+				return false;
+			}
+			BodyDesc desc;
+			desc.transform.setOrigin(btVector3(record.position[0], record.position[1], record.position[2]));
+			desc.transform.setRotation(btQuaternion(record.rotation[0], record.rotation[1], record.rotation[2], record.rotation[3]));
+			desc.collider.type = static_cast<ColliderType>(record.colliderType);
+			desc.collider.size = btVector3(record.size[0], record.size[1], record.size[2]);
+			desc.mass = record.mass;
+			desc.restitution = record.restitution;
+			desc.layer = record.layer;
+			bodies.push_back(desc);
+		}
+		return true;
+	}
+
+	void WorldStreamer::requestLoad(CellCoord coord)
+	{
+		Cell& cell = m_cells[coord];
+		if (cell.state == CellState::Unloading)
+		{
+			cell.requestTime = Clock::now();
+			cell.reloadAfterUnload = true;
+			return;
+		}
+		if (cell.state != CellState::Unloaded)
+		{
+			return;
+		}
+		cell.requestTime = Clock::now();
+		queueLoad(coord, cell);
+	}
+
+	void WorldStreamer::queueLoad(CellCoord coord, Cell& cell)
+	{
+		cell.state = CellState::Loading;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_requests.push_back(LoadRequest{ coord, cell.generation, getCellPath(coord) });
+			m_pendingDecodes++;
+		}
+		m_wakeLoader.notify_one();
+	}
+
+	void WorldStreamer::requestUnload(CellCoord coord)
+	{
+		auto it = m_cells.find(coord);
+		if (it == m_cells.end())
+		{
+			return;
+		}
+		Cell& cell = it->second;
+		switch (cell.state)
+		{
+		case CellState::Loading:
+			//the loader may be decoding it, the result is dropped when it comes back
+			cell.generation++;
+			cell.state = CellState::Unloaded;
+			break;
+		case CellState::Committing:
+		case CellState::Loaded:
+			cell.state = CellState::Unloading;
+			cell.staging.clear();
+			cell.committed = 0;
+			m_unloadQueue.push_back(coord);
+			break;
+		case CellState::Unloading:
+			cell.reloadAfterUnload = false;
+			break;
+		case CellState::Failed:
+			cell.state = CellState::Unloaded;
+			break;
+		default:
+			break;
+		}
+	}
+
+	void WorldStreamer::streamAround(const btVector3& focus, float radius)
+	{
+		const CellCoord center = getCell(focus);
+		const int32_t reach = static_cast<int32_t>(std::ceil(radius / m_settings.cellSize));
+		for (int32_t z = center.z - reach; z <= center.z + reach; z++)
+		{
+			for (int32_t x = center.x - reach; x <= center.x + reach; x++)
+			{
+				const CellCoord cell{ x, z };
+				if (distanceToCell(focus, cell, m_settings.cellSize) <= radius)
+				{
+					requestLoad(cell);
+				}
+			}
+		}
+
+		const float unloadRadius = radius + m_settings.cellSize;
+		std::vector<CellCoord> farCells;
+		for (const auto& [coord, cell] : m_cells)
+		{
+			if (cell.state != CellState::Unloaded && cell.state != CellState::Unloading && distanceToCell(focus, coord, m_settings.cellSize) > unloadRadius)
+			{
+				farCells.push_back(coord);
+			}
+		}
+		for (CellCoord coord : farCells)
+		{
+			requestUnload(coord);
+		}
+	}
+
+	void WorldStreamer::update()
+	{
+		BULLET_ECS_TRACE_SCOPE("WorldStreamer::update");
+		const Clock::time_point start = Clock::now();
+		m_stats.bodiesAdded = 0;
+		m_stats.bodiesRemoved = 0;
+		collectDecodedCells();
+
+		bool firstBatch = true;
+		auto budgetLeft = [&]()
+		{
+			const bool left = firstBatch || Milliseconds(Clock::now() - start).count() < m_settings.commitBudgetMs;
+			firstBatch = false;
+			return left;
+		};
+
+		//unloads first, so the leaving bodies free their IDs and broadphase pairs before the new ones come in
+		while (!m_unloadQueue.empty() && budgetLeft())
+		{
+			const CellCoord coord = m_unloadQueue.front();
+			Cell& cell = m_cells[coord];
+			if (unloadBatch(cell, m_settings.commitBatchSize))
+			{
+				m_unloadQueue.pop_front();
+				if (cell.reloadAfterUnload)
+				{
+					cell.reloadAfterUnload = false;
+					queueLoad(coord, cell);
+				}
+			}
+		}
+
+		while (!m_commitQueue.empty() && budgetLeft())
+		{
+			Cell& cell = m_cells[m_commitQueue.front()];
+			//unloaded while committing
+			if (cell.state != CellState::Committing || commitBatch(cell, m_settings.commitBatchSize))
+			{
+				m_commitQueue.pop_front();
+			}
+		}
+
+		updateCellCounts();
+		m_stats.updateTime = Milliseconds(Clock::now() - start).count();
+	}
+
+	void WorldStreamer::flush()
+	{
+		BULLET_ECS_TRACE_SCOPE("WorldStreamer::flush");
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_cellDecoded.wait(lock, [&]() { return m_pendingDecodes == 0 || !m_decoded.empty(); });
+			}
+			collectDecodedCells();
+			while (!m_unloadQueue.empty())
+			{
+				const CellCoord coord = m_unloadQueue.front();
+				Cell& cell = m_cells[coord];
+				unloadBatch(cell, cell.entities.size());
+				m_unloadQueue.pop_front();
+				if (cell.reloadAfterUnload)
+				{
+					cell.reloadAfterUnload = false;
+					queueLoad(coord, cell);
+				}
+			}
+			while (!m_commitQueue.empty())
+			{
+				Cell& cell = m_cells[m_commitQueue.front()];
+				if (cell.state == CellState::Committing)
+				{
+					commitBatch(cell, cell.staging.size() - cell.committed);
+				}
+				m_commitQueue.pop_front();
+			}
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_pendingDecodes == 0 && m_decoded.empty())
+			{
+				break;
+			}
+		}
+		updateCellCounts();
+	}
+
+	CellState WorldStreamer::getCellState(CellCoord coord) const
+	{
+		auto it = m_cells.find(coord);
+		return it != m_cells.end() ? it->second.state : CellState::Unloaded;
+	}
+
+	Span<const Entity> WorldStreamer::getCellEntities(CellCoord coord) const
+	{
+		auto it = m_cells.find(coord);
+		if (it == m_cells.end())
+		{
+			return {};
+		}
+		return Span<const Entity>(it->second.entities.data(), it->second.entities.size());
+	}
+
+	void WorldStreamer::loaderLoop()
+	{
+		BULLET_ECS_TRACE_THREAD_NAME("BulletECS streamer");
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (true)
+		{
+			m_wakeLoader.wait(lock, [&]() { return m_stopping || !m_requests.empty(); });
+			if (m_stopping)
+			{
+				return;
+			}
+			LoadRequest request = std::move(m_requests.front());
+			m_requests.pop_front();
+			lock.unlock();
+
+			DecodedCell decoded{ request.cell, request.generation, false, {} };
+			decoded.ok = readCellFile(request.path, decoded.bodies);
+
+			lock.lock();
+			m_decoded.push_back(std::move(decoded));
+			m_pendingDecodes--;
+			m_cellDecoded.notify_all();
+		}
+	}
+
+	void WorldStreamer::collectDecodedCells()
+	{
+		std::vector<DecodedCell> decodedCells;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			decodedCells.swap(m_decoded);
+		}
+		for (DecodedCell& decoded : decodedCells)
+		{
+			Cell& cell = m_cells[decoded.cell];
+			if (cell.state != CellState::Loading || cell.generation != decoded.generation)
+			{
+				continue; //unloaded before it was decoded
+			}
+			//not Unloaded, or streamAround would request the missing file again every frame
+			if (!decoded.ok)
+			{
+				cell.state = CellState::Failed;
+				m_stats.loadsFailed++;
+				continue;
+			}
+			cell.staging = std::move(decoded.bodies);
+			cell.committed = 0;
+			cell.entities.clear();
+			cell.entities.reserve(cell.staging.size());
+			cell.state = CellState::Committing;
+			m_commitQueue.push_back(decoded.cell);
+		}
+	}
+
+	bool WorldStreamer::commitBatch(Cell& cell, size_t batchSize)
+	{
+		const size_t count = std::min(batchSize, cell.staging.size() - cell.committed);
+		cell.entities.resize(cell.committed + count);
+		m_world.addBodies(cell.staging.data() + cell.committed, count, cell.entities.data() + cell.committed);
+		cell.committed += count;
+		m_stats.bodiesAdded += static_cast<uint32_t>(count);
+		if (cell.committed < cell.staging.size())
+		{
+			return false;
+		}
+		finishLoad(cell);
+		return true;
+	}
+
+	bool WorldStreamer::unloadBatch(Cell& cell, size_t batchSize)
+	{
+		//from the last added, so the entity manager's highest ID goes down with them
+		const size_t count = std::min(batchSize, cell.entities.size());
+		for (size_t i = 0; i < count; i++)
+		{
+			const Entity entity = cell.entities.back();
+			cell.entities.pop_back();
+			if (m_world.isAlive(entity))
+			{
+				m_world.destroyEntity(entity);
+			}
+		}
+		m_stats.bodiesRemoved += static_cast<uint32_t>(count);
+		if (!cell.entities.empty())
+		{
+			return false;
+		}
+		cell.state = CellState::Unloaded;
+		return true;
+	}
+
+	void WorldStreamer::finishLoad(Cell& cell)
+	{
+		cell.state = CellState::Loaded;
+		std::vector<BodyDesc>().swap(cell.staging); //the staging buffer is only needed while committing
+		cell.committed = 0;
+
+		const double latency = Milliseconds(Clock::now() - cell.requestTime).count();
+		m_stats.lastLoadLatency = latency;
+		m_stats.maxLoadLatency = std::max(m_stats.maxLoadLatency, latency);
+		m_stats.loadsCompleted++;
+		m_totalLoadLatency += latency;
+		m_stats.averageLoadLatency = m_totalLoadLatency / static_cast<double>(m_stats.loadsCompleted);
+	}
+
+	void WorldStreamer::updateCellCounts()
+	{
+		m_stats.cellsLoading = m_stats.cellsLoaded = m_stats.cellsUnloading = 0;
+		for (const auto& [coord, cell] : m_cells)
+		{
+			m_stats.cellsLoading += cell.state == CellState::Loading || cell.state == CellState::Committing || cell.reloadAfterUnload;
+			m_stats.cellsLoaded += cell.state == CellState::Loaded;
+			m_stats.cellsUnloading += cell.state == CellState::Unloading;
+		}
+	}
+}